@@ -19,7 +19,7 @@
  *
  */
 .text
-.globl idt,gdt,pg_dir,tmp_floppy_area
+.globl idt,gdt,pg_dir,tmp_floppy_area,empty_zero_page
 pg_dir:# 页目录将会存放在这里.
  # 再次注意!!!这里已经处于32位运行模式,因此这里的$0x10并不是把地址0x10装入各个段寄存器,它现在其实是全局段描述符表中的偏移值,或者更准确
  # 地说是一个描述符表项的选择符.这里$0x10的含义是请求特权级0(位0-1=0),选择全局描述符表(位2=0),选择表中第2项(位3-15=2).它正好指向表中的
@@ -181,6 +181,7 @@ setup_gdt:
  * Linus将内核的内存页表直接放在页目录之后,使用了4个表来寻址16MB的物理内存.如果你有多于16MB的内存,就需要在这里进行扩充修改.
  *
  */
+ # 16MB以上的内存(最多1GB)由mm/memory.c中的mem_init()使用从主内存区开始处取得的页表映射,这里仍只映射前16MB.
  # 每个页表长为4KB字节(1页内存页面),而每个页表项需要4个字节,因此一个页表共可以存放1024个表项.如果一个页表项寻址4KB的地址空间,则一个页表就可以寻址
  # 4MB的物理内存.
  # 页表项的格式为:项的前0-11位存放一些标志,例如是否在内存中(P位0),读写许可(R/W位1),普通还是超级用户使用(U/S位2),是否修改过了(是否脏了)(D位6)等;
@@ -198,7 +199,17 @@ pg2:
 .org 0x4000
 pg3:
 
-.org 0x5000							# 定义下面的内存数据块从偏移0x5000处开始.
+.org 0x5000							# 偏移0x5000处的一页是全零页面.
+/*
+ * empty_zero_page is mapped read-only for reads of anonymous memory
+ * that has never been written (see do_no_page() in mm/memory.c).
+ */
+/*
+ * 对从未写过的匿名内存(bss,堆和栈)的读操作,都以只读方式映射到这个全零页面上(参见mm/memory.c中的do_no_page()).
+ */
+empty_zero_page:
+
+.org 0x6000							# 定义下面的内存数据块从偏移0x6000处开始.
 /*
  * tmp_floppy_area is used by the floppy-driver when DMA cannot
  * reach to a buffer-block. It needs to be aligned, so that it isn't
@@ -297,8 +308,8 @@ ignore_int:
  # 空间范围到物理内存上.对于新的进程,系统会在主内存区为其申请页面存放页表.另外,1页内存长度是4096字节.
 
 .align 2								# 按4字节方式对齐内存地址边界.
-setup_paging:							# 首先对5页内存(1页目录+4页页表)清零.
-	movl $1024 * 5, %ecx				/* 5 pages - pg_dir+4 page tables */
+setup_paging:							# 首先对6页内存(1页目录+4页页表+全零页面)清零.
+	movl $1024 * 6, %ecx				/* 6 pages - pg_dir+4 page tables+zero page */
 	xorl %eax, %eax
 	xorl %edi, %edi						/* pg_dir is at 0x000 */	# 页目录从0x0000地址开始
 	cld;rep;stosl						# eax内容存到es:edi所指内存位置处,且edi增4.
@@ -348,10 +359,10 @@ idt_descr:
 .word 0
 
  # 下面是加载全局描述符表寄存器gdtr的指令lgdt要求的6字节操作数.前2字节是gdt表的限长,后4字节是gdt表的线性基地址.这里全局表长度设置为
- # 2KB字节(0x7ff即可),因为每8字节组成一个描述符项,所以表中共可有256项.符号gdt是全局表在本程序中的偏移位置.
+ # 4KB字节(0xfff即可),因为每8字节组成一个描述符项,所以表中共可有512项.符号gdt是全局表在本程序中的偏移位置.
 
 gdt_descr:
-	.word 256 * 8 - 1					# so does gdt (not that that's any
+	.word 512 * 8 - 1					# so does gdt (not that that's any
 	.long gdt							# magic number, but it works for me :^)
 
 	.align 8							# 按8(2^3)字节方式对齐内存地址边界.
@@ -363,7 +374,7 @@ idt:	.fill 256, 8, 0					# idt is uninitialized	# 256项,每项8字节,填0.
  # (0-nul, 1-cs, 2-ds, 3-syscall, 4-TSS0, 5-LDT0, 6-TSS1, 7-LDT1, 8-TSS2 etc...)
 gdt:
 	.quad 0x0000000000000000			/* NULL descriptor */
-	.quad 0x00c09a0000000fff			/* 16Mb */		# 0x08,内核代码段最大长度16MB.
-	.quad 0x00c0920000000fff			/* 16Mb */		# 0x10,内核数据段最大长度16MB.
+	.quad 0x00c39a000000ffff			/* 1Gb */		# 0x08,内核代码段最大长度1GB,覆盖整个恒等映射.
+	.quad 0x00c392000000ffff			/* 1Gb */		# 0x10,内核数据段最大长度1GB.
 	.quad 0x0000000000000000			/* TEMPORARY - don't use */
-	.fill 252, 8, 0						/* space for LDT's and TSS's etc */	# 预留空间.
+	.fill 508, 8, 0						/* space for LDT's and TSS's etc */	# 预留空间.共512项,见include/linux/head.h中GDT_ENTRIES.
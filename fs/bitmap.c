@@ -9,6 +9,7 @@
 #include <string.h>
 #include <linux/sched.h>							// 调度程序头文件,定义任务结构task_struct,任务0数据.
 #include <linux/kernel.h>
+#include <linux/mm.h>								// 内存管理头文件,声明页面缓存操作函数.
 
 // 将指定地址(addr)处的一块1024字节内存清零.
 // 输入:eax = 0;ecx = 以字节为单位的数据块长度(BLOCK_SIZE/4);edi = 指定起始地址addr.
@@ -156,14 +157,20 @@ void free_inode(struct m_inode * inode)
 {
 	struct super_block * sb;
 	struct buffer_head * bh;
+	struct m_inode * next;
 
 	// 首先判断参数给出的需要释放的i节点有效性或合法性。如果i节点指针=NULL，则退出。
 	// 如果i节点上的设备号字段为0,说明该节点没有使用。于是用0清空对应i节点所占内存区并返回memset()定义在include/string.h
 	// 处。这里表示用0填写inode指针指定处、长度是sizeof(*inode)的内存块。
 	if (!inode)
 		return;
+	// 页面缓存项指向内存i节点,清空i节点之前先丢弃它在缓存中的页面.
+	invalidate_inode_pages(inode);
+	// 清空i节点时保留内存i节点链表指针.
+	next = inode->i_next;
 	if (!inode->i_dev) {
 		memset(inode, 0, sizeof(*inode));
+		inode->i_next = next;
 		return;
 	}
 	// 如果此i节点还有其他程序引用，则不释放，说明内核有问题，停机。如果文件连接数不为0,则表示还有其他文件目录项在使用
@@ -191,6 +198,7 @@ void free_inode(struct m_inode * inode)
 		printk("free_inode: bit already cleared.\n\r");
 	bh->b_dirt = 1;
 	memset(inode, 0, sizeof(*inode));
+	inode->i_next = next;
 }
 
 // 为设备dev建立一个新i节点。初始化并返回该新i节点的指针。
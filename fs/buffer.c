@@ -176,6 +176,7 @@ void check_disk_change(int dev)
 			put_super(super_block[i].s_dev);
 	invalidate_inodes(dev);         // 释放设备dev在内存i节点表中的所有i节点
 	invalidate_buffers(dev);        //
+	invalidate_dev_pages(dev);      // 删除设备dev上文件在页面缓存中的页面
 }
 
 // 下面两行代码是hash(散列)函数定义和hash表项的计算宏.
@@ -418,6 +419,16 @@ __asm__("cld\n\t" \
 	::"c" (BLOCK_SIZE/4),"S" (from),"D" (to) \
 	:)
 
+// 把一块(1024字节)内存清零.
+#define CLEARBLK(to) \
+__asm__("cld\n\t" \
+		"pushl %%edi\n\t" \
+		"rep\n\t" \
+		"stosl\n\t" \
+		"popl %%edi\n\t" \
+	::"a" (0),"c" (BLOCK_SIZE/4),"D" (to) \
+	:)
+
 //#define COPYBLK(from,to) \
 	__asm__("cld\n\t" \
 			"rep\n\t" \
@@ -445,6 +456,7 @@ void bread_page(unsigned long address, int dev, int b[4])
 	// 该函数循环执行4次,根据放在数组b[]中的4个块号从设备dev中读取一页内容放到指定内存位置address处.对于参数b[i]给出的
 	// 有效块号,函数首先从高速缓冲中取指定设备和块号的的缓冲块.如果缓冲块中数据无效(未更新)则产生读设备请求从设备上读取相
 	// 应数据块.对于b[i]无效的块号则不用处理它了.因此本函数其实可以根据指定的b[]中的块号随意读取1-4个数据块.
+	// 无效块号和读取失败的块对应的内存被清零,因此调用者不必事先清零页面.
 	for (i = 0 ; i < 4 ; i++)
 		if (b[i]) {
 			// 先给该逻辑块号申请一个缓存块
@@ -461,7 +473,26 @@ void bread_page(unsigned long address, int dev, int b[4])
 			wait_on_buffer(bh[i]);						// 等待缓冲块解锁(若被上锁的话).
 			if (bh[i]->b_uptodate)						// 若缓冲块中数据有效的话则复制.
 				COPYBLK((unsigned long) bh[i]->b_data, address);
+			else
+				CLEARBLK(address);
 			brelse(bh[i]);								// 释放该缓冲区.
+		} else
+			CLEARBLK(address);							// 文件中的空洞或无效块号读为零.
+}
+
+// 预读设备上一个页面(4个缓冲块)的内容到高速缓冲中.
+// 与breada()中的预读块一样,只发出读请求而不等待,也不保持对缓冲块的引用.随后的bread_page()在读同一页面时就可以直接使用这些缓冲块.
+// 用于mm/memory.c中缺页处理时预先读入相邻页面.
+void prefetch_page(int dev, int b[4])
+{
+	struct buffer_head * bh;
+	int i;
+
+	for (i = 0 ; i < 4 ; i++)
+		if (b[i] && (bh = getblk(dev, b[i]))) {
+			if (!bh->b_uptodate)
+				ll_rw_block(READA, bh);
+			bh->b_count--;
 		}
 }
 
@@ -61,10 +61,11 @@ int sys_uselib(const char * library)
 	struct m_inode * inode;
 	unsigned long base;
 
-	// 首先判断当前进程是否普通进程。这是通过查看当前进程的空间长度来做到的。因为普通进程的空间长度被设置为TASK_SIZE（64
-	// MB）。因此若进程逻辑地址空间长度不等于TASK_SIZE则返回出错码（无效参数）。否则取库文件i节点inode。若库文件名指针
+	// 首先判断当前进程是否普通进程。这是通过查看当前进程的空间长度来做到的。因为普通进程的空间长度被设置为TASK_SIZE（3
+	// GB）。因此若进程逻辑地址空间长度不等于TASK_SIZE则返回出错码（无效参数）。与其他任务共享地址空间的vfork()子进程和线程
+	// 也不能更换库文件。否则取库文件i节点inode。若库文件名指针
 	// 空，则设置inode等于NULL。
-	if (get_limit(0x17) != TASK_SIZE)
+	if (get_limit(0x17) != TASK_SIZE || current->mm->count > 1)
 		return -EINVAL;
 	if (library) {
 		if (!(inode = namei(library)))							/* get library inode */
@@ -75,12 +76,14 @@ int sys_uselib(const char * library)
 	/* 我们应该检查一下文件类型（如头部信息等），但是我们还没有这样做。*/
 	// 然后放回进程原库文件i节点，并预置进程库i节点字段为空。接着取得进程的库代码所在位置，并释放原库代码的页表所占用的内存
 	// 页面。最后让进程库i节点字段指向新库i节点，并返回0（成功）。
+	unlink_text_inodes(current);
 	iput(current->library);
 	current->library = NULL;
 	base = get_base(current->ldt[2]);
 	base += LIBRARY_OFFSET;
-	free_page_tables(base, LIBRARY_SIZE);
+	free_page_tables(current->tss.cr3, base, LIBRARY_SIZE);
 	current->library = inode;
+	link_text_inodes(current);
 	return 0;
 }
 
@@ -313,6 +316,8 @@ int do_execve(unsigned long * eip, long tmp, char * filename,
 	struct exec ex;
 	unsigned long page[MAX_ARG_PAGES];							// 参数和环境串空间页面指针数组.
 	int i, argc, envc;
+	unsigned long new_dir = 0;									// 共享地址空间时的新页目录.
+	struct mm_struct * new = NULL;								// 共享地址空间时的新地址空间结构.
 	int e_uid, e_gid;											// 有效用户ID和有效组ID.
 	int retval;
 	int sh_bang = 0;											// 控制是否需要执行脚本程序.
@@ -509,7 +514,7 @@ restart_interp:
 	// 长度的总和.
 	brelse(bh);
 	if (N_MAGIC(ex) != ZMAGIC || ex.a_trsize || ex.a_drsize ||
-		ex.a_text + ex.a_data + ex.a_bss > 0x3000000 ||
+		ex.a_text + ex.a_data + ex.a_bss > MMAP_BASE ||
 		inode->i_size < ex.a_text + ex.a_data + ex.a_syms + N_TXTOFF(ex)) {
 		retval = -ENOEXEC;
 		goto exec_error2;
@@ -533,6 +538,22 @@ restart_interp:
 			goto exec_error2;
 		}
 	}
+	// 打开文件表还与其他线程共享时先换成自己的一份,下面按close_on_exec关闭文件时才不会影响其他线程.
+	// 地址空间还与其他任务共享时(vfork()子进程或clone(CLONE_VM)产生的线程),需要自己的页目录和地址空间结构,在这里预先申请,
+	// 以免在下面不能返回的地方失败.
+	if (retval = unshare_files())
+		goto exec_error2;
+	if (current->mm->count > 1) {
+		if (!(new_dir = new_page_dir())) {
+			retval = -ENOMEM;
+			goto exec_error2;
+		}
+		if (!(new = new_mm())) {
+			free_page(new_dir);
+			retval = -ENOMEM;
+			goto exec_error2;
+		}
+	}
 	/* OK, This is the point of no return */
 	/* note that current->library stays unchanged by an exec */
 	/* OK,下面开始就没有返回的地方了 */
@@ -547,10 +568,13 @@ restart_interp:
 	//
 	// 这里我们首先放回进程原执行程序的i节点,并且让进程executable字段指向新执行文件的i节点.然后复位原进程的所有信号处理句柄,但对于SIG_IGN
 	// 句柄无须复位.
+	unlink_text_inodes(current);
 	if (current->executable)
 		iput(current->executable);
 	current->executable = inode;
+	link_text_inodes(current);
 	current->signal = 0;
+	exit_sighand();
 	for (i = 0 ; i < 32 ; i++) {
 		current->sigaction[i].sa_mask = 0;
 		current->sigaction[i].sa_flags = 0;
@@ -559,14 +583,34 @@ restart_interp:
 	}
 	// 再根据设定的执行时关闭文件句柄(close_on_exec)位图标志,关闭指定的打开文件并复位该标志
 	for (i = 0 ; i < NR_OPEN ; i++)
-		if ((current->close_on_exec >> i) & 1)
+		if ((current->files->close_on_exec >> i) & 1)
 			sys_close(i);
-	current->close_on_exec = 0;
+	current->files->close_on_exec = 0;
 	// 然后根据当前进程指定的基地址和限长,释放原来程序的代码段和数据段所对应的内存页表指定的物理内存页面及页表本身.此时新执行文件并没有占用主
 	// 内存区任何页面,因此在处理器真正运行新执行文件代码时就会引起缺页异常中断,此时内存管理程序即会执行缺页处理页为新执行文件申请内存页面和
 	// 设置相关页表项,并且把相关执行文件页面读入内存中.如果"上次任务使用了协处理器"指向的是当前进程,则将其置空,并复位使用了协处理器的标志.
-	free_page_tables(get_base(current->ldt[1]), get_limit(0x0f));
-	free_page_tables(get_base(current->ldt[2]), get_limit(0x17));
+	// 若地址空间还与其他任务共享,则不释放页表,而是放弃对原地址空间的引用,换用前面申请的自己的页目录和地址空间结构,并立即加载到cr3中.
+	// vfork()产生的子进程还要把地址空间归还给父进程.否则解除mmap()映射(在释放页表之前)并释放页表,驻留页面数清零.
+	if (new) {
+		exit_mm();
+		free_page(current->tss.cr3);									// 递减原页目录的引用计数.
+		current->tss.cr3 = new_dir;
+		__asm__ __volatile__("movl %0,%%cr3"::"r" (new_dir));
+		current->start_code = TASK_BASE;
+		set_base(current->ldt[1], current->start_code);
+		set_base(current->ldt[2], current->start_code);
+		if (current->flags & PF_VFORK)
+			vfork_release();
+		current->mm = new;
+	} else {
+		exit_mmap(current);
+		free_page_tables(current->tss.cr3, get_base(current->ldt[1]), get_limit(0x0f));
+		free_page_tables(current->tss.cr3, get_base(current->ldt[2]), get_limit(0x17));
+		current->mm->rss = 0;
+	}
+	// 原来的页面都已释放(或已归还给父进程),mlock()锁定随之解除.
+	current->flags &= ~PF_MLOCKALL;
+	current->locked_pages = 0;
 	if (last_task_used_math == current)
 		last_task_used_math = NULL;
 	current->used_math = 0;
@@ -580,7 +624,7 @@ restart_interp:
 	// 执行文件的代码段长度加数据段长度(a_data + a_text);并令进程堆结尾字段brk = a_text + a_data + a_bss.brk用于指明进程当前数据段
 	// (包括未初始化数据部分)末端位置,供内核为进程分配内存时指定分配开始位置.然后设置进程栈开始字段为栈指针所在页面,并重新设置进程的有效用户
 	// id和有效组id.
-	current->brk = ex.a_bss +
+	current->mm->brk = ex.a_bss +
 		(current->end_data = ex.a_data +
 		(current->end_code = ex.a_text));
 	current->start_stack = p & 0xfffff000;
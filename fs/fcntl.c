@@ -25,14 +25,14 @@ static int dupfd(unsigned int fd, unsigned int arg)
 	// 或者该句柄的文件结构不存在,则返回出错码并退出.如果指定的新句柄值arg大于最
 	// 多打开文件数,也返回出错码并退出.注意,实际上文件句柄就是进程文件结构指针数
 	// 组项索引号
-	if (fd >= NR_OPEN || !current->filp[fd]) {
+	if (fd >= NR_OPEN || !current->files->fd[fd]) {
 		return -EBADF;
 	}
 	if (arg >= NR_OPEN) {
 		return -EINVAL;
 	}
 	while (arg < NR_OPEN) {
-		if (current->filp[arg]) {
+		if (current->files->fd[arg]) {
 			arg++;
 		} else {
 			break;
@@ -44,8 +44,8 @@ static int dupfd(unsigned int fd, unsigned int arg)
 	// 否则针对找到的空闲项(句柄),在执行时关闭标志位图close_on_exec中复位该句
 	// 柄位.即在运行exec()类函数时,不会关闭用dup()创建的的句柄.并令该文件结构
 	// 指针等于原句柄fd的指针,并且将文件引用数增1.最后返回新的文件句柄arg
-	current->close_on_exec &= ~(1 << arg);
-	(current->filp[arg] = current->filp[fd])->f_count++;
+	current->files->close_on_exec &= ~(1 << arg);
+	(current->files->fd[arg] = current->files->fd[fd])->f_count++;
 	return arg;
 }
 
@@ -83,19 +83,19 @@ int sys_fcntl(unsigned int fd, unsigned int cmd, unsigned long arg)
 
 	// 首先检查给出的文件句柄有效性。然后根据不同命令cmd进行分别处理。如果文件句柄值大于一个进程最多打开文件数
 	// NR_OPEN，或者该句柄的文件结构指针为空，则返回出错码并退出。
-	if (fd >= NR_OPEN || !(filp = current->filp[fd])) {
+	if (fd >= NR_OPEN || !(filp = current->files->fd[fd])) {
 		return -EBADF;
 	}
 	switch (cmd) {
 		case F_DUPFD:   // 复制文件句柄。
 			return dupfd(fd,arg);
 		case F_GETFD:   // 取文件句柄的执行时关闭标志。
-			return (current->close_on_exec >> fd) & 1;
+			return (current->files->close_on_exec >> fd) & 1;
 		case F_SETFD:   // 设置执行时关闭标志。arg位0置位是设置，否则关闭。
 			if (arg & 1)
-				current->close_on_exec |= (1 << fd);
+				current->files->close_on_exec |= (1 << fd);
 			else
-				current->close_on_exec &= ~(1 << fd);
+				current->files->close_on_exec &= ~(1 << fd);
 			return 0;
 		case F_GETFL:  	// 取文件状态标志和访问模式。
 			return filp->f_flags;
@@ -84,6 +84,8 @@ int file_write(struct m_inode * inode, struct file * filp, char * buf, int count
 	 * OK，当许多进程同时写时，append操作可能不行，但那又怎样。不管怎样那样做会导致混乱一团。
 	 */
 	// 首先确定数据写入文件的位置。如果是要向文件后添加数据，则将文件读写指针移到文件尾部。否则就将在文件当前读写指针处写入。
+	// 文件内容将被修改,页面缓存中该文件的页面不再有效.
+	invalidate_inode_pages(inode);
 	if (filp->f_flags & O_APPEND)
 		pos = inode->i_size;
 	else
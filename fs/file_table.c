@@ -5,5 +5,34 @@
  */
 
 #include <linux/fs.h>		// 文件系统头文件,定义文件表结构(file_,buffer_head,m_inode等).
+#include <linux/mm.h>		// 内存管理头文件.含有对象缓存函数的原型定义.
 
-struct file file_table[NR_FILE];	// 文件表数组(64项).
+// 文件结构从对象缓存中分配,打开文件时分配,最后一个引用关闭时释放,因此系统中打开文件的个数不再有固定上限.
+static struct kmem_cache * file_cachep;
+int nr_files = 0;			// 使用中的文件结构个数.
+
+// 建立文件结构对象缓存.由init/main.c调用.
+void file_table_init(void)
+{
+	file_cachep = kmem_cache_create("file", sizeof(struct file), 0);
+}
+
+// 分配一个文件结构.
+// 文件结构内容被清零,引用计数置为1.若没有内存则返回NULL.
+struct file * get_empty_filp(void)
+{
+	struct file * f;
+
+	if (!(f = (struct file *) kmem_cache_alloc(file_cachep, GFP_KERNEL)))
+		return NULL;
+	f->f_count = 1;
+	nr_files++;
+	return f;
+}
+
+// 释放文件结构.调用者需已将其引用计数减为0并放回了其i节点.
+void free_filp(struct file * f)
+{
+	nr_files--;
+	kmem_cache_free(file_cachep, f);
+}
@@ -15,7 +15,11 @@
 // 设置数据块总数指针数组
 extern int *blk_size[];
 
-struct m_inode inode_table[NR_INODE]={{0, }, };	// 内存中i节点表(NR_INODE=64项)
+// 内存中的i节点从对象缓存中分配,并链接成一个链表.i节点一旦分配就一直留在链表中,空闲(i_count=0)的i节点可被重用,因此在遍历链表时
+// 睡眠也是安全的.
+static struct kmem_cache * inode_cachep;
+struct m_inode * first_inode = NULL;		// 内存i节点链表头.
+int nr_inodes = 0;							// 内存i节点个数.
 
 // 读指定i节点号的i节点信息.
 static void read_inode(struct m_inode * inode);
@@ -54,11 +58,9 @@ static inline void unlock_inode(struct m_inode * inode)
 // 释放设备dev在内存i节点表中的所有i节点
 void invalidate_inodes(int dev)
 {
-	int i;
 	struct m_inode * inode;
 
-	inode = 0 + inode_table;
-	for(i = 0 ; i < NR_INODE ; i++, inode++) {
+	for (inode = first_inode ; inode ; inode = inode->i_next) {
 		wait_on_inode(inode);
 		if (inode->i_dev == dev) {
 			if (inode->i_count)	{
@@ -73,15 +75,14 @@ void invalidate_inodes(int dev)
 // 同步所有i节点
 void sync_inodes(void)
 {
-	int i;
 	struct m_inode * inode;
 
-	inode = 0 + inode_table;
-	for(i = 0 ; i < NR_INODE ; i++, inode++) {
+	for (inode = first_inode ; inode ; inode = inode->i_next) {
 		wait_on_inode(inode);
 		if (inode->i_dirt && !inode->i_pipe) {
 			write_inode(inode);
 		}
+	}
 }
 
 // 文件数据块映射到盘块的处理操作.(block位图处理函数,bmap - block map)
@@ -252,35 +253,46 @@ repeat:
 	return;
 }
 
-// 从i节点表(inode_table)中获取一个空闲i节点项.
-// 寻找引用计数count为0的i节点,并将其写盘后清零,返回其指针.引用计数被置1.
+// 建立i节点对象缓存.由init/main.c调用.
+void inode_init(void)
+{
+	inode_cachep = kmem_cache_create("inode", sizeof(struct m_inode), 0);
+}
+
+// 获取一个空闲i节点项.
+// 内存i节点个数少于NR_INODE时直接分配新的i节点;否则寻找引用计数count为0的i节点(优先选择没有缓存页面的),并将其写盘后清零,返回其指针.若所有i节点都在使用中,
+// 则仍然分配新的i节点,因此内存i节点个数只受内存大小限制.引用计数被置1.
 struct m_inode * get_empty_inode(void)
 {
-	struct m_inode * inode;
-	static struct m_inode * last_inode = inode_table; 
+	struct m_inode * inode, * next;
+	static struct m_inode * last_inode = NULL;
 	int i;
 
-	// 在初始化last_inode指针指向i节点表头一项后循环扫描整个i节点表,如果last_inode已
-	// i节点表的最后1项之后,则让其重新指向i节点表开始处,以继续循环寻找空闲i节点项.如
-	// st_inode所指向的i节点计数值为0,则说明可能找到空闲i节点项.让inode指向该i节点.
-	// i节点的已修改标志和锁定标志均为0,则我们可以使用该i节点,于是退出for循环.
+	// 从上次找到的位置开始循环扫描内存i节点链表,如果last_inode已经到达链表末尾,则让其重新指向链表头.如果last_inode所指向的i节点计数值为0,
+	// 则说明可能找到空闲i节点项.让inode指向该i节点.如果该i节点的已修改标志和锁定标志均为0,则我们可以使用该i节点,于是退出for循环.
 	do {
 		inode = NULL;
-		for (i = NR_INODE; i ; i--) { 
-			if (++last_inode >= inode_table + NR_INODE) {
-				last_inode = inode_table;
-			}
-			if (!last_inode->i_count) {
-				inode = last_inode;
-				if (!inode->i_dirt && !inode->i_lock)
-					break;
+		if (nr_inodes >= NR_INODE)
+			for (i = nr_inodes; i ; i--) {
+				if (!last_inode || !(last_inode = last_inode->i_next))
+					last_inode = first_inode;
+				if (!last_inode->i_count) {
+					inode = last_inode;
+					if (!inode->i_dirt && !inode->i_lock && !inode->i_cached)
+						break;
+				}
 			}
-		}
-		// 如果没有找到空闲i节点(inode=NULL),则将i节点表打印出来供调试使用,并停机.
+		// 如果没有找到空闲i节点(inode=NULL),则从对象缓存中分配一个新的i节点(已清零),链入i节点链表头.
 		if (!inode) {
-			for (i = 0 ; i < NR_INODE ; i++)
-				printk("%04x: %6d\t", inode_table[i].i_dev, inode_table[i].i_num);
-			panic("No free inodes in mem");
+			if (!(inode = (struct m_inode *) kmem_cache_alloc(inode_cachep, GFP_KERNEL))) {
+				printk("No free inodes in mem\n\r");
+				return NULL;
+			}
+			inode->i_count = 1;
+			inode->i_next = first_inode;
+			first_inode = inode;
+			nr_inodes++;
+			return inode;
 		}
 		// 等待该i节点解锁(如果又被上锁的话).如果该i节点已修改标志被置位的话,则将该
 		// 刷新(同步).因为刷新时可能会睡眠,因此需要再次循环等待i节点解锁.
@@ -291,8 +303,12 @@ struct m_inode * get_empty_inode(void)
 		}
 	} while (inode->i_count);
 	// 如果i节点又被其他占用的话(i节点的计数值不为0了),则重新寻找空闲i节点.否则说明已
-	// 合要求的空闲i节点项.则将该i节点项内容清零,并置引用计数为1,返回该i节点指针.
+	// 合要求的空闲i节点项.则将该i节点项内容清零(但保留链表指针),并置引用计数为1,返回该i节点指针.页面缓存项指向
+	// 内存i节点,因此先丢弃该i节点在页面缓存中的页面.
+	invalidate_inode_pages(inode);
+	next = inode->i_next;
 	memset(inode, 0, sizeof(*inode));
+	inode->i_next = next;
 	inode->i_count = 1;
 	return inode;
 }
@@ -336,12 +352,12 @@ struct m_inode * iget(int dev, int nr)
 		panic("iget with dev==0");
 	}
 	empty = get_empty_inode();
-	// 接着扫描i节点表.寻找参数指定节点号nr的i节点.并递增该节点的引用次数.如果当前扫
+	// 接着扫描内存i节点链表.寻找参数指定节点号nr的i节点.并递增该节点的引用次数.如果当前扫
 	// 点的设备号不等于指定的设备号或者节点号不等于指定的节点号,则继续扫描.
-	inode = inode_table;
-	while (inode < NR_INODE + inode_table) {
+	inode = first_inode;
+	while (inode) {
 		if (inode->i_dev != dev || inode->i_num != nr) {
-			inode++;
+			inode = inode->i_next;
 			continue;
 		}
 		// 如果找到指定设备号dev和节点号nr的i节点,则等待该节点解锁(如果已上锁的话).
@@ -349,7 +365,7 @@ struct m_inode * iget(int dev, int nr)
 		// 变化,则重新扫描整个i节点表
 		wait_on_inode(inode);
 		if (inode->i_dev != dev || inode->i_num != nr) {
-			inode = inode_table;
+			inode = first_inode;
 			continue;
 		}
 		// 到这里表示找到相应的i节点.于是将该i节点引用计数增1.然后再作进一步检查,看
@@ -377,7 +393,7 @@ struct m_inode * iget(int dev, int nr)
 			iput(inode);
 			dev = super_block[i].s_dev;
 			nr = ROOT_INO;
-			inode = inode_table;
+			inode = first_inode;
 			continue;
 		}
 		// 最终我们找到了相应的i节点.因此可以放弃本函数开始处临时 的空闲i节点,返回找
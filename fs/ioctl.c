@@ -47,7 +47,7 @@ int sys_ioctl(unsigned int fd, unsigned int cmd, unsigned long arg)
 
 	// 首先判断给出的文件描述符的有效性。如果文件描述符超出可打开的文件数，或者对应描述符的文件结构指针为空，则
 	// 返回出错码退出。
-	if (fd >= NR_OPEN || !(filp = current->filp[fd])) {
+	if (fd >= NR_OPEN || !(filp = current->files->fd[fd])) {
 		return -EBADF;
 	}
 	// 如果文件结构对应的是管道i节点，则根据进程是否有权操作该管道确定是否执行管道IO控制操作。若有权执行则调用
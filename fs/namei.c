@@ -175,7 +175,7 @@ static struct buffer_head * find_entry(struct m_inode ** dir,
 		/* '..' in a pseudo-root results in a faked '.' (just change namelen) */
 		/* 伪根中的'..'如同一个假'.'(只需改变名字长度) */
 		// 把根目录的'..'看做'.'
-		if ((*dir) == current->root) {
+		if ((*dir) == current->fs->root) {
 			namelen = 1;
 		} else if ((*dir)->i_num == ROOT_INO) {
 			/* '..' over a mount-point results in 'dir' being exchanged for the mounted
@@ -332,7 +332,7 @@ static struct m_inode * follow_link(struct m_inode * dir, struct m_inode * inode
 	// 没有给出目录项i节点,则放回目录i节点后返回NULL.如果指定目录项不是一个符号链接,就直接返回目录项对应的i节
 	// 点inode.
 	if (!dir) {
-		dir = current->root;
+		dir = current->fs->root;
 		dir->i_count++;
 	}
 	if (!inode) {
@@ -391,7 +391,7 @@ static struct m_inode * get_dir(const char * pathname, struct m_inode * inode)
 
 	// 首先判断参数有效性.如果给出的指定目录的i节点指针inode为空,则使用当前进程的工作目录i节点.
 	if (!inode) {
-		inode = current->pwd;									// 进程的当前工作目录i节点.
+		inode = current->fs->pwd;									// 进程的当前工作目录i节点.
 		inode->i_count++;
 	}
 	// 如果用户指定路径名的第1个字符是'/',则说明路径名是绝对路径名.则应该从当前进程任务结构中设置的根(或伪根)i节点开始操作.
@@ -399,7 +399,7 @@ static struct m_inode * get_dir(const char * pathname, struct m_inode * inode)
 	// 并删除路径名的第1个字符'/'.这样就可以保证进程只能以其设定的根i节点作为搜索的起点.
 	if ((c = get_fs_byte(pathname)) == '/') {
 		iput(inode);											// 放回原i节点.
-		inode = current->root;									// 为进程指定的根i节点.
+		inode = current->fs->root;									// 为进程指定的根i节点.
 		pathname++;
 		inode->i_count++;
 	}
@@ -579,7 +579,7 @@ int open_namei(const char * pathname, int flag, int mode,
 		flag |= O_WRONLY;
 	// 使用当前进程的文件访问许可屏蔽码,屏蔽掉给定模式中的相应位,并添上普通文件标志I_REGULAR.
 	// 该标志将用于打开的文件不存在而需要创建文件时,作为新文件的默认属性
-	mode &= 0777 & ~current->umask;
+	mode &= 0777 & ~current->fs->umask;
 	mode |= I_REGULAR;													// 常规文件标志.见参见include/const.h文件.
 	// 然后根据指定的路径名寻找到对应的i节点,以及最顶端目录名及其长度.此时如果最顶端目录名长度为0(例如'/usr/'这种路径名的情况),那么
 	// 若操作不是读写,创建和文件长度截0,则表示是在打开一个目录名文件操作.于是直接返回该目录的i节点并返回0退出.否则说明进程操作非法,于是
@@ -803,7 +803,7 @@ int sys_mkdir(const char * pathname, int mode)
 	inode->i_nlinks = 2;
 	dir_block->b_dirt = 1;
 	brelse(dir_block);
-	inode->i_mode = I_DIRECTORY | (mode & 0777 & ~current->umask);
+	inode->i_mode = I_DIRECTORY | (mode & 0777 & ~current->fs->umask);
 	inode->i_dirt = 1;
 	// 现在我们在指定目录中新添加一个目录项，用于存放新建目录的i节点和目录名。如果失败（包含该目录项的高速缓冲区指针为NULL），
 	// 则放回目录的i节点；所申请的i节点引用连接计数复位，并放回该i节点。返回出错码退出。
@@ -1110,7 +1110,7 @@ int sys_symlink(const char * oldname, const char * newname)
 		iput(dir);
 		return -ENOSPC;
 	}
-	inode->i_mode = S_IFLNK | (0777 & ~current->umask);
+	inode->i_mode = S_IFLNK | (0777 & ~current->fs->umask);
 	inode->i_dirt = 1;
 	// 为了保存符号链接路径名字符串信息，我们需要为该i节点申请一个磁盘块，并让i节点的第1个直接块号i_zone[0]等于得到的逻辑块号。
 	// 然后置i节点已修改标志。如果申请失败则放回对应目录的i节点；复位新申请的i节点链接计数；放回该新的i节点，返回没有空间出错码
@@ -124,8 +124,8 @@ int sys_chdir(const char * filename)
 		return -ENOTDIR;// 出错码：不是目录名
 	}
 	/* 然后释放进程原工作目录i节点，并使其指向新设置的工作目录i节点。返回0 */
-	iput(current->pwd);
-	current->pwd = inode;
+	iput(current->fs->pwd);
+	current->fs->pwd = inode;
 	return (0);
 }
 
@@ -144,8 +144,8 @@ int sys_chroot(const char * filename)
 		return -ENOTDIR;
 	}
 	// 然后释放当前进程的根目录，并重新设置为指定目录名的i节点，返回0。
-	iput(current->root);
-	current->root = inode;
+	iput(current->fs->root);
+	current->fs->root = inode;
 	return (0);
 }
 
@@ -267,9 +267,9 @@ int sys_open(const char * filename, int flag, int mode)
 	// 首先对参数进行处理.将用户设置的文件模式和进程模式屏蔽码相与,产适配器的文件模式.为了为打开文件建
 	// 立一个文件句柄,需要搜索进程结构中文件结构指针数组,以查找一个空闲项.空闲项的索引号fd即是句柄值.若
 	// 已经没有空闲项,则返回出错码(参数无效).
-	mode &= 0777 & ~current->umask;
+	mode &= 0777 & ~current->fs->umask;
 	for(fd = 0 ; fd < NR_OPEN ; fd++) {
-		if (!current->filp[fd]) {
+		if (!current->files->fd[fd]) {
 			break;	// 找到空闲项.
 		}
 	}
@@ -281,23 +281,18 @@ int sys_open(const char * filename, int flag, int mode)
 	// 文件句柄.当程序使用fork()函数创建一个子进程时,通常会在该子进程中调用execve()函数加载执行另一个新
 	// 程序.此时子进程中开始执行新程序.若一个文件句柄close_on_exec中的对应位被置位,那么在执行execve()时
 	// 该对应文件句柄将被关闭,否则该文件句柄将始终处于打开状态.当打开一个文件时,默认情况下文件句柄在子
-	// 进程中也处于打开状态.因此这里要复位对应位.然后为打开文件在文件表中寻找一个空闲结构项.我们令f指向
-	// 文件表数组开始处.搜索空闲文件结构项(引用计数为0的项),若已经没有空闲文件表结构项,则返回出错码.另
-	// 外,第184行上的指针赋值"0+file_table"等同于"file_table"和"&file_table[0]"
-	// 不过这样写可能更能明了一些.
-	current->close_on_exec &= ~(1 << fd);           // 复位对应文件打开位
-	f = 0 + file_table;
-	for (i = 0 ; i < NR_FILE ; i++, f++)
-		if (!f->f_count) break;         			// 在文件表中找到空闲结构项。
-	if (i >= NR_FILE)
-		return -EINVAL;
-	// 此时我们让进程对应文件句柄fd的文件结构指针指向搜索到的文件结构,并令文件引用计数递增1.然后调用函
-	// 数open_namei()执行打开操作,若返回值小于0,则说明出错,于是释放刚申请到的文件结构,返回出错码i.若文
-	// 件打开操作成功,则inode是已打开文件的i节点指针.
-	(current->filp[fd] = f)->f_count++;
+	// 进程中也处于打开状态.因此这里要复位对应位.然后为打开文件分配一个文件结构(引用计数为1),若没有内存
+	// 则返回出错码.
+	current->files->close_on_exec &= ~(1 << fd);           // 复位对应文件打开位
+	if (!(f = get_empty_filp()))
+		return -ENFILE;
+	// 此时我们让进程对应文件句柄fd的文件结构指针指向分配到的文件结构.然后调用函数open_namei()执行打开
+	// 操作,若返回值小于0,则说明出错,于是释放刚申请到的文件结构,返回出错码i.若文件打开操作成功,则inode
+	// 是已打开文件的i节点指针.
+	current->files->fd[fd] = f;
 	if ((i = open_namei(filename, flag, mode, &inode)) < 0) {
-		current->filp[fd] = NULL;
-		f->f_count = 0;
+		current->files->fd[fd] = NULL;
+		free_filp(f);
 		return i;
 	}
 	// 根据已打开文件i节点的属性字段,我们可以知道文件的类型.对于不同类型的文件,我们需要作一些特别处理.如
@@ -308,8 +303,8 @@ int sys_open(const char * filename, int flag, int mode)
 	if (S_ISCHR(inode->i_mode))
 		if (check_char_dev(inode, inode->i_zone[0], flag)) {
 			iput(inode);
-			current->filp[fd] = NULL;
-			f->f_count = 0;
+			current->files->fd[fd] = NULL;
+			free_filp(f);
 			return -EAGAIN;	// 出错号:资源暂不可用.
 		}
 	// 如果打开的是块设备文件,则检查盘片是否更换过.若更换过则需要让高速缓冲区中该设备的所有缓冲块失效.
@@ -349,12 +344,12 @@ int sys_close(unsigned int fd)
 	}
 
 	/* 2. 修改当前进程中的结构体参数 */
-	current->close_on_exec &= ~(1 << fd);
+	current->files->close_on_exec &= ~(1 << fd);
 	
-	if (!(filp = current->filp[fd])) {
+	if (!(filp = current->files->fd[fd])) {
 		return -EINVAL;
 	}
-	current->filp[fd] = NULL;
+	current->files->fd[fd] = NULL;
 
 	/* 3. 对关闭的文件进行判断 */
 	if (filp->f_count == 0) {
@@ -363,7 +358,8 @@ int sys_close(unsigned int fd)
 	if (--filp->f_count) {
 		return (0);
 	}
-	/* 如果引用计数已等于0,说明该文件已经没有进程引用,该文件结构已变为空闲.则释放该文件i节点,返回0 */
+	/* 如果引用计数已等于0,说明该文件已经没有进程引用,该文件结构已变为空闲.则释放该文件i节点和文件结构,返回0 */
 	iput(filp->f_inode);
+	free_filp(filp);
 	return (0);
 }
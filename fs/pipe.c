@@ -110,37 +110,36 @@ int sys_pipe(unsigned long * fildes)
 	int fd[2];                      						// 文件句柄数组。
 	int i, j;
 
-	// 首先从系统文件表中取两个空闲项（引用计数字段为0的项），并分别设置引用计数为1.
-	// 若只有1个空闲项，则释放该项（引用计数复位）。若没有找到两个空闲项，则返回-1。
-	j = 0;
-	for(i = 0; j < 2 && i < NR_FILE; i++)
-		if (!file_table[i].f_count)
-			(f[j++] = i + file_table)->f_count++;
-	if (j == 1)
-		f[0]->f_count = 0;
-	if (j < 2)
+	// 首先分配两个文件结构（引用计数为1）。若只分配到1个，则释放该项。若没有分配到两个，则返回-1。
+	if (!(f[0] = get_empty_filp()))
 		return -1;
+	if (!(f[1] = get_empty_filp())) {
+		free_filp(f[0]);
+		return -1;
+	}
 	// 针对上面取得的两个文件表结构项，分别分配一文件句柄号，并使进程文件结构指针数组的两项分别指向这两个文件
 	// 结构。而文件句柄即是该数组的索引号。类似地，如果只有一个空闲文件句柄，则释放该句柄（置空相应数组项）。如
 	// 果没有找到两个空闲句柄，则释放上面获取的两个文件结构项（复位引用计数值），并返回-1。
 	j = 0;
 	for(i = 0; j < 2 && i < NR_OPEN; i++)
-		if (!current->filp[i]) {
-			current->filp[ fd[j] = i ] = f[j];
+		if (!current->files->fd[i]) {
+			current->files->fd[ fd[j] = i ] = f[j];
 			j++;
 		}
 	if (j == 1)
-		current->filp[fd[0]] = NULL;
+		current->files->fd[fd[0]] = NULL;
 	if (j < 2) {
-		f[0]->f_count = f[1]->f_count = 0;
+		free_filp(f[0]);
+		free_filp(f[1]);
 		return -1;
 	}
 	// 然后利用函数get_pipe_inode()申请一个管道使用的i节点，并为管道分配一页内存作为缓冲区。如果不成功，则
 	// 相应释放两个文件句柄和文件结构项，并返回-1.
 	if (!(inode = get_pipe_inode())) {                		// fs/inode.c。
-		current->filp[fd[0]] =
-			current->filp[fd[1]] = NULL;
-		f[0]->f_count = f[1]->f_count = 0;
+		current->files->fd[fd[0]] =
+			current->files->fd[fd[1]] = NULL;
+		free_filp(f[0]);
+		free_filp(f[1]);
 		return -1;
 	}
 	// 如果管道i节点申请成功，则对两个文件结构进行初始化操作，让它们都指向同一个管道i节点，并把读写指针都置零。
@@ -38,7 +38,7 @@ int sys_lseek(unsigned int fd, off_t offset, int origin)
 
 	// 如果文件句柄大于程序最多打开文件数NR_OPEN（20），或者该句柄的文件结构指针为空，或者对应文件结构的i节点字
 	// 段为空，或者指定设备文件指针是不可定位的，则返回出错码并退出。
-	if (fd >= NR_OPEN || !(file = current->filp[fd]) || !(file->f_inode)
+	if (fd >= NR_OPEN || !(file = current->files->fd[fd]) || !(file->f_inode)
 	   || !IS_SEEKABLE(MAJOR(file->f_inode->i_dev))) {
 		return -EBADF;
 	}
@@ -82,7 +82,7 @@ int sys_read(unsigned int fd, char * buf, int count)
 
 	// 进程文件句柄值大于程序最多打开文件数NR_OPEN,或者需要写入的字节计数小于0,或者该句柄的文件结构指针为空,
 	// 则返回出错码并退出.如果需读取的字节数count等于0,则返回0退出.
-	if (fd >= NR_OPEN || count < 0 || !(file = current->filp[fd])) {
+	if (fd >= NR_OPEN || count < 0 || !(file = current->files->fd[fd])) {
 		return -EINVAL;
 	}
 	if (!count) {
@@ -130,7 +130,7 @@ int sys_write(unsigned int fd, char * buf, int count)
 
 	// 同样地,我们首先判断函数参数的有效性.如果进程文件句柄值大于程序最多打开文件数NR_OPEN,或者需要写入的字节
 	// 计数小于0,或者该句柄的文件结构指针为空,则返回出错码并退出.如果需读取的字节数count等于0,则返回0退出.
-	if (fd >= NR_OPEN || count < 0 || !(file = current->filp[fd])) {
+	if (fd >= NR_OPEN || count < 0 || !(file = current->files->fd[fd])) {
 		return -EINVAL;
 	}
 	if (!count) {
@@ -89,7 +89,7 @@ static void free_wait(select_table * p)
 	for (i = 0; i < p->nr ; i++) {
 		tpp = p->entry[i].wait_address;
 		while (*tpp && *tpp != current) {
-			(*tpp)->state = 0;
+			wake_up_process(*tpp);
 			current->state = TASK_UNINTERRUPTIBLE;
 			schedule();
 		}
@@ -99,7 +99,7 @@ static void free_wait(select_table * p)
 		if (!*tpp)
 			printk("free_wait: NULL");
 		if (*tpp = p->entry[i].old_task)
-			(**tpp).state = 0;
+			wake_up_process(*tpp);
 	}
 	p->nr = 0;
 }
@@ -217,15 +217,15 @@ int do_select(fd_set in, fd_set out, fd_set ex,
 	for (i = 0 ; i < NR_OPEN ; i++, mask >>= 1) {
 		if (!(mask & 1))                                        // 若不在描述符集中则继续判断下一个。
 			continue;
-		if (!current->filp[i])                                  // 若文件未打开，则返回描述符值。
+		if (!current->files->fd[i])                                  // 若文件未打开，则返回描述符值。
 			return -EBADF;
-		if (!current->filp[i]->f_inode)                         // 若文件i节点指针为空，则返回错误号。
+		if (!current->files->fd[i]->f_inode)                         // 若文件i节点指针为空，则返回错误号。
 			return -EBADF;
-		if (current->filp[i]->f_inode->i_pipe)                  // 若是管道文件描述符，则有效。
+		if (current->files->fd[i]->f_inode->i_pipe)                  // 若是管道文件描述符，则有效。
 			continue;
-		if (S_ISCHR(current->filp[i]->f_inode->i_mode))         // 字符设备文件有效。
+		if (S_ISCHR(current->files->fd[i]->f_inode->i_mode))         // 字符设备文件有效。
 			continue;
-		if (S_ISFIFO(current->filp[i]->f_inode->i_mode))        // FIFO也有效。
+		if (S_ISFIFO(current->files->fd[i]->f_inode->i_mode))        // FIFO也有效。
 			continue;
 		return -EBADF;                  						// 其余都作为无效描述符而返回。
 	}
@@ -241,21 +241,21 @@ repeat:
 		// 如果此时判断的描述符在读操作描述符集中，并且该描述符已经准备好可以进行读操作，则把该描述符在描述符集in中对应位置为1,同时把已准备
 		// 好描述符个数计数值count增1。
 		if (mask & in)
-			if (check_in(&wait_table, current->filp[i]->f_inode)) {
+			if (check_in(&wait_table, current->files->fd[i]->f_inode)) {
 				*inp |= mask;   								// 描述符集中设置对应位。
 				count++;        								// 已准备好描述符个数计数。
 			}
 		// 如果此时判断的描述符在写操作描述符集中，并且该描述符已经准备好可以进行写操作，则把该描述符在描述符集out中对应位置为1,同时把已准备
 		// 好描述符个数计数值count增1。
 		if (mask & out)
-			if (check_out(&wait_table, current->filp[i]->f_inode)) {
+			if (check_out(&wait_table, current->files->fd[i]->f_inode)) {
 				*outp |= mask;
 				count++;
 			}
 		// 如果此时判断的描述符在异常描述符集中，并且该描述符已经有异常出现，则把该描述符在描述符集ex中对应位置为1,同时把已准备好描述符个数计
 		// 数值count增1。
 		if (mask & ex)
-			if (check_ex(&wait_table, current->filp[i]->f_inode)) {
+			if (check_ex(&wait_table, current->files->fd[i]->f_inode)) {
 				*exp |= mask;
 				count++;
 			}
@@ -277,6 +277,16 @@ repeat:
 	return count;
 }
 
+// select()的等待时间到。清除进程的timeout，若进程在可中断睡眠中就唤醒它。
+static void select_timeout(unsigned long data)
+{
+	struct task_struct * p = (struct task_struct *) data;
+
+	p->timeout = 0;
+	if (p->state == TASK_INTERRUPTIBLE)
+		wake_up_process(p);
+}
+
 /*
  * Note that we cannot return -ERESTARTSYS, as we change our input
  * parameters. Sad, but there you are. We could do some tweaking in
@@ -302,7 +312,8 @@ int sys_select( unsigned long *buffer )
 	fd_set res_ex, ex = 0, *exp;            						// 异常条件描述符集。
 	fd_set mask;                            						// 处理的描述符数值范围（nd）屏蔽码。
 	struct timeval *tvp;                    						// 等待时间结构指针。
-	unsigned long timeout;
+	struct hrtimer *timer = &current->sleep_timer;
+	unsigned long sec = 0, usec = 0;
 
 	// 然后从用户数据区把参数分别隔离复制到局部指针变量中，并根据描述符集指针是否有效分别取得3个描述符集in（读）、out（写）和ex
 	// （异常）。其中mask也是一个描述符集变量，根据3个描述符集中最大描述符值+1（即第1个参数nd的值），它被设置成用户程序关心的所有
@@ -319,31 +330,32 @@ int sys_select( unsigned long *buffer )
 		out = mask & get_fs_long(outp);
 	if (exp)                                						// 若指针有效，则取异常描述符集。
 		ex = mask & get_fs_long(exp);
-	// 接下来我们尝试从时间结构中取出等待（睡眠）时间值timeout。首先把timeout初始化成最大（无限）值，然后从用户数据空间取得该时间
-	// 结构中设置的时间值，经转换和加上系统当前嘀嗒值jiffies，最后得到需要等待的时间嘀嗒数值timeout。我们用此值来设置当前进程应该
-	// 等待的延时。另外，第241行上tv_usec字段是微秒值，把它除以1000000后可得到对应秒数，再乘以系统每秒嘀嗒数HZ，即把tv_usec转换
-	// 成嘀嗒值。
-	timeout = 0xffffffff;
+	// 接下来我们尝试从时间结构中取出等待（睡眠）时间值。没有给出时间结构时一直等待，此时把进程的timeout置成最大（无限）值。否则用
+	// 进程自己的高精度睡眠定时器sleep_timer定时，到期时由select_timeout()把timeout清零并唤醒进程，因此等待时间不再是嘀嗒的整数倍。
+	// 时间值为0时不等待，timeout也为0。
+	current->timeout = 0xffffffff;
 	if (tvp) {
-		timeout = get_fs_long((unsigned long *) & tvp->tv_usec) / (1000000 / HZ);
-		timeout += get_fs_long((unsigned long *) & tvp->tv_sec) * HZ;
-		timeout += jiffies;
+		usec = get_fs_long((unsigned long *) & tvp->tv_usec);
+		sec = get_fs_long((unsigned long *) & tvp->tv_sec);
+		if (!sec && !usec)
+			current->timeout = 0;
 	}
-	current->timeout = timeout;             						// 设置当前进程应该延时的嘀嗒值。
 	// select()函数的主要工作在do_select()中完成。在调用该函数之后的代码用于把处理结果复制到用户数据区中，返回给用户。为了避免出现
-	// 竞争条件，在调用do_select()前需要禁止中断，并在该函数返回后再开启中断。
-	// 如果在do_select()返回之后进程的等待延时字段timeout还大于当前系统计时嘀嗒值jiffies，说明在超时之前已经有描述准备好，于是这里
-	// 我们先记下到超时还剩余的时间值，随后我们会把这个值返回给用户。如果进程的等待延时字段timeout已经小于或等于当前系统jiffies，表示
-	// do_select()可能是由于超时而返回，因此把剩余时间值设置为0。
+	// 竞争条件，在设置定时器和调用do_select()前需要禁止中断，并在该函数返回后再开启中断。
+	// 如果在do_select()返回之后定时器还没有到期，说明在超时之前已经有描述准备好，于是这里我们先记下到超时还剩余的时间值，随后我们会
+	// 把这个值返回给用户并取消定时器。否则剩余时间值为0。
 	cli();                  										// 禁止响应中断。
+	if (sec || usec) {
+		timer->fn = select_timeout;
+		timer->data = (unsigned long) current;
+		set_hrtimer(timer, sec, usec);
+	}
 	i = do_select(in, out, ex, &res_in, &res_out, &res_ex);
-	if (current->timeout > jiffies)
-		timeout = current->timeout - jiffies;
-	else
-		timeout = 0;
+	hrtimer_left(timer, &sec, &usec);
+	del_hrtimer(timer);
 	sti();                  										// 开启中断响应。
 	// 接下来我们把进程的超时字段清零。如果do_select()返回的已准备好描述符个数小于0，表示执行出错，于是返回这个错误号。然后我们把处理过
-	// 的描述符集内容和延迟时间结构内容写回到用户数据缓冲空间。在时间结构内容时还需要先将嘀嗒时间单位表示的剩余延迟时间转换成秒和微秒值。
+	// 的描述符集内容和剩余的等待时间写回到用户数据缓冲空间。
 	current->timeout = 0;
 	if (i < 0)
 		return i;
@@ -361,10 +373,8 @@ int sys_select( unsigned long *buffer )
 	}
 	if (tvp) {
 		verify_area(tvp, sizeof(*tvp));
-		put_fs_long(timeout / HZ, (unsigned long *) &tvp->tv_sec);  // 秒。
-		timeout %= HZ;
-		timeout *= (1000000 / HZ);
-		put_fs_long(timeout, (unsigned long *) &tvp->tv_usec);      // 微秒。
+		put_fs_long(sec, (unsigned long *) &tvp->tv_sec);           // 秒。
+		put_fs_long(usec, (unsigned long *) &tvp->tv_usec);         // 微秒。
 	}
 	// 如果此时并没有已准备好的描述符，并且收到了某个非阻塞信号，则返回被中断错误号。否则返回已准备好的描述符个数值。
 	if (!i && (current->signal & ~current->blocked))
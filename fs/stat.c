@@ -84,7 +84,7 @@ int sys_fstat(unsigned int fd, struct stat * statbuf)
 	// 首先取文件句柄对应的文件结构，然后从中得到文件的i节点。然后将i节点上的文件状态信息复制到用户缓冲区中。如果
 	// 文件句柄值大于一个程序最多打开文件数NR_OPEN，或者该句柄的文件结构指针为空，或者对应文件结构的i节点字段为空，
 	// 则出错，返回出错码并退出。
-	if (fd >= NR_OPEN || !(f = current->filp[fd]) || !(inode = f->f_inode)) {
+	if (fd >= NR_OPEN || !(f = current->files->fd[fd]) || !(inode = f->f_inode)) {
 		return -EBADF;
 	}
 	cp_stat(inode, statbuf);
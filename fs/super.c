@@ -263,7 +263,7 @@ int sys_umount(char * dev_name)
 		return -ENOENT;
 	if (!sb->s_imount->i_mount)
 		printk("Mounted inode has i_mount=0\n");
-	for (inode = inode_table + 0 ; inode < inode_table + NR_INODE ; inode++)
+	for (inode = first_inode ; inode ; inode = inode->i_next)
 		if (inode->i_dev == dev && inode->i_count)
 				return -EBUSY;
 	// 现在该设备上文件系统的卸载条件均得到满足，因此我们可以开始实施真正的卸载操作了。首先复位被安装到的i节点的安装标志，释放该
@@ -337,7 +337,7 @@ int sys_mount(char * dev_name, char * dir_name, int rw_flag)
 }
 
 // 安装根文件系统.
-// 该函数属于系统初始化操作的一部分.函数首先初始化文件表数组file_table[]和超级块表(数组),然后读取根文件系统超级块,并取得文件系统根i
+// 该函数属于系统初始化操作的一部分.函数首先初始化超级块表(数组),然后读取根文件系统超级块,并取得文件系统根i
 // 节点.最后统计并显示出根文件系统上的可用资源(空闲块数和空闲i节点数0.该函数会在系统开机进行初始化设置时(sys_setup())调用(blk_drv/hd.c)>
 void mount_root(void)
 {
@@ -348,10 +348,8 @@ void mount_root(void)
 	// 若磁盘i节点结构不是32字节,则出错停机.该判断用于防止修改代码时出现不一致情况.
 	if (32 != sizeof (struct d_inode))
 		panic("bad i-node size");
-	// 首先初始化文件表数组(共64项,即系统同时只能打开64个文件)和超级块表.这里将所有文件结构中的引用计数设置为0(表示空闲),并把超级块表中各项结构
-	// 的设备字段初始化为0(也表示空闲).如果根文件系统所在设备是软盘的话,就提示"插入根文件系统盘,并按回车键",并等待按键.
-	for(i = 0; i < NR_FILE; i++)									// 初始化文件表.
-		file_table[i].f_count = 0;
+	// 首先初始化超级块表.文件结构在打开文件时才从对象缓存中分配,不需要初始化.这里把超级块表中各项结构的设备字段初始化为0(表示空闲).
+	// 如果根文件系统所在设备是软盘的话,就提示"插入根文件系统盘,并按回车键",并等待按键.
 	if (MAJOR(ROOT_DEV) == 2) {										// 提示插入根文件系统盘.
 		printk("Insert root floppy and press ENTER\r\n");
 		wait_for_keypress();
@@ -372,8 +370,8 @@ void mount_root(void)
 	mi->i_count += 3 ;												/* NOTE! it is logically used 4 times, not 1 */
                                 									/* 注意!从逻辑上讲,它已被引用了4次,而不是1次 */
 	p->s_isup = p->s_imount = mi;
-	current->pwd = mi;
-	current->root = mi;
+	current->fs->pwd = mi;
+	current->fs->root = mi;
 	// 然后我们对根文件系统上的资源作统计工作.统计该设备上空闲块数和空闲i节点数.首先令i等于超级块中表明的设备逻辑块总数.然后根据逻辑块位图中相应位的占用情况统计出空闲块数.
 	// 这里宏函数set_bit()只是在测试位,而非设置位."i&8191"用于取得i节点号在当前位图块中对应的位偏移值."i>>13"是将i除以8192,也即除一个磁盘块包含的位数.
 	free = 0;
@@ -82,6 +82,8 @@ void truncate(struct m_inode * inode)
 	if (!(S_ISREG(inode->i_mode) || S_ISDIR(inode->i_mode) ||
 	     S_ISLNK(inode->i_mode)))
 		return;
+	// 文件数据块将被释放(i节点也可能随后被重新使用),删除该文件在页面缓存中的页面.
+	invalidate_inode_pages(inode);
 	// 然后释放i节点的7个直接逻辑块，并将这7个逻辑块项全置零。函数free_block()用于释放设备上指定逻辑块的磁盘块
 	// （fs/bitmap.c）。若有逻辑块忙而没有被释放则置块忙标志block_busy。
 repeat:
@@ -22,6 +22,14 @@ __asm__ (\
 #define cli() __asm__ ("cli"::)										// 关中断.
 #define nop() __asm__ ("nop"::)										// 空操作.
 
+// 保存和恢复标志寄存器(主要是其中的中断允许标志IF).
+// 在可能已经关中断的地方(例如中断处理程序中)使用cli()/sti()会在退出临界区时错误地开中断,这时应先用save_flags()保存标志,cli()关中断,
+// 退出临界区时再用restore_flags()恢复原来的中断状态.
+#define save_flags(x) \
+__asm__ __volatile__("pushfl ; popl %0":"=r" (x)::"memory")
+#define restore_flags(x) \
+__asm__ __volatile__("pushl %0 ; popfl"::"r" (x):"memory")
+
 #define iret() __asm__ ("iret"::)									// 中断返回
 
 // 设置门描述符宏.
@@ -61,8 +61,7 @@ void buffer_init(long buffer_end);		// 高速缓冲区初始化函数
 #define SUPER_MAGIC 0x137F				// 文件系统魔数
 
 #define NR_OPEN 		20				// 进程最多打开文件数
-#define NR_INODE 		64				// 系统同时最多使用I节点个数
-#define NR_FILE 		64				// 系统最多文件个数(文件数组项数)
+#define NR_INODE 		64				// 内存i节点个数达到该值后优先重用空闲i节点,而不再分配新的
 #define NR_SUPER 		8				// 系统所含超级块个数(超级块数组项数)
 #define NR_HASH 		307				// 缓冲区Hash表数组大小
 #define NR_BUFFERS 		nr_buffers		// 系统所含缓冲个数.初始化后不再改变
@@ -141,6 +140,9 @@ struct m_inode {
 	/* these are in memory also */
 	struct task_struct * i_wait;		// 等待该i节点的进程
 	struct task_struct * i_wait2;		/* for pipes */
+	struct task_struct * i_exec_tasks;	// 以该i节点为执行文件的任务链表(经task->exec_next链接)
+	struct task_struct * i_lib_tasks;	// 以该i节点为库文件的任务链表(经task->lib_next链接)
+	struct m_inode * i_next;			// 内存i节点链表中的下一项
 	unsigned long i_atime;				// 最后访问时间
 	unsigned long i_ctime;				// i节点自身修改时间
 	unsigned short i_dev;				// i节点所在的设备号
@@ -152,6 +154,7 @@ struct m_inode {
 	unsigned char i_mount;				// 安装标志
 	unsigned char i_seek;				// 搜寻标志(lseek时)
 	unsigned char i_update;				// 更新标志
+	unsigned short i_cached;			// 页面缓存中该文件的页面数
 };
 
 // 文件结构(用于在文件句柄与i节点之间建立关系)
@@ -204,8 +207,9 @@ struct dir_entry {
 	char name[NAME_LEN];				// 文件名,长度NAME_LEN=14
 };
 
-extern struct m_inode inode_table[NR_INODE];	// 定义i节点表数组(64项).
-extern struct file file_table[NR_FILE];			// 文件表数组(64项).
+extern struct m_inode * first_inode;			// 内存i节点链表(从i节点对象缓存中分配).
+extern int nr_inodes;							// 内存i节点个数.
+extern int nr_files;							// 使用中的文件结构个数.
 extern struct super_block super_block[NR_SUPER];// 超级块数组(8项).
 extern struct buffer_head * start_buffer;		// 缓冲区起始内存位置.
 extern int nr_buffers;
@@ -229,7 +233,11 @@ extern int open_namei(const char * pathname, int flag, int mode,
 	struct m_inode ** res_inode);                           	// 根据路径名为打开文件操作作准备。
 extern void iput(struct m_inode * inode);                       // 释放一个i节点（回写入设备）。
 extern struct m_inode * iget(int dev,int nr);                   // 从设备读取指定节点号的一个i节点.
-extern struct m_inode * get_empty_inode(void);                  // 从i节点表（inode_table）中获取一个空闲i节点项。
+extern struct m_inode * get_empty_inode(void);                  // 从内存i节点链表中获取（或新分配）一个空闲i节点项。
+extern struct file * get_empty_filp(void);                      // 分配一个文件结构，引用计数置为1。
+extern void free_filp(struct file * f);                         // 释放引用计数已为0的文件结构。
+extern void inode_init(void);                                   // 建立i节点对象缓存。
+extern void file_table_init(void);                              // 建立文件结构对象缓存。
 extern struct m_inode * get_pipe_inode(void);                   // 获取（申请一）管道节点。返回为i节点指针（如果是NULL则失败）。
 extern struct buffer_head * get_hash_table(int dev, int block); // 在哈希表中查找指定的数据块。返回找到的缓冲头指针。
 extern struct buffer_head * getblk(int dev, int block);         // 从设备读取指定块(首先会在hash表中查找).
@@ -238,6 +246,7 @@ extern void ll_rw_page(int rw, int dev, int nr, char * buffer); // 读/写数据
 extern void brelse(struct buffer_head * buf);                   // 释放指定缓冲块。
 extern struct buffer_head * bread(int dev,int block);           // 读取指定的数据块.
 extern void bread_page(unsigned long addr,int dev,int b[4]);    // 读取设备上一个页面(4个缓冲块)的内容到指定内存地址处。
+extern void prefetch_page(int dev,int b[4]);                    // 预读设备上一个页面(4个缓冲块)到高速缓冲中,不等待。
 extern struct buffer_head * breada(int dev,int block,...);      // 读取头一个指定的数据块,并标记后续将要读的块.
 extern int new_block(int dev);                                  // 向设备dev申请一个磁盘块（区段，逻辑块）。返回逻辑块号。
 extern int free_block(int dev, int block);                      // 释放设备数据区中的逻辑块（区段，逻辑块）block。
@@ -6,13 +6,18 @@ typedef struct desc_struct {	// 定义了段描述符的数据结构.该结构
 	unsigned long a,b;
 } desc_table[256];
 
-extern unsigned long pg_dir[1024];	// 内存页目录数组.每个目录项为4字节.从物理地址0开始.
-extern desc_table idt,gdt;		    // 中断描述符表,全局描述符表.
+extern unsigned long pg_dir[1024];	// 内存页目录数组.每个目录项为4字节.从物理地址0开始.任务0的页目录,其他任务的页目录从它复制内核部分.
+#define GDT_ENTRIES 512				// 全局描述符表项数(boot/head.s).
+extern desc_table idt;				// 中断描述符表.
+extern struct desc_struct gdt[GDT_ENTRIES];	// 全局描述符表.
 
 #define GDT_NUL 0			// 全局描述符表的第0 ,不用
 #define GDT_CODE 1			// 第1项,是内核代码段描述符项.
 #define GDT_DATA 2			// 第2项,是内核数据段描述符项.
 #define GDT_TMP 3			// 第3项,系统段描述符,Linux没有使用.
+// 最后4项是快速系统调用SYSENTER/SYSEXIT使用的平坦段(kernel/sched.c).SYSENTER装入选择符GDT_SYSENTER*8和其后一项,SYSEXIT装入再后面
+// 两项(特权级3),因此这4项的次序是处理器规定的.
+#define GDT_SYSENTER (GDT_ENTRIES - 4)
 
 #define LDT_NUL 0			// 每个局部描述符表的第0项,不用.
 #define LDT_CODE 1			// 第1项,是用户程序代码段描述符项.
@@ -7,20 +7,106 @@
 #include <linux/kernel.h>
 #include <signal.h>
 
-extern int SWAP_DEV;		// 内存页面交换设备号.定义在mm/swap.c文件中.
+extern int SWAP_DEV;		// 启动时指定的内存页面交换设备号.定义在mm/swap.c文件中.
 
-// 从交换设备读入和写出被交换内存页面.ll_rw_page()定义在blk_drv/ll_rw_block.c文件中.
-// 参数nr是主内存区中页面号;buffer是读/写缓冲区.
-#define read_swap_page(nr, buffer)   ll_rw_page(READ, SWAP_DEV, (nr), (buffer));
-#define write_swap_page(nr, buffer)  ll_rw_page(WRITE, SWAP_DEV, (nr), (buffer));
+// 系统中同时可以启用的交换区(交换设备)最大个数.
+#define MAX_SWAPFILES 8
+
+// 交换页面项.被换出页面的页表项中存放的不再只是交换页面号,而是由交换区号(type)和该交换区中的页面号(offset)组合成的交换项
+// (entry).位0是存在位P,必须为0;位1-7存放交换区号;位12-31存放交换区中的页面号.由于页面号0是交换区管理页面,因此有效交换项
+// 永远不会为0.
+#define SWP_ENTRY(type, offset) (((type) << 1) | ((offset) << 12))
+#define SWP_TYPE(entry) (((entry) >> 1) & 0x7f)
+#define SWP_OFFSET(entry) ((entry) >> 12)
+
+// 从交换区读入和写出被交换内存页面.rw_swap_page()定义在mm/swap.c中,它根据交换项中的交换区号找到对应设备后再调用ll_rw_page().
+// 参数nr是交换项;buffer是读/写缓冲区.
+extern void rw_swap_page(int rw, unsigned long entry, char * buffer);
+extern unsigned long get_swap_page(void);	// 申请一个交换页面,返回交换项(没有则返回0).
+#define read_swap_page(nr, buffer)   rw_swap_page(READ, (nr), (buffer));
+#define write_swap_page(nr, buffer)  rw_swap_page(WRITE, (nr), (buffer));
 
 extern unsigned long get_free_page(void);	// 在主内存区中取空闲物理页面.如果已经没有可有内存了,则返回0
+extern unsigned long get_free_page_nozero(void);	// 同上,但不清零页面.用于随后会整页覆盖页面内容的场合.
+extern unsigned long get_free_page_atomic(void);	// 同上,但不会睡眠(不做交换处理),可以在中断中使用.
+extern void fill_zeroed_pages(void);		// 空闲时预先清零一些空闲页面,供get_free_page()使用.
+extern int nr_zeroed_pages;					// 已预先清零的空闲页面数.
 extern unsigned long put_dirty_page(unsigned long page,unsigned long address);      // 把一内容已修改过的物理内存页面映射到线性地址空间处。与put_page()几乎完全一样。
 extern void free_page(unsigned long addr);	// 释放物理地址addr开始的1页面内存。
 extern void init_swapping(void);			// 内存交换初始化
-void swap_free(int page_nr);				// 释放编号page_nr的1页面交换页面
+void swap_free(unsigned long entry);		// 释放交换项entry对应的1页面交换页面
 void swap_in(unsigned long *table_ptr);		// 把页表项是table_ptr的一页物理内存换出到交换空间
 
+// 压缩交换缓存(mm/zswap.c).被换出的页面先压缩保存在内存页面池中,池满时才写到交换设备上.
+// zswap_store()的返回值:
+#define ZSWAP_NONE		0					// 页面没有被保存,需写到交换设备上.
+#define ZSWAP_STORED	1					// 页面已压缩保存.
+#define ZSWAP_KEPT		2					// 页面已压缩保存,并且页面本身已被收归页面池.
+extern int zswap_store(unsigned long entry, unsigned long page);
+extern int zswap_load(unsigned long entry, char * buffer);
+extern void zswap_invalidate(unsigned long entry);
+extern void zswap_show(void);
+
+// 执行文件和库文件代码页面的页面缓存(mm/filemap.c).按(设备号,i节点号,逻辑块号)查找.
+struct m_inode;
+extern unsigned long find_page_cache(struct m_inode * inode, int block);
+extern int add_page_cache(unsigned long page, struct m_inode * inode, int block);
+extern void invalidate_inode_pages(struct m_inode * inode);
+extern void invalidate_dev_pages(int dev);
+extern int shrink_page_cache(void);
+extern void page_cache_show(void);
+
+// 内核对象缓存(mm/slab.c).分配固定大小的内核对象,如i节点,文件结构,块设备请求项和定时器.
+// 分配优先级:GFP_KERNEL表示需要时可以申请页面并睡眠;GFP_ATOMIC表示不能睡眠,用于中断中或关中断时.
+#define GFP_KERNEL	0
+#define GFP_ATOMIC	1
+struct kmem_cache;
+extern struct kmem_cache * kmem_cache_create(const char * name, int size, int reserve);
+extern void * kmem_cache_alloc(struct kmem_cache * cachep, int priority);
+extern void kmem_cache_free(struct kmem_cache * cachep, void * obj);
+extern int kmem_cache_shrink(void);
+extern void kmem_cache_show(void);
+
+// 进程的内存映射区(mm/mmap.c).由mmap()建立,按起始地址从小到大链接在任务结构的mmap字段上.地址都是进程逻辑地址,并且页面对齐.
+// 文件映射区的页面通过页面缓存读入:私有映射与执行文件页面一样写时复制,共享映射的页面被所有映射它的进程共用,在msync()或解除映射时写回文件.
+#define VM_READ		0x01					// 可读(与PROT_READ相同).
+#define VM_WRITE	0x02					// 可写(与PROT_WRITE相同).
+#define VM_EXEC		0x04					// 可执行(与PROT_EXEC相同).
+#define VM_SHARED	0x08					// 共享映射(MAP_SHARED).
+
+struct shm_seg;
+struct vm_area_struct {
+	unsigned long vm_start;					// 映射区开始地址.
+	unsigned long vm_end;					// 映射区结束地址(不含).
+	unsigned long vm_offset;				// vm_start处对应的文件偏移.
+	struct m_inode * vm_inode;				// 被映射文件的i节点,匿名映射为NULL.
+	struct shm_seg * vm_shm;				// 附加的共享内存段(shmat()),vm_offset是段内偏移.
+	unsigned short vm_flags;				// VM_*标志.
+	struct vm_area_struct * vm_next;		// 下一个映射区.
+};
+
+struct mm_struct;
+
+extern void zap_page_range(unsigned long from, unsigned long size);
+extern int do_mmap(unsigned long addr, unsigned long len, int vm_flags, int fixed,
+	struct m_inode * inode, unsigned long off, struct shm_seg * shm);
+extern int do_munmap(unsigned long start, unsigned long end);
+extern void lock_mmap(struct mm_struct * mm);
+extern void unlock_mmap(struct mm_struct * mm);
+
+// System V共享内存段(mm/shm.c).段的页面由段自己持有一个引用,附加它的进程通过映射区映射这些页面.
+struct shm_seg;
+extern void shm_open(struct vm_area_struct * vma);
+extern void shm_close(struct vm_area_struct * vma);
+extern unsigned long shm_nopage(struct vm_area_struct * vma, unsigned long offset);
+extern int shm_swap(void);
+extern int shm_unuse(int type);
+extern void shm_show(void);
+
+// 相同页面合并(mm/ksm.c).由任务0在空闲时扫描各任务的私有页面,把内容相同的页面合并成一个只读共享页面.
+extern void ksm_scan(void);
+extern void ksm_show(void);
+
 // 下面函数名前关键字volatile用于告诉编译器gcc该函数不会返回.这样可让gcc产生更好的代码,更重要的是使用这个关键字
 // 可以避免产生某些(未初始化变量的)假警告信息.
 static inline void oom(void)
@@ -30,26 +116,61 @@ static inline void oom(void)
 	do_exit(SIGSEGV);
 }
 
+// 页变换高速缓冲刷新统计和CPU是否支持invlpg指令的标志.定义在mm/memory.c中.
+extern int invlpg_ok;
+// cr0中的写保护位WP是否已置位.置位后内核态写用户只读页面也会引起写保护异常,verify_area()不必再预先复制页面.
+extern int wp_works_ok;
+extern unsigned long tlb_full_flushes, tlb_page_flushes;
+
 // 刷新页变换高速缓冲宏函数.
 // 为了提高地址转换的效率,CPU将最近使用的页表数据存放在芯片中高速缓冲中.在修改过页表信息之后,就需要刷新该缓冲区.
-// 这里使用重新加载页目录重新加载页目录基址寄存器cr3的方法来进行刷新.下面eax = 0,是页目录的基址.
-#define invalidate() __asm__("movl %%eax,%%cr3"::"a" (0))
+// 这里使用重新加载页目录重新加载页目录基址寄存器cr3的方法来进行刷新.每个任务有自己的页目录,因此重新加载cr3的当前值.
+#define invalidate() \
+do { \
+	tlb_full_flushes++; \
+	__asm__ __volatile__("movl %%cr3,%%eax ; movl %%eax,%%cr3":::"ax"); \
+} while (0)
+
+// 取页目录dir中线性地址address对应的目录项指针.dir是页目录的物理地址(即任务的tss.cr3),内核对物理内存是恒等映射的.
+#define PAGE_DIR_OFFSET(dir, address) ((unsigned long *) ((dir) + (((address) >> 20) & 0xffc)))
+
+// 刷新线性地址address所在页面的页变换高速缓冲项.
+// 只修改了一个页表项时不必丢弃整个高速缓冲.486及以后的CPU有invlpg指令,可以只使一个页面的缓冲项无效;386上没有该指令,只能重新加载cr3.
+static inline void invalidate_page(unsigned long address)
+{
+	if (!invlpg_ok) {
+		invalidate();
+		return;
+	}
+	tlb_page_flushes++;
+	__asm__ __volatile__("invlpg (%0)"::"r" (address):"memory");
+}
 
 /* these are not to be changed without changing head.s etc */
 /* 下面定义若需要改动,则需要与head.s等文件 的相关信息一起改变 */
-// Linux0.12内核默认支持的最大内存容量是16MB,可以修改这些定义以适合更多的内存.
+// 内核对物理内存做恒等映射,映射位于所有任务线性地址空间之下(0-1GB,见sched.h中TASK_BASE),因此最多支持1GB物理内存.前16MB由head.s映射,
+// 其余由mem_init()映射.
 #define LOW_MEM 0x100000			             // 机器物理内存低端(1MB)
 extern unsigned long HIGH_MEMORY;		         // 存放实际物理内存最高端地址.
-#define PAGING_MEMORY (15 * 1024 * 1024)         // 分页内存15MB.主内存区最多15MB.
-#define PAGING_PAGES (PAGING_MEMORY >> 12)	     // 分页后的物理内存页面数(3840).
+#define MAX_MEMORY (1024 * 1024 * 1024)          // 支持的最大物理内存1GB.
+extern unsigned long paging_pages;		         // 实际分页管理的物理内存页面数((HIGH_MEMORY - LOW_MEM) >> 12).
 #define MAP_NR(addr) (((addr) - LOW_MEM) >> 12)	 // 指定内存地址映射为页面号.
 #define USED 100				                 // 页面被占用标志.
 
-// 内存映射字节图(1字节代表1页内存).每个页面对应的字节用于标志页面当前被引用(占用)次数.它最大可以映射15MB的内存空间.在初始化函数
-// mem_init()中,对于不能用作主内存区页面的位置均都参选被设置成USED(100).
-extern unsigned char mem_map [ PAGING_PAGES ];
+// 内存映射字节图(1字节代表1页内存).每个页面对应的字节用于标志页面当前被引用(占用)次数.它由mem_init()在主内存区开始处按实际内存大小
+// 分配,共paging_pages项.对于不能用作主内存区页面的位置均都被设置成USED(100).
+extern unsigned char * mem_map;
+extern long mem_init(long start_mem, long end_mem);	// 初始化内存管理,返回扣除页表和mem_map[]后的主内存区开始地址.
+extern void reserve_page(unsigned long addr);	// 把物理页面标记为不可用(内存空洞).
+
+// 全零页面(boot/head.s).它位于1MB以下,不受mem_map[]管理,因此可以被任意多个页表项只读引用.
+extern unsigned long empty_zero_page[1024];
+#define ZERO_PAGE ((unsigned long) empty_zero_page)
 
 // 下面定义的符号常量对应页目录表项和页表(二级页表)项中的一些标志位.
+#define PAGE_LOCKED	         0x200	            // 位9,页面被mlock()锁定,不会被交换出去.这是留给软件使用的位,CPU不使用它.
+#define PAGE_GLOBAL	         0x100	            // 位8,全局页面:重新加载cr3时不刷新其页变换高速缓冲项(需cr4中PGE位置位).
+#define PAGE_4M		         0x80	            // 位7,页目录项直接映射4MB页面(需cr4中PSE位置位).
 #define PAGE_DIRTY	         0x40	            // 位6,页面脏(已修改)
 #define PAGE_ACCESSED	     0x20	            // 位5,页面被访问过.
 #define PAGE_USER	         0x04	            // 位2,页面属于:1 - 用户;0 - 超级用户.
@@ -3,8 +3,11 @@
 
 #define HZ 100	// 定义系统时钟滴答频率(100Hz,每个滴答10ms)
 
-#define NR_TASKS		64			// 系统中同时最多任务(进程)数.
-#define TASK_SIZE		0x04000000	// 每个任务的长度(64MB).
+// 每个任务有自己的页目录,因此任务数不再受4GB线性空间划分的限制,只受全局描述符表大小的限制(每个任务占用2项).所有任务的代码和数据段
+// 基址都是TASK_BASE,其下是所有页目录共用的内核对物理内存的恒等映射.
+#define NR_TASKS		128			// 系统中同时最多任务(进程)数.
+#define TASK_BASE		0x40000000	// 任务线性地址空间的开始位置(1GB).
+#define TASK_SIZE		0xC0000000	// 每个任务的长度(3GB).
 #define LIBRARY_SIZE	0x00400000	// 动态加载库长度(4MB).
 
 #if (TASK_SIZE & 0x3fffff)
@@ -19,13 +22,21 @@
 #error "LIBRARY_SIZE too damn big!"		// 加载库的长度不得大于任务长度的一半
 #endif
 
-#if (((TASK_SIZE>>16)*NR_TASKS) != 0x10000)
-#error "TASK_SIZE*NR_TASKS must be 4GB"	// 任务长度*任务总个数必须为4GB
+#if ((TASK_BASE >> 22) + (TASK_SIZE >> 22) > 1024)
+#error "TASK_BASE+TASK_SIZE must fit in 4GB"	// 任务线性地址空间不能超出4GB
 #endif
 
-// 在进程逻辑地址空间中动态库被加载的位置(60MB)
+#if (TASK_BASE & 0x3fffff)
+#error "TASK_BASE must be multiple of 4M"	// 任务基址也必须是4MB的倍数
+#endif
+
+// 在进程逻辑地址空间中动态库被加载的位置(3GB-4MB)
 #define LIBRARY_OFFSET (TASK_SIZE - LIBRARY_SIZE)
 
+// mmap()映射区在进程逻辑地址空间中的范围(1GB-2GB).执行文件和brk()堆位于其下,栈和动态库位于其上.
+#define MMAP_BASE	(TASK_SIZE / 3)
+#define MMAP_END	(TASK_SIZE / 3 * 2)
+
 // 下面宏CT_TO_SECS和CT_TO_USECS用于把系统当前嘀嗒数转换成用秒值加微秒值表示
 #define CT_TO_SECS(x)	((x) / HZ)
 #define CT_TO_USECS(x)	(((x) % HZ) * 1000000 / HZ)
@@ -36,6 +47,10 @@
 #include <linux/head.h>
 #include <linux/fs.h>
 #include <linux/mm.h>
+
+#if (MAX_MEMORY > TASK_BASE)
+#error "The kernel identity map must fit below TASK_BASE"	// 内核恒等映射必须位于任务空间之下
+#endif
 #include <sys/param.h>
 #include <sys/time.h>
 #include <sys/resource.h>
@@ -57,9 +72,25 @@
 #endif
 
 // 复制进程的页目录页表.Linus认为这是内核中最复杂的函数之一.(mm/memory.c)
-extern int copy_page_tables(unsigned long from, unsigned long to, long size);
+// 参数from_dir和to_dir是源和目的页目录的物理地址(即任务的tss.cr3).
+extern int copy_page_tables(unsigned long from_dir, unsigned long from,
+	unsigned long to_dir, unsigned long to, long size);
 // 释放页表所指定的内存块及页表本身(mm/memory.c)
-extern int free_page_tables(unsigned long from, unsigned long size);
+extern int free_page_tables(unsigned long dir, unsigned long from, unsigned long size);
+// 为新任务申请页目录,其中已填好内核空间的目录项(mm/memory.c)
+extern unsigned long new_page_dir(void);
+// vfork()产生的子进程归还借用的父进程地址空间并唤醒父进程(kernel/fork.c)
+extern void vfork_release(void);
+// 新建只有当前任务使用的空地址空间结构(kernel/fork.c)
+extern struct mm_struct * new_mm(void);
+// 当前任务放弃对地址空间,文件系统信息和打开文件表的引用,最后一个使用者负责释放(kernel/fork.c)
+extern void exit_mm(void);
+extern void exit_fs(void);
+extern void exit_files(void);
+// 使当前任务有自己的一份打开文件表(kernel/fork.c)
+extern int unshare_files(void);
+// 当前任务退出共享信号处理句柄的任务环(kernel/signal.c)
+extern void exit_sighand(void);
 
 // 调度程序的初始化函数(kernel/sched.c)
 extern void sched_init(void);
@@ -74,6 +105,60 @@ extern int tty_write(unsigned minor,char * buf,int count);
 
 typedef int (*fn_ptr)();			// 定义函数指针类型.
 
+struct task_struct;
+
+// 定时器.按到期时间放在时间轮的各个槽中(kernel/sched.c).调用者提供存储,设置fn和data后用set_timer()加入,到期时以data为参数调用fn;
+// 到期之前可以用del_timer()取消.pprev为NULL表示定时器不在时间轮中,第一次使用之前须清零.
+struct timer_list {
+	struct timer_list * next;			// 槽中的下一项.
+	struct timer_list ** pprev;			// 指向前一项的next字段(或槽头指针).
+	unsigned long expires;				// 到期时刻(jiffies值).
+	void (*fn)();						// 定时处理函数.
+	unsigned long data;					// 传给定时处理函数的参数.
+};
+
+// 高精度定时器.到期时刻精确到8253的计数周期,按到期时刻排序放在链表中,由8253的单次计数中断触发(kernel/sched.c).用set_hrtimer()设置,
+// del_hrtimer()取消,pprev为NULL表示定时器不在链表中.
+struct hrtimer {
+	struct hrtimer * next;				// 链表中的下一项.
+	struct hrtimer ** pprev;			// 指向前一项的next字段(或链表头指针).
+	unsigned long expires;				// 到期时刻的滴答数(jiffies值).
+	unsigned long cycles;				// 到期时刻在该滴答中的计数周期数(0 - LATCH-1).
+	void (*fn)();						// 定时处理函数.
+	unsigned long data;					// 传给定时处理函数的参数.
+};
+
+struct prio_array;
+
+// 下面三个结构是clone()产生的线程可以与创建者共享的任务资源.每个结构都有一个引用计数,由共享它的任务共同持有,最后一个使用者退出
+// (或执行execve()换用自己的一份)时才释放.
+// 地址空间与页目录(tss.cr3)一同共享.扫描页表的代码(交换,页面合并,内存统计)只通过属主owner扫描一次共享的页表.
+struct mm_struct {
+	int count;							// 引用计数.
+	struct task_struct * owner;			// 属主任务.
+	unsigned long brk;					// 总长度(字节数)
+	unsigned long rss;					// 驻留内存的页面数(受RLIMIT_RSS限制).
+	unsigned long max_rss;				// 驻留内存页面数的最大值,由getrusage()返回.
+	struct vm_area_struct * mmap;		// mmap()映射区链表.
+	unsigned char mmap_lock;			// 映射区链表锁定标志,线程之间互斥地修改或跨睡眠使用映射区.
+	struct task_struct * mmap_wait;		// 等待映射区链表解锁的任务.
+};
+
+// 文件系统信息.
+struct fs_struct {
+	int count;							// 引用计数.
+	unsigned short umask;				// 文件创建属性屏蔽位
+	struct m_inode * pwd;				// 当前工作目录i节点结构指针
+	struct m_inode * root;				// 根目录i节点结构指针
+};
+
+// 打开文件表.
+struct files_struct {
+	int count;							// 引用计数.
+	unsigned long close_on_exec;		// 执行时关闭文件句柄位图标志.(include/fcntl.h)
+	struct file * fd[NR_OPEN];			// 文件结构指针表,最多32项.表项号即是文件描述符的值
+};
+
 // 下面是数学协处理器使用的结构，主要用于保存进程切换时i387的执行状态信息。
 struct i387_struct {
 	long	cwd;            	// 控制字（Control word）。
@@ -129,7 +214,6 @@ struct tss_struct {
 // unsigned long start_code				代码段地址.
 // unsigned long end_code				代码长度(字节数).
 // unsigned long end_data				代码长度+数据长度(字节数)
-// unsigned long brk					总长度(字节数)
 // unsigned long start_stack			堆栈段地址.
 // long pid								进程标识号(进程号)
 // long pgrp							进程组号.
@@ -158,13 +242,22 @@ struct tss_struct {
 // unsigned short used_math				标志:是否使用了协处理器.
 // ----------------------
 // int tty;								进程使用tty终端的子设备号.-1表示没有使用.
-// unsigned short umask					文件创建属性屏蔽位.
-// struct m_inode * pwd					当前工作目录i节点结构指针.
-// struct m_inode * root				根目录i节点结构指针.
 // struct m_inode * executable			执行文件i节点结构指针.
 // struct m_inode * library				被加载库文件i节点结构指针.
-// unsigned long close_on_exec			执行时关闭文件句柄位图标志.(include/fcntl.h)
-// struct file * filp[NR_OPEN]			文件结构指针表,最多32项.表项号即是文件描述符的值.
+// struct task_struct * exec_next		执行文件i节点任务链表中下一个任务.
+// struct task_struct * lib_next		库文件i节点任务链表中下一个任务.
+// struct mm_struct * mm				地址空间(页表,brk,映射区链表),可以被线程共享.
+// struct fs_struct * fs				文件系统信息(umask,pwd,root),可以被线程共享.
+// struct files_struct * files			打开文件表,可以被线程共享.
+// struct task_struct * sig_next		共享信号处理句柄的任务环形链表中下一个任务.
+// struct task_struct * run_next		就绪队列中的下一个任务,为NULL时不在就绪队列中.
+// struct task_struct * run_prev		就绪队列中的上一个任务.
+// struct prio_array * array			所在的就绪队列组.
+// int run_level						所在就绪队列的级别.
+// unsigned long epoch					counter最后一次按重新计算次数补算时的sched_epoch.
+// struct timer_list timeout_timer		超时定时器(timeout).
+// struct timer_list alarm_timer		报警定时器(alarm).
+// struct hrtimer sleep_timer			睡眠定时器(nanosleep()和select()).
 // struct desc_struct ldt[3]			局部描述符表, 0 - 空,1 - 代码段cs,2 - 数据和堆栈段ds&ss.
 // struct tss_struct tss				进程的任务状态段信息结构.
 // ==============================================
@@ -183,7 +276,6 @@ struct task_struct {
 	unsigned long start_code;			// 代码段地址
 	unsigned long end_code;				// 代码长度(字节数)
 	unsigned long end_data;				// 代码长度+数据长度(字节数)
-	unsigned long brk;					// 总长度(字节数)
 	unsigned long start_stack;			// 堆栈段地址
 	long pid;							// 进程标识号(进程号)
 	long pgrp;							// 进程组号
@@ -215,18 +307,30 @@ struct task_struct {
 	struct rlimit rlim[RLIM_NLIMITS];	// 进程资源使用统计数组.
 	/* per process flags, defined below */
 	unsigned int flags;					// 各进程的标志
+	unsigned long locked_pages;			// 用mlock()锁定在内存中的页面数(受RLIMIT_MEMLOCK限制).
+	unsigned long swap_address;			// 超出RLIMIT_RSS时换出自己页面的扫描位置(线性地址).
 	unsigned short used_math;			// 标志:是否使用了协处理器.
 
 	/* file system info */
 	/* -1 if no tty, so it must be signed */
 	int tty;							// 进程使用tty终端的子设备号.-1表示没有使用
-	unsigned short umask;				// 文件创建属性屏蔽位
-	struct m_inode * pwd;				// 当前工作目录i节点结构指针
-	struct m_inode * root;				// 根目录i节点结构指针
 	struct m_inode * executable;		// 执行文件i节点结构指针
 	struct m_inode * library;			// 被加载库文件i节点结构指针
-	unsigned long close_on_exec;		// 执行时关闭文件句柄位图标志.(include/fcntl.h)
-	struct file * filp[NR_OPEN];		// 文件结构指针表,最多32项.表项号即是文件描述符的值
+	struct task_struct * exec_next;		// 执行文件i节点任务链表中下一个任务
+	struct task_struct * lib_next;		// 库文件i节点任务链表中下一个任务
+	struct mm_struct * mm;				// 地址空间.
+	struct fs_struct * fs;				// 文件系统信息.
+	struct files_struct * files;		// 打开文件表.
+	struct task_struct * sig_next;		// 共享信号处理句柄的任务环形链表,不共享时指向自己.
+	/* run queue, see kernel/sched.c */
+	struct task_struct * run_next;		// 就绪队列中的下一个任务,为NULL时不在就绪队列中.
+	struct task_struct * run_prev;		// 就绪队列中的上一个任务.
+	struct prio_array * array;			// 所在的就绪队列组(活动的或时间片已用完的).
+	int run_level;						// 所在就绪队列的级别.
+	unsigned long epoch;				// counter已补算到的时间片重新计算次数.
+	struct timer_list timeout_timer;	// 超时定时器,到期时清timeout并唤醒任务.
+	struct timer_list alarm_timer;		// 报警定时器,到期时发送SIGALRM.
+	struct hrtimer sleep_timer;			// 高精度睡眠定时器,到期时唤醒任务.
 	/* ldt for this task 0 - zero 1 - cs 2 - ds&ss */
 	struct desc_struct ldt[3];			// 局部描述符表, 0 - 空,1 - 代码段cs,2 - 数据和堆栈段ds&ss
 	/* tss for this task */
@@ -239,6 +343,36 @@ struct task_struct {
 /* 每个进程的标志 */    /* 打印对齐警告信息。还未实现，仅用于486 */
 #define PF_ALIGNWARN	0x00000001	/* Print alignment warning msgs */
 					/* Not implemented yet, only for 486*/
+#define PF_VFORK		0x00000002	/* Borrowing the parent's memory (vfork) */
+					/* 正在借用父进程的地址空间(vfork) */
+#define PF_MLOCKALL		0x00000004	/* mlockall(MCL_FUTURE): never swap out */
+					/* mlockall(MCL_FUTURE):页面都不会被交换出去 */
+
+/*
+ * clone() flags
+ */
+/* clone()标志:子进程与创建者共享哪些资源 */
+#define CLONE_VM		0x00000100	/* share the address space */
+#define CLONE_FS		0x00000200	/* share umask, cwd and root */
+#define CLONE_FILES		0x00000400	/* share the open file table */
+#define CLONE_SIGHAND	0x00000800	/* share signal handlers (needs CLONE_VM) */
+
+// 任务p是否是其地址空间的属主.已退出的任务没有地址空间;vfork()子进程和clone(CLONE_VM)产生的线程与属主共用页表,扫描页表的代码
+// 跳过它们,以免重复扫描.
+#define mm_owner(p) ((p)->mm && (p)->mm->owner == (p))
+
+// 进程驻留页面数的增减.页面被映射(put_page(),swap_in()等)时增加,被换出或释放时减少.
+// 驻留页面数按地址空间统计,共用地址空间的线程一起计算.
+#define inc_rss(p) \
+do { \
+	if (++(p)->mm->rss > (p)->mm->max_rss) \
+		(p)->mm->max_rss = (p)->mm->rss; \
+} while (0)
+#define dec_rss(p) \
+do { \
+	if ((p)->mm->rss) \
+		(p)->mm->rss--; \
+} while (0)
 
 /*
  *  INIT_TASK is used to set up the first task table, touch at
@@ -252,7 +386,7 @@ struct task_struct {
 #define INIT_TASK {\
 	/* state etc */ 0, 15, 15, \
 	/* signals */	0, {{},}, 0, \
-	/* ec,brk... */	0, 0, 0, 0, 0, 0, \
+	/* ec,stack.. */	0, 0, 0, 0, 0, \
 	/* pid etc.. */	0, 0, 0, 0, \
 	/* suppl grps*/ {NOGROUP,}, \
 	/* proc links*/ &init_task.task, 0, 0, 0, \
@@ -260,11 +394,15 @@ struct task_struct {
 	/* timeout */	0, 0, 0, 0, 0, 0, 0, \
 	/* rlimits */   { {0x7fffffff, 0x7fffffff}, {0x7fffffff, 0x7fffffff},  \
 		  			{0x7fffffff, 0x7fffffff}, {0x7fffffff, 0x7fffffff}, \
-		  			{0x7fffffff, 0x7fffffff}, {0x7fffffff, 0x7fffffff}}, \
-	/* flags */		0, \
+		  			{0x7fffffff, 0x7fffffff}, {0x7fffffff, 0x7fffffff}, \
+		  			{0x7fffffff, 0x7fffffff}}, \
+	/* flags */		0, 0, \
+	/* swap */		0, \
 	/* math */		0, \
-	/* fs info */	-1, 0022, NULL, NULL, NULL, NULL, 0, \
-	/* filp */		{NULL,}, \
+	/* fs info */	-1, NULL, NULL, NULL, NULL, \
+	/* shared */	&init_mm, &init_fs, &init_files, &init_task.task, \
+	/* sched */		NULL, NULL, NULL, 0, 0, {NULL, NULL, 0, NULL, 0}, {NULL, NULL, 0, NULL, 0}, \
+					{NULL, NULL, 0, 0, NULL, 0}, \
 	/* ldt */ \
 					{ \
 						{0,0}, \
@@ -283,8 +421,15 @@ struct task_struct {
 extern struct task_struct *task[NR_TASKS];								//　任务指针数组.
 extern struct task_struct *last_task_used_math;							// 上一个使用过协处理器的进程
 extern struct task_struct *current;										// 当前运行进程结构指针变量.
+extern struct mm_struct init_mm;										// 任务0的地址空间,文件系统信息和打开文件表.
+extern struct fs_struct init_fs;
+extern struct files_struct init_files;
 //extern struct task_struct *test_task;
 extern unsigned long volatile jiffies;									// 从开机开始算起的滴答数(10ms/滴答).
+extern int swap_out_task(struct task_struct * p);								// 换出任务p自己的一个页面(mm/swap.c).
+extern struct vm_area_struct * find_vma(struct task_struct * p, unsigned long addr);	// 取任务p中包含逻辑地址addr的映射区(mm/mmap.c).
+extern int copy_mmap(struct task_struct * p);									// 为fork()的子进程复制映射区链表(mm/mmap.c).
+extern void exit_mmap(struct task_struct * p);									// 解除任务p的所有映射(mm/mmap.c).
 extern unsigned long startup_time;										// 开机时间.从1970:0:0:0:0开始计时的秒数.
 extern int jiffies_offset;												// 用于累计需要调整的时间滴答数.
 
@@ -292,6 +437,19 @@ extern int jiffies_offset;												// 用于累计需要调整的时间滴答
 
 // 添加定时器函数（定时时间jiffies嘀嗒数，定时到时调用函数*fn()）。（kernel/sched.c）
 extern void add_timer(long jiffies, void (*fn)(void));
+// 把调用者提供的定时器设置为jiffies个嘀嗒后到期/取消定时器。（kernel/sched.c）
+extern void set_timer(struct timer_list * timer, long ticks);
+extern int del_timer(struct timer_list * timer);
+// 把高精度定时器设置为sec秒加usec微秒后到期/取消高精度定时器/取到期前剩余的时间。（kernel/sched.c）
+extern void set_hrtimer(struct hrtimer * timer, unsigned long sec, unsigned long usec);
+extern int del_hrtimer(struct hrtimer * timer);
+extern void hrtimer_left(struct hrtimer * timer, unsigned long * sec, unsigned long * usec);
+// 把任务置为就绪状态并放入就绪队列。（kernel/sched.c）
+extern void wake_up_process(struct task_struct * p);
+// 给任务发送信号之后调用，若任务在可中断睡眠中并且有未被阻塞的信号则唤醒它。（kernel/sched.c）
+extern void signal_wake_up(struct task_struct * p);
+// 就绪队列中的任务数（不含当前任务和任务0）。（kernel/sched.c）
+extern int nr_running;
 // 不可中断的等待睡眠。（kernel/sched.c）
 extern void sleep_on(struct task_struct ** p);
 // 可中断的等待睡眠。（kernel/sched.c）
@@ -300,6 +458,9 @@ extern void interruptible_sleep_on(struct task_struct ** p);
 extern void wake_up(struct task_struct ** p);
 // 检查当前进程是否在指定的用户组grp中。
 extern int in_group_p(gid_t grp);
+// 把任务加入/移出其执行文件和库文件i节点的任务链表,供share_page()查找共享页面。（mm/memory.c）
+extern void link_text_inodes(struct task_struct * p);
+extern void unlink_text_inodes(struct task_struct * p);
 
 /*
  * Entry into gdt where to find first TSS. 0-nul, 1-cs, 2-ds, 3-syscall
@@ -315,6 +476,10 @@ extern int in_group_p(gid_t grp);
 #define FIRST_TSS_ENTRY 4
 // 全局表中第1个局部描述符表(LDT)描述符的选择符索引号.
 #define FIRST_LDT_ENTRY (FIRST_TSS_ENTRY + 1)
+// 全局描述符表共有GDT_ENTRIES项(boot/head.s),除最后的SYSENTER段描述符外,必须能容纳所有任务的TSS和LDT描述符.
+#if (FIRST_TSS_ENTRY + 2 * NR_TASKS > GDT_SYSENTER)
+#error "Too many tasks for the GDT"
+#endif
 // 宏定义,计算在全局表中第n个任务的TSS段描述符的选择符值(偏移量).
 // 因每个描述符占8字节,因此FIRST_TSS_ENTRY<<3表示描述符在GDT表中的起始偏移位置.
 // 因为每个任务使用1个TSS和1个LDT描述符,共占用16字节,因此需要n<<4来表示对应TSS起始位置.该宏得到的值正好也是该TSS的选择符值.
@@ -94,6 +94,22 @@ extern int sys_symlink();       // 83 - 建立符号链接。          （fs/nam
 extern int sys_lstat();         // 84 - 取符号链接文件状态。     （fs/stat.c）
 extern int sys_readlink();      // 85 - 读取符号链接文件信息。    （fs/stat.c）
 extern int sys_uselib();        // 86 - 选择共享库。            （fs/exec.c）
+extern int sys_swapon();        // 87 - 启用交换区。            （mm/swap.c）
+extern int sys_swapoff();       // 88 - 停用交换区。            （mm/swap.c）
+extern int sys_vfork();         // 89 - 创建共享地址空间的子进程。（kernel/sys_call.s）
+extern int sys_mlock();         // 90 - 锁定内存页面。          （mm/mlock.c）
+extern int sys_munlock();       // 91 - 解除内存页面锁定。       （mm/mlock.c）
+extern int sys_mlockall();      // 92 - 锁定进程所有页面。       （mm/mlock.c）
+extern int sys_munlockall();    // 93 - 解除进程所有页面锁定。    （mm/mlock.c）
+extern int sys_mmap();          // 94 - 建立内存映射。            （mm/mmap.c）
+extern int sys_munmap();        // 95 - 解除内存映射。            （mm/mmap.c）
+extern int sys_msync();         // 96 - 把共享映射写回文件。      （mm/mmap.c）
+extern int sys_shmget();        // 97 - 取共享内存段标识符。      （mm/shm.c）
+extern int sys_shmat();         // 98 - 附加共享内存段。          （mm/shm.c）
+extern int sys_shmdt();         // 99 - 分离共享内存段。          （mm/shm.c）
+extern int sys_shmctl();        // 100 - 共享内存段控制操作。     （mm/shm.c）
+extern int sys_clone();         // 101 - 创建共享指定资源的子进程(线程)。（kernel/sys_call.s）
+extern int sys_nanosleep();     // 102 - 高精度睡眠。              （kernel/sched.c）
 
 // 系统调用函数指针表.用于系统调用中断处理程序(int 0x80),作为跳转表
 fn_ptr sys_call_table[] = { sys_setup, sys_exit, sys_fork, sys_read,
@@ -111,7 +127,10 @@ sys_getpgrp, sys_setsid, sys_sigaction, sys_sgetmask, sys_ssetmask,
 sys_setreuid,sys_setregid, sys_sigsuspend, sys_sigpending, sys_sethostname,
 sys_setrlimit, sys_getrlimit, sys_getrusage, sys_gettimeofday,
 sys_settimeofday, sys_getgroups, sys_setgroups, sys_select, sys_symlink,
-sys_lstat, sys_readlink, sys_uselib };
+sys_lstat, sys_readlink, sys_uselib, sys_swapon, sys_swapoff, sys_vfork,
+sys_mlock, sys_munlock, sys_mlockall, sys_munlockall, sys_mmap, sys_munmap,
+sys_msync, sys_shmget, sys_shmat, sys_shmdt, sys_shmctl, sys_clone,
+sys_nanosleep };
 
 /* So we don't have to do any more manual updating.... */
 /*　下面这样定义后,我们就无需手工更新系统调用数目了　*/
@@ -0,0 +1,31 @@
+#ifndef _SYS_IPC_H
+#define _SYS_IPC_H
+
+#include <sys/types.h>          // 类型头文件。定义了基本的系统数据类型。
+
+typedef long key_t;             // 进程间通信对象的键值。
+
+// 进程间通信对象的访问权限结构。
+struct ipc_perm {
+	key_t key;                  // 键值。
+	unsigned short uid;         // 属主的用户id。
+	unsigned short gid;         // 属主的组id。
+	unsigned short cuid;        // 创建者的用户id。
+	unsigned short cgid;        // 创建者的组id。
+	unsigned short mode;        // 访问权限(低9位,与文件权限相同)。
+	unsigned short seq;         // 表项的使用序号,用于生成标识符。
+};
+
+#define IPC_PRIVATE	((key_t) 0)     // 总是建立新的对象。
+
+// 以下符号常数用于...get()函数的flag参数(与低9位的访问权限一起使用)。
+#define IPC_CREAT	01000       // 对象不存在时建立它。
+#define IPC_EXCL	02000       // 与IPC_CREAT一起使用,对象已存在时出错。
+#define IPC_NOWAIT	04000       // 不等待。
+
+// 以下符号常数用于...ctl()函数的cmd参数。
+#define IPC_RMID	0           // 删除对象。
+#define IPC_SET		1           // 设置属主和访问权限。
+#define IPC_STAT	2           // 取对象状态。
+
+#endif
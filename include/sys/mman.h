@@ -0,0 +1,37 @@
+#ifndef _SYS_MMAN_H
+#define _SYS_MMAN_H
+
+#include <sys/types.h>          // 类型头文件。定义了基本的系统数据类型。
+
+// 以下符号常数用于mlockall()函数的flags参数。
+#define MCL_CURRENT	1       // 锁定进程当前已在内存中的所有页面。
+#define MCL_FUTURE	2       // 进程以后映射的页面也都不会被交换出去。
+
+// 以下符号常数用于mmap()函数的prot参数。
+#define PROT_NONE	0       // 页面不能被访问。
+#define PROT_READ	1       // 页面可读。
+#define PROT_WRITE	2       // 页面可写。
+#define PROT_EXEC	4       // 页面可执行。
+
+// 以下符号常数用于mmap()函数的flags参数。MAP_SHARED和MAP_PRIVATE必须且只能指定一个。
+#define MAP_SHARED		0x01    // 共享映射,修改会写回文件。
+#define MAP_PRIVATE		0x02    // 私有映射,写时复制。
+#define MAP_FIXED		0x10    // 必须映射在指定的地址处。
+#define MAP_ANONYMOUS	0x20    // 匿名映射,不对应文件(只能是私有的)。
+
+#define MAP_FAILED	((void *) -1)   // mmap()出错时的返回值。
+
+// 以下符号常数用于msync()函数的flags参数。
+#define MS_ASYNC		1       // 只写到高速缓冲中。
+#define MS_INVALIDATE	2       // 使其他映射无效(共享映射直接使用页面缓存,不需要)。
+#define MS_SYNC			4       // 写到设备上。
+
+extern void * mmap(void * addr, size_t len, int prot, int flags, int fd, off_t offset);
+extern int munmap(void * addr, size_t len);
+extern int msync(void * addr, size_t len, int flags);
+extern int mlock(const void * addr, size_t len);
+extern int munlock(const void * addr, size_t len);
+extern int mlockall(int flags);
+extern int munlockall(void);
+
+#endif
@@ -64,15 +64,15 @@ struct	rusage {
 #define RLIMIT_STACK	3		/* max stack size */            /* 最大栈长度 */
 #define RLIMIT_CORE	4		/* max core file size */        /* 最大core文件长度 */
 #define RLIMIT_RSS	5		/* max resident set size */     /* 最大驻留集大小 */
+#define RLIMIT_MEMLOCK	6		/* max locked-in-memory address space*/ /* 锁定区 */
 
 #ifdef notdef
-#define RLIMIT_MEMLOCK	6		/* max locked-in-memory address space*/ /* 锁定区 */
 #define RLIMIT_NPROC	7		/* max number of processes */           /* 最大子进程数 */
 #define RLIMIT_OFILE	8		/* max number of open files */          /* 最大打开文件数 */
 #endif
 
-// 这个符号常数定义了Linux中限制的资源种类。RLIM_NLIMITS=6，因此仅前面6项有效。
-#define RLIM_NLIMITS	6
+// 这个符号常数定义了Linux中限制的资源种类。RLIM_NLIMITS=7，因此仅前面7项有效。
+#define RLIM_NLIMITS	7
 
 // 表示资源无限，或不能修改。
 #define RLIM_INFINITY	0x7fffffff
@@ -0,0 +1,33 @@
+#ifndef _SYS_SHM_H
+#define _SYS_SHM_H
+
+#include <sys/types.h>          // 类型头文件。定义了基本的系统数据类型。
+#include <sys/ipc.h>            // 进程间通信头文件。
+
+// 共享内存段的状态结构,由shmctl(IPC_STAT)返回。
+struct shmid_ds {
+	struct ipc_perm shm_perm;   // 访问权限。
+	int shm_segsz;              // 段长度(字节)。
+	time_t shm_atime;           // 最近一次附加(shmat())的时间。
+	time_t shm_dtime;           // 最近一次分离(shmdt())的时间。
+	time_t shm_ctime;           // 最近一次修改(shmctl())的时间。
+	unsigned short shm_cpid;    // 创建者的进程号。
+	unsigned short shm_lpid;    // 最近一次附加或分离的进程号。
+	short shm_nattch;           // 当前附加的次数。
+};
+
+// 以下符号常数用于shmat()函数的shmflg参数。
+#define SHM_RDONLY	010000      // 只读附加。
+#define SHM_RND		020000      // 附加地址向下舍入到SHMLBA的倍数。
+
+#define SHMLBA		4096        // 附加地址的对齐单位(页面大小)。
+#define SHMMIN		1           // 段的最小长度。
+#define SHMMAX		0x400000    // 段的最大长度(4MB,页面地址表占1页)。
+#define SHMMNI		32          // 系统中最多的共享内存段数。
+
+extern int shmget(key_t key, int size, int shmflg);
+extern void * shmat(int shmid, const void * shmaddr, int shmflg);
+extern int shmdt(const void * shmaddr);
+extern int shmctl(int shmid, int cmd, struct shmid_ds * buf);
+
+#endif
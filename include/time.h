@@ -19,6 +19,12 @@ typedef unsigned int size_t;
 
 typedef long clock_t;			// 从进程开始执行计起的系统经过的时钟滴答数.
 
+// 高精度时间间隔,用于nanosleep().
+struct timespec {
+	time_t tv_sec;		// 秒数.
+	long tv_nsec;		// 纳秒数[0,999999999].
+};
+
 struct tm {
 	int tm_sec;		// 秒数[0,59]
 	int tm_min;		// 分钟数 [0,59]
@@ -58,5 +64,7 @@ size_t strftime(char * s, size_t smax, const char * fmt, const struct tm * tp);
 // 初始化时间转换信息,使用环境变量TZ,对zname变量进行初始化.
 // 在与时区相关的时间转换函数中将自动调用该函数.
 void tzset(void);
+// 睡眠rqtp指定的时间.被信号中断时返回-1,并在rmtp不为空时在其中返回剩余的时间.
+int nanosleep(const struct timespec * rqtp, struct timespec * rmtp);
 
 #endif
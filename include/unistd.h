@@ -40,6 +40,11 @@
 #define SEEK_CUR	1       // 将文件读写指针设置为当前值加上偏移值。
 #define SEEK_END	2       // 将文件读写指针设置为文件长度加上偏移值。
 
+/* swapon */ /* 启用交换区 */
+// 以下符号常数用于swapon()函数的swap_flags参数。
+#define SWAP_FLAG_PREFER	0x8000	// 使用swap_flags低15位指定的优先级。
+#define SWAP_FLAG_PRIO_MASK	0x7fff	// 优先级屏蔽码。
+
 /* _SC stands for System Configuration. We don't use them much */
 /* _SC表示系统配置。我们很少使用 */
 // 下面的符号常数用于sysconf()函数。
@@ -161,6 +166,53 @@
 #define __NR_lstat		84
 #define __NR_readlink	85
 #define __NR_uselib		86
+#define __NR_swapon		87
+#define __NR_swapoff	88
+#define __NR_vfork		89
+#define __NR_mlock		90
+#define __NR_munlock	91
+#define __NR_mlockall	92
+#define __NR_munlockall	93
+#define __NR_mmap		94
+#define __NR_munmap		95
+#define __NR_msync		96
+#define __NR_shmget		97
+#define __NR_shmat		98
+#define __NR_shmdt		99
+#define __NR_shmctl		100
+#define __NR_clone		101
+#define __NR_nanosleep	102
+
+/*
+ * If the CPU has sysenter (checked once by __sysenter_check() in lib/),
+ * the calls below use it instead of int $0x80. sysenter saves nothing,
+ * so the stub pushes %ebp and the return address and passes %esp in
+ * %ebp; the kernel takes both back off the user stack. sysexit comes
+ * back at 1: with flat segments, so we far-jump to our own code segment
+ * and reload %ss before the stack is touched again (%ecx and %edx are
+ * used up by sysexit). A call that is restarted after a signal goes back
+ * two bytes, i.e. to the int $0x80 in front of 1:.
+ */
+// 快速系统调用.若CPU支持sysenter指令(由lib/sysenter.c中的__sysenter_check()检测一次),下面的系统调用宏用它代替int $0x80.
+// sysenter不保存返回信息,因此先把%ebp和返回地址压入用户栈,并通过%ebp传递%esp,内核从用户栈中取回它们.sysexit返回到标号1处时使用的是
+// 平坦段,所以要长跳转回本任务的代码段,并在使用堆栈之前重新装入%ss(%ecx和%edx已被sysexit用掉).被信号中断后重新启动的系统调用的返回
+// 地址会回退2字节,即改为执行标号1前面的int $0x80.
+#define __sysenter \
+	"pushl %%ebp\n\t" \
+	"pushl $1f\n\t" \
+	"movl %%esp, %%ebp\n\t" \
+	"sysenter\n\t" \
+	"int $0x80\n" \
+	"1:\tljmp $0x0f, $2f\n" \
+	"2:\tmovl $0x17, %%ecx\n\t" \
+	"movw %%cx, %%ss"
+
+extern int __sysenter_ok;
+extern int __sysenter_check(void);
+
+#define __syscall_check() \
+if (__sysenter_ok < 0) \
+	__sysenter_check()
 
 // 以下定义系统调用嵌入式汇编宏函数.
 // 不带参数的系统调用宏函数,type_name(void).
@@ -172,7 +224,13 @@
 #define _syscall0(type, name) \
 type name(void) \
 { \
-long __res; \
+long __res, __c, __d; \
+__syscall_check(); \
+if (__sysenter_ok) \
+	__asm__ volatile (__sysenter \
+		: "=a" (__res), "=c" (__c), "=d" (__d) \
+		: "0" (__NR_##name)); \
+else \
 __asm__ volatile ("int $0x80"  												/* 调用系统中断0x80 */\
 	: "=a" (__res)  														/* 返回值->eax(__res) */\
 	: "0" (__NR_##name));  													/* 输入为系统中断调用号__NR_name */\
@@ -187,7 +245,13 @@ return -1; \
 #define _syscall1(type, name, atype, a) \
 type name(atype a) \
 { \
-long __res; \
+long __res, __c, __d; \
+__syscall_check(); \
+if (__sysenter_ok) \
+	__asm__ volatile (__sysenter \
+		: "=a" (__res), "=c" (__c), "=d" (__d) \
+		: "0" (__NR_##name), "b" ((long)(a))); \
+else \
 __asm__ volatile ("int $0x80" 												/* 调用系统中断0x80 */\
 	: "=a" (__res) 															/* 返回值->eax(__res) */\
 	: "0" (__NR_##name), "b" ((long)(a))); 									/* 输入为系统中断调用号__NR_name,a表示存放在ebx中的参数 */\
@@ -202,7 +266,13 @@ return -1; \
 #define _syscall2(type, name, atype, a, btype, b) \
 type name(atype a, btype b) \
 { \
-long __res; \
+long __res, __c, __d; \
+__syscall_check(); \
+if (__sysenter_ok) \
+	__asm__ volatile (__sysenter \
+		: "=a" (__res), "=c" (__c), "=d" (__d) \
+		: "0" (__NR_##name), "b" ((long)(a)), "1" ((long)(b))); \
+else \
 __asm__ volatile ("int $0x80" 												/* 调用系统中断0x80 */\
 	: "=a" (__res) 															/* 返回值->eax(__res) */\
 	: "0" (__NR_##name), "b" ((long)(a)), "c" ((long)(b))); 				/* 输入为系统中断调用号__NR_name,a表示存放在ebx中的参数,b表示存放在ecx中的参数 */\
@@ -217,7 +287,13 @@ return -1; \
 #define _syscall3(type, name, atype, a, btype, b, ctype, c) \
 type name(atype a, btype b, ctype c) \
 { \
-long __res; \
+long __res, __c, __d; \
+__syscall_check(); \
+if (__sysenter_ok) \
+	__asm__ volatile (__sysenter \
+		: "=a" (__res), "=c" (__c), "=d" (__d) \
+		: "0" (__NR_##name), "b" ((long)(a)), "1" ((long)(b)), "2" ((long)(c))); \
+else \
 __asm__ volatile ("int $0x80" 												/* 调用系统中断0x80 */\
 	: "=a" (__res) 															/* 返回值->eax(__res) */\
 	: "0" (__NR_##name), "b" ((long)(a)), "c" ((long)(b)), "d" ((long)(c)));/* 输入为系统中断调用号__NR_name,a表示存放在ebx中的参数,b表示存放在ecx中的参数,c表示存放在edx中的参数 */\
@@ -253,6 +329,8 @@ void exit(int status);
 void _exit(int status);
 int fcntl(int fildes, int cmd, ...);
 int fork(void);
+pid_t vfork(void);
+int clone(unsigned long flags, void * stack);
 int getpid(void);
 int getuid(void);
 int geteuid(void);
@@ -304,5 +382,7 @@ int getgroups(int gidsetlen, gid_t *gidset);
 int setgroups(int gidsetlen, gid_t *gidset);
 int select(int width, fd_set * readfds, fd_set * writefds,
 	fd_set * exceptfds, struct timeval * timeout);
+int swapon(const char * specialfile, int swap_flags);
+int swapoff(const char * specialfile);
 
 #endif
@@ -66,7 +66,10 @@ extern void blk_dev_init(void);						/* 块设备初始化子程序(blk_drv/ll_r
 extern void chr_dev_init(void);						/* 字符设备初始化(chr_drv/tty_io.c) */
 extern void hd_init(void);							/* 硬盘初始化程序(blk_drv/hd.c) */
 extern void floppy_init(void);						/* 软驱初始化程序(blk_drv/floppy.c) */
-extern void mem_init(long start, long end);			/* 内存管理初始化(mm/memory.c) */
+extern void inode_init(void);						/* i节点对象缓存初始化(fs/inode.c) */
+extern void file_table_init(void);					/* 文件结构对象缓存初始化(fs/file_table.c) */
+extern void mmap_init(void);						/* 映射区结构对象缓存初始化(mm/mmap.c) */
+extern void fork_init(void);						/* 任务共享资源结构对象缓存初始化(kernel/fork.c) */
 extern long rd_init(long mem_start, int length);	/* 虚拟盘初始化(blk_drv/ramdisk.c) */
 extern long kernel_mktime(struct tm * tm);			/* 计算系统开机启动时间(秒) */
 
@@ -113,6 +116,10 @@ static int sprintf(char * str, const char *fmt, ...)
 #define DRIVE_INFO (*((struct drive_info *)0x90080))	/* 硬盘参数表32字节内容 */
 #define ORIG_ROOT_DEV (*(unsigned short *)0x901FC)		/* 根文件系统所在设备号 */
 #define ORIG_SWAP_DEV (*(unsigned short *)0x901FA)		/* 交换文件所在设备号 */
+#define E820_NR (*(unsigned short *)0x90010)			/* BIOS内存分布图项数(为0表示BIOS不支持) */
+#define E820_MAP ((struct e820entry *)0x900A0)			/* BIOS内存分布图,最多E820_MAX项 */
+#define E820_MAX 16
+#define E820_RAM 1										/* 可用内存区域类型 */
 
 /*
  * Yeah, yeah, it's ugly, but I cannot find how to do this correctly and this seems to work. I anybody has 
@@ -170,9 +177,57 @@ static char * envp[] = { "HOME=/usr/root", NULL, NULL };
 
 struct drive_info { char dummy[32]; } drive_info;	/* 用于存放硬盘参数表信息 */
 
+/* BIOS内存分布图(int 0x15,eax = 0xe820)的一项.地址和长度都是64位的 */
+struct e820entry {
+	unsigned long addr, addr_high;	/* 区域起始地址 */
+	unsigned long size, size_high;	/* 区域长度 */
+	unsigned long type;				/* 区域类型,1为可用内存 */
+};
+static struct e820entry e820_map[E820_MAX];
+static int e820_nr = 0;
+
+/* 取可用内存区域entry在4GB以下部分的末端地址.不可用区域返回0 */
+static unsigned long e820_end(struct e820entry * entry)
+{
+	if (entry->type != E820_RAM || entry->addr_high)
+		return 0;
+	if (entry->size_high || entry->addr + entry->size < entry->addr)
+		return 0xfffff000;
+	return entry->addr + entry->size;
+}
+
+/* 判断物理地址addr开始的一页是否完全处于某个可用内存区域中 */
+static int e820_page_ram(unsigned long addr)
+{
+	int i;
+
+	for (i = 0; i < e820_nr; i++)
+		if (e820_map[i].type == E820_RAM && !e820_map[i].addr_high &&
+		    addr >= e820_map[i].addr && addr + 4096 <= e820_end(e820_map + i))
+			return 1;
+	return 0;
+}
+
+/* 根据BIOS内存分布图确定物理内存容量,即最高的可用内存区域末端.若BIOS不支持内存分布图,则使用扩展内存大小 */
+static long memory_size(void)
+{
+	unsigned long end, mem = 0;
+	int i;
+
+	if (!e820_nr)
+		return (1 << 20) + (EXT_MEM_K << 10);						// 内存大小=1MB + 扩展内存(k)*1024字节.
+	for (i = 0; i < e820_nr; i++)
+		if ((end = e820_end(e820_map + i)) > mem)
+			mem = end;
+	return mem;
+}
+
 /* 内核初始化主程序.初始化结束后将以任务0(idle任务即空闲任务)的身份运行 */
 int main(void)		/* This really IS void, no error here. */
 {					/* The startup routine assumes (well, ...) this */
+	unsigned long addr;
+	int i;
+
 #ifdef EM
 	// 开启仿真协处理器
 	__asm__("movl %cr0,%eax \n\t" \
@@ -197,16 +252,23 @@ int main(void)		/* This really IS void, no error here. */
 	envp[1] = term;
 	envp_rc[1] = term;
     drive_info = DRIVE_INFO;										// 复制内存0x90080处的硬盘参数表.
+	// 复制BIOS内存分布图.0x90000开始处的内容随后会被高速缓冲区覆盖.
+	if ((e820_nr = E820_NR) > E820_MAX)
+		e820_nr = E820_MAX;
+	for (i = 0; i < e820_nr; i++)
+		e820_map[i] = E820_MAP[i];
 
 	// 接着根据机器物理内存容量设置高速缓冲区和主内存的位置和范围.
 	// 高速缓存末端地址->buffer_memory_end;机器内存容量->memory_end;主内存开始地址->main_memory_start.
 	// 设置物理内存大小
-	memory_end = (1 << 20) + (EXT_MEM_K << 10);						// 内存大小=1MB + 扩展内存(k)*1024字节.
+	memory_end = memory_size();										// 内存大小,取自BIOS内存分布图.
 	memory_end &= 0xfffff000;										// 忽略不到4KB(1页)的内存数.
-	if (memory_end > 16 * 1024 * 1024)								// 如果内存量超过16MB,则按16MB计.
-		memory_end = 16 * 1024 * 1024;
+	if (memory_end > MAX_MEMORY)									// 如果内存量超过1GB,则按1GB计.
+		memory_end = MAX_MEMORY;
 	// 根据物理内存的大小设置高速缓冲去的末端大小
-	if (memory_end > 12 * 1024 * 1024) 								// 如果内存>12MB,则设置缓冲区末端=4MB
+	if (memory_end > 32 * 1024 * 1024) 								// 如果内存>32MB,则设置缓冲区末端=8MB
+		buffer_memory_end = 8 * 1024 * 1024;
+	else if (memory_end > 12 * 1024 * 1024) 						// 如果内存>12MB,则设置缓冲区末端=4MB
 		buffer_memory_end = 4 * 1024 * 1024;
 	else if (memory_end > 6 * 1024 * 1024)							// 否则若内存>6MB,则设置缓冲区末端=2MB
 		buffer_memory_end = 2 * 1024 * 1024;
@@ -220,7 +282,12 @@ int main(void)		/* This really IS void, no error here. */
 	main_memory_start += rd_init(main_memory_start, RAMDISK * 1024);
 #endif
 	// 以下是内核进行所有方面的初始化工作.
-	mem_init(main_memory_start, memory_end);	// 主内存区初始化.(mm/memory.c)
+	main_memory_start = mem_init(main_memory_start, memory_end);	// 主内存区初始化.(mm/memory.c)
+	// 把主内存区中BIOS内存分布图没有列为可用内存的页面(内存空洞,ACPI表等)标记为已占用.
+	if (e820_nr)
+		for (addr = main_memory_start; addr < memory_end; addr += 4096)
+			if (!e820_page_ram(addr))
+				reserve_page(addr);
 	trap_init();								// 陷阱门(硬件中断向量)初始化.(kernel/traps.c)
 	blk_dev_init();								// 块设备初始化.(blk_drv/ll_rw_blk.c)
 	chr_dev_init();								// 字符设备初始化.(chr_drv/tty_io.c)
@@ -228,6 +295,10 @@ int main(void)		/* This really IS void, no error here. */
 	time_init();								// 设置开机启动时间.
  	sched_init();								// 调度程序初始化(加载任务0的tr,ldtr)(kernel/sched.c)
 	buffer_init(buffer_memory_end);				// 缓冲管理初始化,建内存链表等.(fs/buffer.c)
+	inode_init();								// 建立i节点对象缓存.(fs/inode.c)
+	file_table_init();							// 建立文件结构对象缓存.(fs/file_table.c)
+	mmap_init();								// 建立映射区结构对象缓存.(mm/mmap.c)
+	fork_init();								// 建立任务共享资源结构对象缓存.(kernel/fork.c)
 	hd_init();									// 硬盘初始化.	(blk_drv/hd.c)
 	floppy_init();								// 软驱初始化.	(blk_drv/floppy.c)
 	sti();										// 所有初始化工作都完了,于是开启中断.
@@ -69,7 +69,7 @@ struct blk_dev_struct {
 };
 
 extern struct blk_dev_struct blk_dev[NR_BLK_DEV];       // 块设备表(数组).每种块设备占用一项,共7项.
-extern struct request request[NR_REQUEST];              // 请求队列数组,共32项.
+extern void free_request(struct request * req);         // 释放请求项(ll_rw_blk.c).
 extern struct task_struct * wait_for_request;           // 等待空闲请求项的进程队列头指针.
 
 // 设备数据块总数指针数组.每个指针项指向指定主设备号的总块数组hd_sizes[].该总块数数组每一项对应子设备号确定的一个子设备上所拥有的
@@ -159,6 +159,8 @@ static inline void unlock_buffer(struct buffer_head * bh)
 // 中删除本请求项,并把当前请求项指针指向下一请求项.
 static inline void end_request(int uptodate)
 {
+	struct request * req;
+
 	DEVICE_OFF(CURRENT->dev);							// 关闭设备
 	if (CURRENT->bh) {									// CURRENT为当前请求结构项指针
 		CURRENT->bh->b_uptodate = uptodate;				// 置更新标志.
@@ -171,8 +173,9 @@ static inline void end_request(int uptodate)
 	}
 	wake_up(&CURRENT->waiting);							// 唤醒等待该请求项的进程.
 	wake_up(&wait_for_request);							// 唤醒等待空闲请求项的进程.
-	CURRENT->dev = -1;									// 释放该请求项.
-	CURRENT = CURRENT->next;							// 指向下一请求项.
+	req = CURRENT;
+	CURRENT = req->next;								// 指向下一请求项.
+	free_request(req);									// 释放该请求项.
 }
 
 // 如果定义了设备超时符号常量DEVICE_TIMEOUT,则定义CLEAR_DEVICE_TIMEOUT符号常量为"DEVICE_TIMEOUT =0".否则定义CLEAR_DEVICE_TIMEOUT为空.
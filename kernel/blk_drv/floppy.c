@@ -184,6 +184,7 @@ static unsigned char current_track = 255;					// 当前磁头所在磁道号.
 static unsigned char command = 0;							// 读/写命令.
 unsigned char selected = 0;									// 软驱已选定标志.在处理请求项之前要首先选定软驱.
 struct task_struct * wait_on_floppy_select = NULL;			// 等待选定软驱的任务队列.
+static struct timer_list fd_timer = {NULL, NULL, 0, NULL, 0};	// 启动马达和选择驱动器的延时定时器.
 
 // 取消选定软驱.
 // 如果函数参数指定的软驱nr当前并没有被选定,则显示警告信息.然后复位软驱已选定标志selected,并唤醒等待选择该软驱的任务.数字输出
@@ -596,7 +597,8 @@ static void floppy_on_interrupt(void)
 		current_DOR &= 0xFC;
 		current_DOR |= current_drive;
 		outb(current_DOR,FD_DOR);					// 向数字输出寄存器输出当前DOR.
-		add_timer(2,&transfer);						// 添加定时器并执行传输函数.
+		fd_timer.fn = transfer;						// 设置定时器2个滴答后执行传输函数.
+		set_timer(&fd_timer, 2);
 	} else
 		transfer();									// 执行软盘读写传输函数.
 }
@@ -656,7 +658,8 @@ void do_fd_request(void)
 	// 在上面设置好所有全局变量值之后,我们可以开始执行请求项操作了.该操作利用定时器来启动.因为为了能对软驱进行读写操作,需要首先启动驱动器马达
 	// 并达到正常运转速度.而这需要一定的时间.因此这里利用ticks_to_floppy_on()来计算启动延时时间,然后使用该延时设定一个定时器.当时间到时就调用
 	// 函数floppy_on_interrupt().
-	add_timer(ticks_to_floppy_on(current_drive), &floppy_on_interrupt);
+	fd_timer.fn = floppy_on_interrupt;
+	set_timer(&fd_timer, ticks_to_floppy_on(current_drive));
 }
 
 // 各种类型软驱磁盘有的数据块总数.
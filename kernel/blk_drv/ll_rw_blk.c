@@ -10,6 +10,7 @@
 #include <errno.h>
 #include <linux/sched.h>					// 调试程序头文件,定义了任务结构task_struct,任务0数据等.
 #include <linux/kernel.h>
+#include <linux/mm.h>
 #include <asm/system.h>						// 系统头文件.定义了设置或修改描述符/中断门等的嵌入式汇编宏.
 
 #include "blk.h"							// 块设备头文件.定义请求数据结构,块设备数据结构和宏等信息.
@@ -21,8 +22,10 @@
 /*
  * 请求结构中含有加载nr个扇区数据到内存中去的所有必须的信息.
  */
-// 请求项数组队列.共有NR_REQUEST = 32个请求项.
-struct request request[NR_REQUEST];
+// 请求项从对象缓存中分配,请求完成时在end_request()中释放.nr_requests是正在使用的请求项数,它不能超过NR_REQUEST,写请求则不能超过
+// 其2/3.缓存预留了NR_REQUEST个对象,因此在这个限度内分配请求项不需要申请页面,也就不会在换出页面时因申请内存而递归.
+static struct kmem_cache * request_cachep;
+static int nr_requests = 0;
 
 /*
  * used to wait on when there are no free requests
@@ -147,6 +150,29 @@ static void add_request(struct blk_dev_struct * dev, struct request * req)
 
 // 创建请求项并插入请求队列中.
 // 参数major是主设备号;rw是指定命令;bh是存放数据的缓冲区头指针.
+// 分配一个请求项.
+// 参数max是允许使用的请求项数上限.若已达到上限或没有内存则返回NULL.请求项只在进程上下文中分配,而在中断中释放,因此修改计数时要关中断.
+static struct request * get_request(int max)
+{
+	struct request * req;
+
+	cli();
+	if (nr_requests >= max || !(req = (struct request *) kmem_cache_alloc(request_cachep, GFP_ATOMIC))) {
+		sti();
+		return NULL;
+	}
+	nr_requests++;
+	sti();
+	return req;
+}
+
+// 释放请求项.在end_request()中被调用,此时处于中断处理过程中.
+void free_request(struct request * req)
+{
+	nr_requests--;
+	kmem_cache_free(request_cachep, req);
+}
+
 static void make_request(int major, int rw, struct buffer_head * bh)
 {
 	struct request * req;
@@ -183,23 +209,12 @@ repeat:
 	/*
 	 * 我们不能让队列中全都是写请求项:我们需要为读请求保留一些空间:读操作是优先的.请求队列的后三分之一空间仅用于读请求项.
 	 */
-	// 好,现在我们必须为本函数生成并添加读/写请求项了.首先我们需要在请求数组中寻找到一个空闲项(糟)来存放新请求项.搜索过程从请求数组末端开始.
-	// 根据上述要求,对于读命令请求,我们直接从队列末尾开始搜索,而对于写请求就只能从队列2/3处向队列头处搜索空项填入.于是我们开始从后向前搜索,
-	// 当请求结构request的设备字段dev值=-1时,表示该项未被占用(空闲).如果没有一项是空闲的(此时请求项数组指针已经搜索越过头部),则查看此次请求
-	// 是否是提前读/写(READA或WRITEA),如果是则放弃此次请求操作.否则让本次请求操作先睡眠(以等待请求队列腾出空项),过一会儿再来搜索请求队列.
-	if (rw == READ)
-		req = request + NR_REQUEST;						// 对于读请求,将指针指向队列尾部.
-	else
-		req = request + ((NR_REQUEST * 2) / 3);			// 对于写请求,指针指向队列2/3处.
-	/* find an empty request */
-	/* 搜索一个空请求项 */
-	while (--req >= request)
-		if (req->dev < 0)
-			break;
-	/* if none found, sleep on new requests: check for rw_ahead */
-	/* 如果没有找到空闲项,则让该次请求操作睡眠:需检查是否提前读/写 */
-	if (req < request) {								// 如果已搜索到头(队列无空项)
-		if (rw_ahead) {									// 则若是提前读/写请求,则退出.
+	// 好,现在我们必须为本函数生成并添加读/写请求项了.根据上述要求,读请求最多可以使用NR_REQUEST个请求项,而写请求只能使用其中的2/3.
+	// 如果已经达到上限,则查看此次请求是否是提前读/写(READA或WRITEA),如果是则放弃此次请求操作.否则让本次请求操作先睡眠(以等待有请求项
+	// 被释放),过一会儿再来申请.
+	if (!(req = get_request(rw == READ ? NR_REQUEST : (NR_REQUEST * 2) / 3))) {
+		// 如果没有空闲请求项,则让该次请求操作睡眠:需检查是否提前读/写.若是提前读/写请求,则退出.
+		if (rw_ahead) {
 			unlock_buffer(bh);
 			return;
 		}
@@ -241,11 +256,7 @@ void ll_rw_page(int rw, int dev, int page, char * buffer)
 	// 开始.于是我们开始从后向前搜索,当请求结构request的设备字段值<0时,表示该项未被占用(空闲).如果没有一项是空闲的(此时请求项数组指针已经搜索越过
 	// 头部),则让本次请求操作先睡眠(以等待请求队列腾出空项),过一会再来搜索请求队列.
 repeat:
-	req = request + NR_REQUEST;							// 将指针指向队列尾部.
-	while (--req >= request)
-		if (req->dev < 0)
-			break;
-	if (req < request) {
+	if (!(req = get_request(NR_REQUEST))) {
 		sleep_on(&wait_for_request);					// 睡眠,过会再查看请求队列.
 		goto repeat;
 	}
@@ -289,13 +300,8 @@ void ll_rw_block(int rw, struct buffer_head * bh)
 }
 
 // 块设备初始化函数,由初始化程序main.c调用.
-// 初始化请求数组,将所有请求项置为空闲项(dev = -1).有32项(NR_REQUEST = 32).
+// 建立请求项对象缓存,并预留NR_REQUEST个请求项.
 void blk_dev_init(void)
 {
-	int i;
-
-	for (i = 0; i < NR_REQUEST; i++) {
-		request[i].dev = -1;
-		request[i].next = NULL;
-	}
+	request_cachep = kmem_cache_create("request", sizeof(struct request), NR_REQUEST);
 }
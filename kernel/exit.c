@@ -54,7 +54,8 @@ void release(struct task_struct * p)
 				p->p_ysptr->p_osptr = p->p_osptr;
 			else
 				p->p_pptr->p_cptr = p->p_osptr;
-			// 释放要释放的进程数据结构占用的那页内存
+			// 释放要释放的进程的页目录(其用户空间页表已在do_exit()中释放)和进程数据结构占用的那页内存
+			free_page(p->tss.cr3);
 			free_page((long)p);
 			// 重新调度进程
 			schedule();
@@ -191,7 +192,7 @@ static inline int send_sig(long sig, struct task_struct * p, int priv)
 	// 修改进程p的信号位图signal，去掉（复位）会导致进程停止的信号SIGSTOP、SIGTSTP、SIGTTIN和SIGTTOU。
 	if ((sig == SIGKILL) || (sig == SIGCONT)) {
 		if (p->state == TASK_STOPPED)
-			p->state = TASK_RUNNING;
+			wake_up_process(p);
 		p->exit_code = 0;
 		p->signal &= ~( (1 << (SIGSTOP - 1)) | (1 << (SIGTSTP - 1)) |
 				(1 << (SIGTTIN - 1)) | (1 << (SIGTTOU - 1)) );
@@ -209,6 +210,7 @@ static inline int send_sig(long sig, struct task_struct * p, int priv)
 	/* Actually deliver the signal */
     /* 最后，我们向进程p发送信号p */
 	p->signal |= (1 << (sig - 1));
+	signal_wake_up(p);
 	return 0;
 }
 
@@ -367,29 +369,32 @@ static int has_stopped_jobs(int pgrp)
 void do_exit(long code)
 {
 	struct task_struct *p;
-	int i;
 
-	// 首先释放当前进程代码段和数据段所占的内存页。函数free_page_tables()的第1个参数（get_base()返回值）指明在CPU线性
-	// 地址空间中起始其地址，第2个（get_limit()返回值）说明欲释放的字节长度值。get_base()宏中的current->ldt[1]给出进程
+	// 首先释放当前进程代码段和数据段所占的内存页。函数free_page_tables()的第1个参数是进程的页目录，第2个参数（get_base()返回值）
+	// 指明在CPU线性地址空间中起始其地址，第3个（get_limit()返回值）说明欲释放的字节长度值。get_base()宏中的current->ldt[1]给出进程
 	// 代码段描述符的位置（current->ldt[2]给出进程数据段描述符的位置）；get_limit()中的0x0f是进程代码段的选择符（0x17是
 	// 进程数据段的选择符）。即在取段其地址时使用该段的描述符所处地址作为参数，取段长度时使用该段的选择符作为参数。
 	// free_page_tables()函数位于mm/memory.c文件；get_base()和get_limit()宏位于include/linux/sched.h头文件。
-	free_page_tables(get_base(current->ldt[1]), get_limit(0x0f));
-	free_page_tables(get_base(current->ldt[2]), get_limit(0x17));
-	// 然后关闭当前进程打开着的所有文件。再对当前进程的工作目录pwd、根目录root、执行程序文件的i节点以及库文件进行同步操作，
-	// 放回各个i节点并分别置空（释放）。接着把当前进程的状态设置为僵死状态（TASK_ZOMBIE），并设置进程退出码。
-	for (i = 0 ; i < NR_OPEN ; i++)
-		if (current->filp[i])
-			sys_close(i);
+	// 地址空间还被其他线程(clone(CLONE_VM))或vfork()的父进程使用时不能释放,只放弃对它的引用(exit_mm()在kernel/fork.c中).
+	// vfork()产生的子进程还要把地址空间归还给父进程.
+	exit_mm();
+	if (current->flags & PF_VFORK)
+		vfork_release();
+	// 然后放弃打开文件表和文件系统信息(最后一个使用者关闭所有打开着的文件,放回工作目录pwd和根目录root的i节点),退出信号处理句柄
+	// 共享环.再对当前进程执行程序文件的i节点以及库文件进行同步操作，放回各个i节点并分别置空（释放）。接着把当前进程的状态设置为
+	// 僵死状态（TASK_ZOMBIE），并设置进程退出码。
+	exit_files();
 	Log(LOG_INFO_TYPE, "<<<<< sys_exit process pid = %d, exit_code = %d >>>>>\n", current->pid, code);
-	iput(current->pwd);
-	current->pwd = NULL;
-	iput(current->root);
-	current->root = NULL;
+	exit_fs();
+	exit_sighand();
+	unlink_text_inodes(current);
 	iput(current->executable);
 	current->executable = NULL;
 	iput(current->library);
 	current->library = NULL;
+	// 取消报警和超时定时器,任务结构在父进程取得退出码后就会被释放.
+	del_timer(&current->alarm_timer);
+	del_timer(&current->timeout_timer);
 	current->state = TASK_ZOMBIE;
 	current->exit_code = code;
 	/*
@@ -420,6 +425,7 @@ void do_exit(long code)
 	}
 	/* Let father know we died */           /* 通知父进程当前进程将终止 */
 	current->p_pptr->signal |= (1 << (SIGCHLD - 1));
+	signal_wake_up(current->p_pptr);
 
 	/*
 	 * This loop does two things:
@@ -441,8 +447,10 @@ void do_exit(long code)
 	if (p = current->p_cptr) {
 		while (1) {
 			p->p_pptr = task[1];
-			if (p->state == TASK_ZOMBIE)
+			if (p->state == TASK_ZOMBIE) {
 				task[1]->signal |= (1 << (SIGCHLD - 1));
+				signal_wake_up(task[1]);
+			}
 			/*
 			 * process group orphan check
 			 * Case ii: Our child is in a different pgrp
@@ -15,6 +15,8 @@
  * 内存管理却有些难度.参见'mm/memory.c'中的'copy_page_tables()'函数.
  */
 #include <errno.h>
+#define __LIBRARY__
+#include <unistd.h>
 
 #include <linux/sched.h>
 #include <linux/kernel.h>
@@ -23,6 +25,15 @@
 
 // 写页面验证.若页面不可写,则复制页面.定义在mm/memory.c.
 extern void write_verify(unsigned long address);
+extern int sys_close(int fd);
+
+// 等待vfork()子进程归还地址空间的父进程队列.
+static struct task_struct * vfork_wait = NULL;
+
+// 地址空间,文件系统信息和打开文件表结构的对象缓存.
+static struct kmem_cache * mm_cachep;
+static struct kmem_cache * fs_cachep;
+static struct kmem_cache * files_cachep;
 
 long last_pid = 0;							// 最新进程号,其值会由get_empty_process()生成.
 
@@ -34,10 +45,13 @@ long last_pid = 0;							// 最新进程号,其值会由get_empty_process()生
 // 的检测操作.由于检测判断是以页面为单位进行操作,因此程序首先需要找出addr所在页面开始地址start,然后start加上进程数据段基址,
 // 使这个start变换成CPU 4GB线性空间中的地址.最后循环调用write_verify()对指定大小的内存空间进行写前验证.若页面是只读的,
 // 则执行共享检验和复制页面操作(写时复制).
+// 486以上CPU在mem_init()中已置位WP,内核写用户页面时由写保护异常和缺页异常处理,这里直接返回.
 void verify_area(void * addr, int size)
 {
 	unsigned long start;
 
+	if (wp_works_ok)
+		return;
 	// 首先将起始地址start调整为其所在页的左边界开始位置,同时相应地调整验证区域大小.下句中的start & 0xfff用来获得指定起始位置addr
 	// (也即start)在所在页面中的偏移值,原验证范围size加上这个偏移值即扩展成以addr所在页面起始位置开始的范围值.因此在30行上也需要
 	// 把验证开始位置start调整成页面边界值.
@@ -75,18 +89,195 @@ int copy_mem(int nr, struct task_struct * p)
 		panic("We don't support separate I&D");
 	if (data_limit < code_limit)
 		panic("Bad data_limit");
-	// 然后设置创建中的新进程在线性地址空间中的基地址等于(64MB*其任务号),并用该值设置新进程局部描述符表中段描述符中的基地址.接着设置新进程的页目录
-	// 表项和页表项,即复制当前进程(父进程)的页目录表项和页表项.此时子进程共享父进程的内存页面.
-	// 正常情况下copy_page_tables()返回0,否则表示出错,则释放刚申请的页表项.
-	new_data_base = new_code_base = nr * TASK_SIZE;
+	// 然后为新进程申请自己的页目录,并设置其在线性地址空间中的基地址等于TASK_BASE(每个进程有自己的页目录,因此所有进程的基地址都相同),用该值
+	// 设置新进程局部描述符表中段描述符中的基地址.接着设置新进程的页目录表项和页表项,即复制当前进程(父进程)的页目录表项和页表项.此时子进程
+	// 共享父进程的内存页面.任务切换时CPU会从TSS中加载cr3,从而切换到新进程的页目录.
+	// 正常情况下copy_page_tables()返回0,否则表示出错,则释放刚申请的页表项和页目录.
+	if (!(p->tss.cr3 = new_page_dir()))
+		return -ENOMEM;
+	new_data_base = new_code_base = TASK_BASE;
 	p->start_code = new_code_base;
 	set_base(p->ldt[1], new_code_base);
 	set_base(p->ldt[2], new_data_base);
-	if (copy_page_tables(old_data_base, new_data_base, data_limit)) {
-		free_page_tables(new_data_base, data_limit);
+	if (copy_page_tables(current->tss.cr3, old_data_base, p->tss.cr3, new_data_base, data_limit)) {
+		free_page_tables(p->tss.cr3, new_data_base, data_limit);
+		free_page(p->tss.cr3);
+		return -ENOMEM;
+	}
+	return 0;
+}
+
+// 初始化任务共享资源结构的对象缓存.在init/main.c中被调用.
+void fork_init(void)
+{
+	mm_cachep = kmem_cache_create("mm", sizeof(struct mm_struct), 0);
+	fs_cachep = kmem_cache_create("fs", sizeof(struct fs_struct), 0);
+	files_cachep = kmem_cache_create("files", sizeof(struct files_struct), 0);
+}
+
+// 新建只有当前任务使用的空地址空间结构.内存不够时返回NULL.
+struct mm_struct * new_mm(void)
+{
+	struct mm_struct * mm;
+
+	if (!(mm = kmem_cache_alloc(mm_cachep, GFP_KERNEL)))
+		return NULL;
+	mm->count = 1;
+	mm->owner = current;
+	mm->brk = 0;
+	mm->rss = mm->max_rss = 0;
+	mm->mmap = NULL;
+	mm->mmap_lock = 0;
+	mm->mmap_wait = NULL;
+	return mm;
+}
+
+// 为新任务p设置地址空间.
+// 对于CLONE_VM(包括vfork()),子进程不复制页表,而是继续使用从父进程复制来的局部描述符表和页目录,即与父进程使用同一段线性地址空间.
+// 因此递增页目录页面和mm结构的引用计数,页目录在最后一个使用者被释放时才释放.否则复制mmap()映射区链表和页表,子进程与父进程共享
+// 全部页面,驻留页面数相同.
+static int copy_mm(int nr, unsigned long clone_flags, struct task_struct * p)
+{
+	if (clone_flags & CLONE_VM) {
+		current->mm->count++;
+		if (p->tss.cr3 >= LOW_MEM)
+			mem_map[MAP_NR(p->tss.cr3)]++;
+		return 0;
+	}
+	if (!(p->mm = new_mm()))
 		return -ENOMEM;
+	p->mm->owner = p;
+	p->mm->brk = current->mm->brk;
+	p->mm->rss = p->mm->max_rss = current->mm->rss;
+	if (copy_mmap(p))								// 复制mmap()映射区链表.
+		goto bad_mm;
+	if (copy_mem(nr, p)) {							// 返回不为0示出错.
+		exit_mmap(p);
+		goto bad_mm;
 	}
 	return 0;
+bad_mm:
+	kmem_cache_free(mm_cachep, p->mm);
+	return -ENOMEM;
+}
+
+// 为新任务p设置文件系统信息.不共享时复制一份,子进程也引用着工作目录和根目录i节点.
+static int copy_fs(unsigned long clone_flags, struct task_struct * p)
+{
+	if (clone_flags & CLONE_FS) {
+		current->fs->count++;
+		return 0;
+	}
+	if (!(p->fs = kmem_cache_alloc(fs_cachep, GFP_KERNEL)))
+		return -ENOMEM;
+	*p->fs = *current->fs;
+	p->fs->count = 1;
+	if (p->fs->pwd)
+		p->fs->pwd->i_count++;
+	if (p->fs->root)
+		p->fs->root->i_count++;
+	return 0;
+}
+
+// 复制当前任务的打开文件表.子进程与父进程共享打开着的文件,因此将对应文件的打开次数增1.
+static struct files_struct * dup_files(void)
+{
+	struct files_struct * files;
+	struct file * f;
+	int i;
+
+	if (!(files = kmem_cache_alloc(files_cachep, GFP_KERNEL)))
+		return NULL;
+	*files = *current->files;
+	files->count = 1;
+	for (i = 0; i < NR_OPEN; i++)
+		if (f = files->fd[i])
+			f->f_count++;
+	return files;
+}
+
+// 为新任务p设置打开文件表.
+static int copy_files(unsigned long clone_flags, struct task_struct * p)
+{
+	if (clone_flags & CLONE_FILES) {
+		current->files->count++;
+		return 0;
+	}
+	if (!(p->files = dup_files()))
+		return -ENOMEM;
+	return 0;
+}
+
+// 使当前任务有自己的一份打开文件表.execve()要按close_on_exec关闭文件,不能影响还在共享文件表的其他线程.
+int unshare_files(void)
+{
+	struct files_struct * files;
+
+	if (current->files->count == 1)
+		return 0;
+	if (!(files = dup_files()))
+		return -ENOMEM;
+	current->files->count--;
+	current->files = files;
+	return 0;
+}
+
+// 当前任务放弃对地址空间的引用.
+// 还有其他任务在使用时,若当前任务是属主,就把属主交给其中一个,以便交换等扫描页表的代码仍能找到这个地址空间.当前任务是最后一个
+// 使用者时,先解除mmap()映射(把共享映射中已修改的页面写回文件),再释放页表.页目录本身在release()中释放.
+void exit_mm(void)
+{
+	struct mm_struct * mm = current->mm;
+	int i;
+
+	if (--mm->count) {
+		current->mm = NULL;
+		if (mm->owner == current)
+			for (i = 1 ; i < NR_TASKS ; i++)
+				if (task[i] && task[i]->mm == mm) {
+					mm->owner = task[i];
+					break;
+				}
+		return;
+	}
+	exit_mmap(current);
+	free_page_tables(current->tss.cr3, get_base(current->ldt[1]), get_limit(0x0f));
+	free_page_tables(current->tss.cr3, get_base(current->ldt[2]), get_limit(0x17));
+	current->mm = NULL;
+	if (mm != &init_mm)
+		kmem_cache_free(mm_cachep, mm);
+}
+
+// 当前任务放弃对文件系统信息的引用.最后一个使用者放回工作目录和根目录i节点.
+void exit_fs(void)
+{
+	struct fs_struct * fs = current->fs;
+
+	current->fs = NULL;
+	if (--fs->count)
+		return;
+	iput(fs->pwd);
+	iput(fs->root);
+	if (fs != &init_fs)
+		kmem_cache_free(fs_cachep, fs);
+}
+
+// 当前任务放弃对打开文件表的引用.最后一个使用者关闭所有打开着的文件.
+void exit_files(void)
+{
+	struct files_struct * files = current->files;
+	int i;
+
+	if (--files->count) {
+		current->files = NULL;
+		return;
+	}
+	for (i = 0 ; i < NR_OPEN ; i++)
+		if (files->fd[i])
+			sys_close(i);
+	current->files = NULL;
+	if (files != &init_files)
+		kmem_cache_free(files_cachep, files);
 }
 
 /*
@@ -111,9 +302,18 @@ int copy_process(int nr, long ebp, long edi, long esi, long gs, long none,
 		long eip, long cs, long eflags, long esp, long ss)
 {
 	struct task_struct *p;
+	unsigned long clone_flags = 0;
 	int i;
-	struct file *f;
 
+	// clone()的参数ebx是共享标志,ecx是子进程的用户栈指针(为0时与父进程相同).vfork()相当于只共享地址空间的clone(),不过父进程
+	// 要等待子进程归还地址空间.共享信号处理句柄时必须同时共享地址空间,因为句柄是用户空间中的地址.
+	if (orig_eax == __NR_clone) {
+		clone_flags = ebx;
+		if ((clone_flags & ~(CLONE_VM | CLONE_FS | CLONE_FILES | CLONE_SIGHAND)) ||
+		    ((clone_flags & CLONE_SIGHAND) && !(clone_flags & CLONE_VM)))
+			return -EINVAL;
+	} else if (orig_eax == __NR_vfork)
+		clone_flags = CLONE_VM;
 	// 首先为新任务数据结构分配内存.如果内存分配出错,则返回出错码并退出.然后将新任务结构指针放入任务数组的nr项中.其中nr为任务号,由前面
 	// find_empty_process()返回.接着把当前进程任务结构复制到刚申请到的内存页面p开始处.
 	p = (struct task_struct *) get_free_page();
@@ -130,10 +330,14 @@ int copy_process(int nr, long ebp, long edi, long esi, long gs, long none,
 	p->counter = p->priority;				// 运行时间片值(嘀嗒数).
 	p->signal = 0;							// 信号位图.
 	p->alarm = 0;							// 报警定时值(嘀嗒数).
+	p->timeout_timer.pprev = NULL;			// 定时器不被子进程继承.
+	p->alarm_timer.pprev = NULL;
 	p->leader = 0;							/* process leadership doesn't inherit */	/* 进程的领导权是不能继承的 */
 	p->utime = p->stime = 0;				// 用户态时间和核心态运行时间.
 	p->cutime = p->cstime = 0;				// 子进程用户态和核心态运行时间.
 	p->start_time = jiffies;				// 进程开始运行时间(当前时间滴答数).
+	p->flags &= ~(PF_VFORK | PF_MLOCKALL);	// mlock()锁定不被子进程继承.
+	p->locked_pages = 0;
 	// 再修改任务状态段TSS数据.由于系统给任务结构p分配了1页新内存,所以(PAGE_SIZE + (long) p)让esp0正好指向该页顶端.ss0:esp0用作程序在内核
 	// 态执行时的栈.另外,在第3章中我们已经知道,每个任务在GDT表中都有两个段描述符,一个是任务的TSS段描述符,另一个是任务的LDT表段描述符.下面语句就是
 	// 把GDT中本任务LDT段描述符的选择符保存在本任务的TSS段.当CPU执行切换任务时,会自动从TSS中把LDT段描述符的选择符加载到ldtr寄存器中.
@@ -146,7 +350,7 @@ int copy_process(int nr, long ebp, long edi, long esi, long gs, long none,
 	p->tss.ecx = ecx;
 	p->tss.edx = edx;
 	p->tss.ebx = ebx;
-	p->tss.esp = esp;
+	p->tss.esp = (orig_eax == __NR_clone && ecx) ? ecx : esp;
 	p->tss.ebp = ebp;
 	p->tss.esi = esi;
 	p->tss.edi = edi;
@@ -164,26 +368,27 @@ int copy_process(int nr, long ebp, long edi, long esi, long gs, long none,
 	// 所有状态保存到目的操作数指定的内存区域中(tss.i387).
 	if (last_task_used_math == current)
 		__asm__("clts ; fnsave %0 ; frstor %0"::"m" (p->tss.i387));
-	// 接下来复制进程页表.即在线性地址空间设置新任务代码段和数据段描述符中的基址和限长,并复制页表.如果出错(返回值不是0),则复位任务数组中相应项并
-	// 释放为该新任务分配的用于任务结构的内存页.
-	if (copy_mem(nr, p)) {					// 返回不为0示出错.
-		task[nr] = NULL;
-		free_page((long) p);
-		return -EAGAIN;
-	}
-	// 如果父进程中有文件是打开的,则将对应文件的打开次数增1.因为这里创建的子进程会与父进程共享这些打开的文件.将当前进程(父进程)的pwd,root和
-	// executable引用次数均增1.与上面同样的道理,子进程也引用了这些i节点.
-	for (i = 0; i < NR_OPEN; i++)
-		if (f = p->filp[i])
-			f->f_count++;
-	if (current->pwd)
-		current->pwd->i_count++;
-	if (current->root)
-		current->root->i_count++;
+	// 接下来设置子进程的地址空间,文件系统信息和打开文件表,clone_flags中指定的资源与父进程共享,其余的复制一份.如果出错,则放弃已设置的
+	// 资源,复位任务数组中相应项并释放为该新任务分配的用于任务结构的内存页.
+	// 当前进程的executable和library引用次数增1,子进程也引用了这些i节点.
+	if (copy_files(clone_flags, p))
+		goto bad_fork;
+	if (copy_fs(clone_flags, p))
+		goto bad_fork_files;
+	if (copy_mm(nr, clone_flags, p))
+		goto bad_fork_fs;
+	if (orig_eax == __NR_vfork)
+		p->flags |= PF_VFORK;
+	if (clone_flags & CLONE_SIGHAND) {
+		p->sig_next = current->sig_next;		// 加入父进程的信号处理句柄共享环.
+		current->sig_next = p;
+	} else
+		p->sig_next = p;
 	if (current->executable)
 		current->executable->i_count++;
 	if (current->library)
 		current->library->i_count++;
+	link_text_inodes(p);						// 子进程也映射着同样的执行文件和库文件.
 	// 随后在GDT表中设置新任务TSS段和LDT段描述符项.这两个段的限长均被设置成104字节.参见include/asm/system.h.然后设置进程之间的关系链表指针,即把新进程插入
 	// 到当前进程的子进程链表中.把新进程的父进程设置为当前进程,把新进程的最新子进程指针p_cpt和年轻兄弟进程指针p_ysptr置空.接着让新进程的老兄进程指针p_osptr
 	// 设置等于父进程的最新子进程指针.若当前进程确实还有其他子进程,则让比邻老兄进程的最年轻进程指针p_yspter指向新进程.最后把当前进程的最新子进程指针指向这个新进程.
@@ -200,9 +405,44 @@ int copy_process(int nr, long ebp, long edi, long esi, long gs, long none,
 	if (p->p_osptr)						// 若新进程有老兄兄弟进程,则让其年轻进程兄弟指针指向新进程
 		p->p_osptr->p_ysptr = p;
 	current->p_cptr = p;				// 让当前进程最新子进程指针指向新进程.
-	p->state = TASK_RUNNING;			/* do this last, just in case */        /* 设置进程状态为待运行状态栏 */
+	// 当前任务不在就绪队列中,复制来的队列指针为空,报警和超时定时器也都不在定时器队列中.
+	wake_up_process(p);					/* do this last, just in case */        /* 设置进程状态为待运行状态栏 */
 	Log(LOG_INFO_TYPE, "<<<<< fork new process current_pid = %d, child_pid = %d, nr = %d >>>>>\n", current->pid, p->pid, nr);
+	// vfork()的父进程在子进程归还地址空间之前一直睡眠,因为子进程正在使用它的内存和用户栈.睡眠期间last_pid可能已改变,因此返回子进程的pid.
+	if (p->flags & PF_VFORK) {
+		while (p->flags & PF_VFORK)
+			sleep_on(&vfork_wait);
+		return p->pid;
+	}
 	return last_pid;        			// 返回新进程号
+bad_fork_fs:
+	if (!(clone_flags & CLONE_FS)) {
+		iput(p->fs->pwd);
+		iput(p->fs->root);
+		kmem_cache_free(fs_cachep, p->fs);
+	} else
+		current->fs->count--;
+bad_fork_files:
+	if (!(clone_flags & CLONE_FILES)) {
+		for (i = 0 ; i < NR_OPEN ; i++)
+			if (p->files->fd[i])
+				p->files->fd[i]->f_count--;
+		kmem_cache_free(files_cachep, p->files);
+	} else
+		current->files->count--;
+bad_fork:
+	task[nr] = NULL;
+	free_page((long) p);
+	return -EAGAIN;
+}
+
+// 归还vfork()借用的地址空间.
+// 由vfork()产生的子进程在execve()成功或退出时调用.清除借用标志并唤醒等待的父进程.由于等待队列是所有vfork()父进程共用的,
+// 被唤醒的父进程需要再检查自己的子进程是否已归还.
+void vfork_release(void)
+{
+	current->flags &= ~PF_VFORK;
+	wake_up(&vfork_wait);
 }
 
 // 为新进程取得不重复的进程号last_pid.函数返回在任务数组中的任务号(数组项).
@@ -17,13 +17,16 @@
 // 下面是调度程序头文件.定义了任务结构task_struct,第1个初始任务的数据.还有一些以宏的形式定义的有关描述符参数设置和获取的嵌入式汇编函数程序.
 #include <linux/sched.h>
 #include <linux/kernel.h>					// 内核头文件.含有一些内核常用函数的原形定义.
+#include <linux/mm.h>						// 内存管理头文件.含有页面清零池等函数的原形定义.
 #include <linux/sys.h>						// 系统调用头文件.含有82个系统调用C函数程序,以'sys_'开头.
 #include <linux/fdreg.h>					// 软驱头文件.含有软盘控制器参数的一些定义.
 #include <asm/system.h>						// 系统头文件.定义了设置或修改描述符/中断门等的嵌入式汇编宏.
 #include <asm/io.h>							// io头文件.定义硬件端口输入/输出宏汇编语句.
-//#include <asm/segment.h>
+#include <asm/segment.h>						// 段操作头文件.定义了有关段寄存器操作的嵌入式汇编函数.
 
+#include <errno.h>
 #include <signal.h>
+#include <time.h>
 
 // 该宏取信号nr在信号位图中对应位的二进制数值.信号编号1-32.比如信号5的位图数值等于1<<(5-1)=16=00010000.
 #define _S(nr) (1 << ((nr) - 1))
@@ -70,6 +73,7 @@ extern void mem_use(void);              	// 没有任何地方定义和引用该
 
 extern int timer_interrupt(void);			// 时钟中断处理程序(kernel/sys_call.s)
 extern int system_call(void);				// 系统调用中断处理程序(kernel/sys_call.s)
+extern int sysenter_entry(void);			// 快速系统调用入口(kernel/sys_call.s)
 
 // 每个任务(进程)在内核态运行时都有自己的内核态堆栈.这里定义了任务的内核态堆栈结构.
 // 这里定义任务联合(任务结构成员和stack字符数组成员).因为一个任务的数据结构与其内核态堆栈放在同一内存页中,所以从堆栈段寄存器ss可以获得其
@@ -82,6 +86,11 @@ union task_union {
 // 设置初始任务的数据.初始数据在include/kernel/sched.h中.
 static union task_union init_task = {INIT_TASK, };
 
+// 任务0的地址空间,文件系统信息和打开文件表.任务0的子进程不与它共享这些资源,因此引用计数一直为1.
+struct mm_struct init_mm = {1, &init_task.task, 0, 0, 0, NULL, 0, NULL};
+struct fs_struct init_fs = {1, 0022, NULL, NULL};
+struct files_struct init_files = {1, 0, {NULL, }};
+
 // 从开机开始算起的滴答数时间值全局变量(10ms/滴答).系统时钟中断每发生一次即一个滴答.前面的限定符volatile,英文解释是易改变的,不稳定的意思.
 // 这个限定词的含义是向编译器指明变量的内容可能会由于被其他程序修改面变化.通常在程序中声明一个变量时,编译器会尽量把它存放在通用寄存器中, 例如
 // ebx,以提高访问效率.当CPU把其值放到ebx中后一般就不会再关心该变量对应内存位置中的内容.若此时其他程序(例如内核程序或一个中断过程)修改了内存中
@@ -147,6 +156,158 @@ void math_state_restore()
 	}
 }
 
+/*
+ * Run queues. Runnable tasks other than the current one and task 0 are
+ * kept on one list per counter value, with a bitmap of the lists that are
+ * not empty, so the scheduler finds the highest counter with one bsr
+ * instead of looking at every task. A task whose slice is used up goes
+ * on the expired lists, at the level it will have after the next
+ * 'counter = counter/2 + priority'. When only expired tasks are left the
+ * two sets are swapped, and the recalculation, which used to loop over
+ * all tasks, is counted in sched_epoch and done for each task when it is
+ * next queued or picked.
+ */
+/*
+ * 就绪队列.除当前任务和任务0以外的就绪任务按counter值分别放在各级队列中,并用位图记录哪些队列不空,这样调度程序用一条bsr指令就能找到
+ * counter最大的任务,而不用查看每个任务.时间片已用完的任务放在另一组(expired)队列中,其级别是下一次'counter = counter/2 + priority'
+ * 之后的值.只剩下时间片已用完的任务时交换两组队列,原来对所有任务循环的重新计算只在sched_epoch中计数,到任务下次进入队列或被选中时
+ * 再补算.
+ */
+#define NR_RUN_LEVELS	64
+
+// 由任务LDT描述符的选择符(fork()时设置为_LDT(nr))求任务号.
+#define task_nr(p) (((p)->tss.ldt - (FIRST_LDT_ENTRY << 3)) >> 4)
+
+struct prio_array {
+	unsigned long bitmap[NR_RUN_LEVELS / 32];		// 不空队列的位图.
+	struct task_struct * queue[NR_RUN_LEVELS];		// 各级队列的队首(双向环形链表).
+};
+
+static struct prio_array prio_arrays[2];
+static struct prio_array * active = prio_arrays;		// 还有时间片的任务.
+static struct prio_array * expired = prio_arrays + 1;	// 时间片已用完的任务.
+static unsigned long sched_epoch = 0;					// 时间片重新计算的次数.
+int nr_running = 0;										// 就绪队列中的任务数.
+
+// 把任务p错过的时间片重新计算补算到它的counter上.重复32次之后原counter值已不起作用.
+static inline void update_counter(struct task_struct * p)
+{
+	unsigned long n = sched_epoch - p->epoch;
+
+	if (n > 32)
+		n = 32;
+	while (n--)
+		p->counter = (p->counter >> 1) + p->priority;
+	p->epoch = sched_epoch;
+}
+
+// 把任务p加入就绪队列尾.
+static void enqueue_task(struct task_struct * p)
+{
+	struct prio_array * array = active;
+	struct task_struct * head;
+	int level;
+
+	update_counter(p);
+	if (!(level = p->counter)) {
+		array = expired;
+		level = p->priority;
+	}
+	if (level >= NR_RUN_LEVELS)
+		level = NR_RUN_LEVELS - 1;
+	if (head = array->queue[level]) {
+		p->run_next = head;
+		p->run_prev = head->run_prev;
+		head->run_prev->run_next = p;
+		head->run_prev = p;
+	} else {
+		p->run_next = p->run_prev = p;
+		array->queue[level] = p;
+		array->bitmap[level >> 5] |= 1 << (level & 31);
+	}
+	p->array = array;
+	p->run_level = level;
+	nr_running++;
+}
+
+// 把任务p从就绪队列中取下.
+static void dequeue_task(struct task_struct * p)
+{
+	struct prio_array * array = p->array;
+	int level = p->run_level;
+
+	if (p->run_next == p) {
+		array->queue[level] = NULL;
+		array->bitmap[level >> 5] &= ~(1 << (level & 31));
+	} else {
+		p->run_prev->run_next = p->run_next;
+		p->run_next->run_prev = p->run_prev;
+		if (array->queue[level] == p)
+			array->queue[level] = p->run_next;
+	}
+	p->run_next = p->run_prev = NULL;
+	p->array = NULL;
+	nr_running--;
+}
+
+// 取队列组中不空的最高级别,队列都空时返回-1.
+static inline int highest_level(struct prio_array * array)
+{
+	int i, level;
+
+	for (i = NR_RUN_LEVELS / 32 - 1 ; i >= 0 ; i--)
+		if (array->bitmap[i]) {
+			__asm__("bsrl %1, %0":"=r" (level):"rm" (array->bitmap[i]));
+			return (i << 5) + level;
+		}
+	return -1;
+}
+
+// 把任务p置为就绪状态.当前任务和任务0不在就绪队列中,当前任务在调度时才放入队列.
+// 可以在中断处理程序中调用.
+void wake_up_process(struct task_struct * p)
+{
+	unsigned long flags;
+
+	save_flags(flags);
+	cli();
+	p->state = TASK_RUNNING;
+	if (p != current && p != task[0] && !p->run_next)
+		enqueue_task(p);
+	restore_flags(flags);
+}
+
+// 给任务p发送信号之后调用.若它处于可中断睡眠状态,并且有未被阻塞的信号,就唤醒它.
+// 其中'~(_BLOCKABLE & p->blocked)'用于忽略被阻塞的信号,但SIGKILL和SIGSTOP不能被阻塞.
+void signal_wake_up(struct task_struct * p)
+{
+	if (p->state == TASK_INTERRUPTIBLE && (p->signal & ~(_BLOCKABLE & p->blocked)))
+		wake_up_process(p);
+}
+
+// 超时定时器到期.清除任务的超时值,若它在可中断睡眠中就唤醒它.
+// 定时器在任务睡眠时按当时的timeout设置,timeout此后被改变时这里的检查使过时的定时器不起作用.
+static void timeout_expired(unsigned long data)
+{
+	struct task_struct * p = (struct task_struct *) data;
+
+	if (p->timeout && p->timeout < jiffies) {
+		p->timeout = 0;
+		if (p->state == TASK_INTERRUPTIBLE)
+			wake_up_process(p);
+	}
+}
+
+// 报警定时器到期,向任务发送SIGALRM信号.
+static void alarm_expired(unsigned long data)
+{
+	struct task_struct * p = (struct task_struct *) data;
+
+	p->alarm = 0;
+	p->signal |= (1 << (SIGALRM - 1));
+	signal_wake_up(p);
+}
+
 /*
  *  'schedule()' is the scheduler function. This is GOOD CODE! There
  * probably won't be any reason to change this, as it should work well
@@ -166,61 +327,57 @@ void math_state_restore()
  */
 void schedule(void)
 {
-	int i, next, c;
-	struct task_struct ** p;						// 任务结构指针的指针.
-
-	/* check alarm, wake up any interruptible tasks that have got a signal */
-	/* 检测alarm(进程的报警定时值),唤醒任何已得到信号的可中断任务 */
-
-	// 从任务数组中最后一个任务开始循环检测alarm.在循环时跳过空指针项.
-	for(p = &LAST_TASK ; p > &FIRST_TASK ; --p)
-		if (*p) {
-			// 如果设置过任务超时定时timeout,并且已经超时,则复位超时定时值,并且如果任务处于可中断睡眠状态TASK_INTERRUPTIBLE下,将其置为就绪
-			// 状态(TASK_RUNNING).
-			if ((*p)->timeout && (*p)->timeout < jiffies) {
-				(*p)->timeout = 0;
-				if ((*p)->state == TASK_INTERRUPTIBLE)
-					(*p)->state = TASK_RUNNING;
-			}
-			// 如果设置过任务的定时值alarm,并且已经过期(alarm<jiffies),则在信号位图中置SIGALRM信号,即向任务发送SIGALARM信号.然后清alarm.
-			// 该信号的默认操作是终止进程.jiffies是系统从开机开始算起的滴答数(10ms/滴答).定义在sched.h中.
-			if ((*p)->alarm && (*p)->alarm < jiffies) {
-				(*p)->signal |= (1 << (SIGALRM - 1));
-				(*p)->alarm = 0;
+	struct task_struct * prev = current, * next;
+	unsigned long flags;
+	int level;
+
+	save_flags(flags);
+	cli();
+	/* check timeout, wake up if the task has got a signal */
+	/* 当前任务要进入可中断睡眠时,检查它是否已有信号或已超时 */
+	// 信号和定时器到期时会直接唤醒睡眠的任务,这里只需处理当前任务在睡眠之前已经收到信号或者超时的情况.否则若设置了超时值timeout,则为它
+	// 设置超时定时器(timeout为0xffffffff等很大的值时表示不会超时).
+	if (prev->state == TASK_INTERRUPTIBLE) {
+		if (prev->signal & ~(_BLOCKABLE & prev->blocked))
+			prev->state = TASK_RUNNING;
+		else if (prev->timeout) {
+			if (prev->timeout < jiffies) {
+				prev->timeout = 0;
+				prev->state = TASK_RUNNING;
+			} else if (prev->timeout - jiffies < 0x7fffffff) {
+				prev->timeout_timer.fn = timeout_expired;
+				prev->timeout_timer.data = (unsigned long) prev;
+				set_timer(&prev->timeout_timer, prev->timeout - jiffies + 1);
 			}
-			// 如果信号位图中除被阻塞的信号外还有其他信号,并且任务处于可中断状态,则置任务为就绪状态.
-			// 其中'~(_BLOCKABLE & (*p)->blocked)'用于忽略被阻塞的信号,但SIGKILL和SIGSTOP不能被阻塞.
-			if (((*p)->signal & ~(_BLOCKABLE & (*p)->blocked)) && (*p)->state == TASK_INTERRUPTIBLE)
-				(*p)->state = TASK_RUNNING;
 		}
+	}
 
 	/* this is the scheduler proper: */
 	/* 这里是调度程序的主要部分 */
-	while (1) {
-		c = -1;
-		next = 0;
-		i = NR_TASKS;
-		p = &task[NR_TASKS];
-		// 这段代码是从任务数组的最后一个任务开始循环处理,并跳过不含任务的数组糟.比较每个就绪状态任务的counter(任务运行时间的递减滴答计数)值,
-		// 哪一个值大,运行时间还不长,next就指向哪个的任务号.
-		while (--i) {
-			// 当前索引没有进程指针则跳过当前循环
-			if (!*--p)
-				continue;
-			if ((*p)->state == TASK_RUNNING && (*p)->counter > c)
-				c = (*p)->counter, next = i;
-		}
-		// 如果比较得出有counter值不等于0的结果,或者後方中没有一个可运行的任务存在(此时c仍然为-1,next=0),则退出开始的循环,执行161行上的任务切换
-		// 操作.否则就根据每个任务的优先权值,更新每一个任务的counter值,然后回到125行重新比较.counter值的计算方式为counter = counter /2 +priority.
-		// 注意,这里计算过程不考虑进程的状态.
-		if (c) break;
-		for(p = &LAST_TASK ; p > &FIRST_TASK ; --p)
-			if (*p)
-				(*p)->counter = ((*p)->counter >> 1) + (*p)->priority;
+	// 仍然就绪的当前任务放回就绪队列,然后取counter最大的队列的队首任务.若只剩下时间片已用完的任务,则交换两组队列,即所有任务都做一次
+	// counter = counter/2 + priority.没有任何就绪任务时切换到任务0.
+	// 若原任务的counter与最大值相差不超过1,则继续运行原任务:它的用户页面和页表很可能还在高速缓存中.
+	if (prev->state == TASK_RUNNING && prev != task[0])
+		enqueue_task(prev);
+	if ((level = highest_level(active)) < 0 && (level = highest_level(expired)) >= 0) {
+		struct prio_array * tmp = active;
+
+		active = expired;
+		expired = tmp;
+		sched_epoch++;
+	}
+	next = task[0];
+	if (level >= 0) {
+		next = active->queue[level];
+		if (prev->array == active && prev->run_level + 1 >= level)
+			next = prev;
+		dequeue_task(next);
+		update_counter(next);
 	}
-	// 用下面的宏(定义在sched.h中)把当前任务指针current指向任务号为next的任务,并切换到该任务中运行.在146行上next被初始化为0.因此若系统中没有任何
-	// 其他任务可运行时,则next始终为0.因此调度函数会在系统空闲时去执行任务0.此时任务0权执行pause()
-	switch_to(next);					// 切换到任务号为next的任务,并运行之.
+	// 用下面的宏(定义在sched.h中)把当前任务指针current指向任务next,并切换到该任务中运行.若系统中没有任何其他任务可运行时,则next为任务0.
+	// 此时任务0执行pause().
+	switch_to(task_nr(next));			// 切换到任务next,并运行之.
+	restore_flags(flags);
 }
 
 // pause()系统调用.转换当前任务的状态为可中断的等待状态,并重新调试.
@@ -228,6 +385,11 @@ void schedule(void)
 // pause()才会返回.此时pause()返回值应该是-1,并且errno被置为EINTR.这里还没有完全实现(直到0.95版).
 int sys_pause(void)
 {
+	// 任务0只在系统空闲时运行并执行pause(),利用这段时间预先清零一些空闲页面,并合并内容相同的页面.
+	if (current == task[0]) {
+		fill_zeroed_pages();
+		ksm_scan();
+	}
 	current->state = TASK_INTERRUPTIBLE;
 	schedule();
 	return 0;
@@ -260,7 +422,7 @@ repeat:	schedule();
 	// 在本任务插入等待队列后还有任务进入等待队列.于是我们应该也要唤醒这个任务,而我们自己应按顺序让这些后面进入队列的任务唤醒,因此这里将等待队列头所指任务先
 	// 置为就绪状态,而自己则置为不可中断等待状态,即自己要等待这些后续队列的任务被唤醒而执行时来唤醒本任务.然后重新执行调度程序.
 	if (*p && *p != current) {
-		(**p).state = 0;
+		wake_up_process(*p);
 		current->state = TASK_UNINTERRUPTIBLE;
 		goto repeat;
 	}
@@ -269,7 +431,7 @@ repeat:	schedule();
 	if (!*p)
 		printk("Warning: *P = NULL\n\r");
 	if (*p = tmp)
-		tmp->state = 0;
+		wake_up_process(tmp);
 }
 
 // 将当前任务置为可中断的等待状态(TASK_INIERRUPTIBLE),并放入头指针*p指定的等待队列中.
@@ -294,7 +456,7 @@ void wake_up(struct task_struct **p)
 			printk("wake_up: TASK_STOPPED");
 		if ((**p).state == TASK_ZOMBIE)							// 处于僵死状态.
 			printk("wake_up: TASK_ZOMBIE");
-		(**p).state=0;											// 置为就绪状态TASK_RUNNING.
+		wake_up_process(*p);									// 置为就绪状态TASK_RUNNING.
 	}
 }
 
@@ -393,68 +555,349 @@ void do_floppy_timer(void)
 	}
 }
 
-// 下面是关于定时器的代码.最多可有64个定时器.
+// 下面是关于定时器的代码.
+// 定时器按到期时间(jiffies的绝对值)放在分级时间轮中:tv1有256个槽,每槽对应一个滴答;tv2 - tv5各有64个槽,每槽分别对应2^8,2^14,2^20和
+// 2^26个滴答.每个槽是一个双向链表(pprev指向前一项的next字段),因此加入和取消定时器都只需常数时间.时钟中断中只处理tv1的当前槽,tv1转完一圈
+// 时才把tv2的下一个槽重新分配到tv1中,依次类推.定时器的存储由调用者提供(例如任务结构中的超时和报警定时器),add_timer()使用的定时器从
+// 对象缓存中分配,并预留64个.
 #define TIME_REQUESTS 64
 
-// 定时器链表结构和定时器数组.该定时器链表专用于供软驱关闭马达和启动马达定时操作.这种类型定时器类似现代Linux系统中的动态定时器(Dynamic Timer),
-// 仅供内核使用.
-static struct timer_list {
-	long jiffies;										// 定时滴答数.
-	void (*fn)();										// 定时处理程序.
-	struct timer_list * next;							// 链接指向下一个定时器.
-} timer_list[TIME_REQUESTS], * next_timer = NULL;		// next_timer是定时器队列头指针.
+#define TVN_BITS 6
+#define TVR_BITS 8
+#define TVN_SIZE (1 << TVN_BITS)
+#define TVR_SIZE (1 << TVR_BITS)
+#define TVN_MASK (TVN_SIZE - 1)
+#define TVR_MASK (TVR_SIZE - 1)
+
+static struct timer_list * tv1[TVR_SIZE];
+static struct timer_list * tv2[TVN_SIZE];
+static struct timer_list * tv3[TVN_SIZE];
+static struct timer_list * tv4[TVN_SIZE];
+static struct timer_list * tv5[TVN_SIZE];
+
+static unsigned long timer_jiffies = 0;					// 时间轮已处理到的滴答数.
+
+// add_timer()分配的定时器.
+struct timer_request {
+	struct timer_list timer;
+	void (*fn)(void);									// 定时处理程序.
+};
+
+static struct kmem_cache * timer_cachep;				// 定时器对象缓存.
+
+// 把定时器插入到链表*head的头部.
+static inline void link_timer(struct timer_list ** head, struct timer_list * timer)
+{
+	if (timer->next = *head)
+		(*head)->pprev = &timer->next;
+	*head = timer;
+	timer->pprev = head;
+}
+
+// 根据到期时间与timer_jiffies的差值选择时间轮及其中的槽,把定时器放入.已经到期的定时器放在tv1中下一个要处理的槽里.调用时须已关中断.
+static void internal_add_timer(struct timer_list * timer)
+{
+	unsigned long expires = timer->expires;
+	unsigned long idx = expires - timer_jiffies;
+	struct timer_list ** vec;
+
+	if (idx < TVR_SIZE)
+		vec = tv1 + (expires & TVR_MASK);
+	else if (idx < 1 << (TVR_BITS + TVN_BITS))
+		vec = tv2 + ((expires >> TVR_BITS) & TVN_MASK);
+	else if (idx < 1 << (TVR_BITS + 2 * TVN_BITS))
+		vec = tv3 + ((expires >> (TVR_BITS + TVN_BITS)) & TVN_MASK);
+	else if (idx < 1 << (TVR_BITS + 3 * TVN_BITS))
+		vec = tv4 + ((expires >> (TVR_BITS + 2 * TVN_BITS)) & TVN_MASK);
+	else if ((long) idx < 0)
+		vec = tv1 + (timer_jiffies & TVR_MASK);
+	else
+		vec = tv5 + ((expires >> (TVR_BITS + 3 * TVN_BITS)) & TVN_MASK);
+	link_timer(vec, timer);
+}
+
+// 把时间轮tv中槽index上的定时器重新分配到低一级的时间轮中.返回index,为0时表示该级时间轮也转完了一圈,需要再处理更高一级.
+static int cascade(struct timer_list ** tv, int index)
+{
+	struct timer_list * timer, * next;
+
+	timer = tv[index];
+	tv[index] = NULL;
+	while (timer) {
+		next = timer->next;
+		internal_add_timer(timer);
+		timer = next;
+	}
+	return index;
+}
+
+#define INDEX(N) ((timer_jiffies >> (TVR_BITS + (N) * TVN_BITS)) & TVN_MASK)
+
+// 处理到期的定时器.在时钟中断中(已关中断)被调用.
+// 对timer_jiffies到jiffies之间的每个滴答,先在tv1转完一圈时逐级重新分配高级时间轮的槽,然后把tv1当前槽的整个链表取下,逐个调用其中
+// 定时器的处理函数.处理函数中新加入的定时器只会进入其他槽或下一个槽,因此不会在本次被处理.
+static void run_timers(void)
+{
+	struct timer_list * head, * timer;
+	int index;
+
+	while ((long) (jiffies - timer_jiffies) >= 0) {
+		index = timer_jiffies & TVR_MASK;
+		if (!index && !cascade(tv2, INDEX(0)) && !cascade(tv3, INDEX(1)) && !cascade(tv4, INDEX(2)))
+			cascade(tv5, INDEX(3));
+		timer_jiffies++;
+		if (head = tv1[index]) {
+			tv1[index] = NULL;
+			head->pprev = &head;
+		}
+		while (timer = head) {
+			if (head = timer->next)
+				head->pprev = &head;
+			timer->next = NULL;
+			timer->pprev = NULL;
+			(timer->fn)(timer->data);				// 调用定时处理函数.
+		}
+	}
+}
+
+// 取消定时器.定时器在时间轮中时把它取下并返回1;否则返回0.
+int del_timer(struct timer_list * timer)
+{
+	unsigned long flags;
+
+	save_flags(flags);
+	cli();
+	if (!timer->pprev) {
+		restore_flags(flags);
+		return 0;
+	}
+	if (*timer->pprev = timer->next)
+		timer->next->pprev = timer->pprev;
+	timer->next = NULL;
+	timer->pprev = NULL;
+	restore_flags(flags);
+	return 1;
+}
+
+// 设置定时器在ticks个滴答后到期.定时器已在时间轮中时先取下它.
+void set_timer(struct timer_list * timer, long ticks)
+{
+	unsigned long flags;
+
+	save_flags(flags);
+	cli();
+	del_timer(timer);
+	if (ticks < 1)
+		ticks = 1;
+	timer->expires = jiffies + ticks;
+	internal_add_timer(timer);
+	restore_flags(flags);
+}
+
+// add_timer()分配的定时器到期:释放定时器,再调用定时处理程序.
+static void timer_request_done(unsigned long data)
+{
+	struct timer_request * r = (struct timer_request *) data;
+	void (*fn)(void) = r->fn;
+
+	kmem_cache_free(timer_cachep, r);
+	(fn)();
+}
 
 // 添加定时器.输入参数为指定的定时值(滴答数)和相应的处理程序指针.
-// 软盘驱动程序(floppy.c)利用该函数执行启动或关闭马达的延时操作.
+// 需要反复使用或需要取消的定时器应该由调用者提供struct timer_list并使用set_timer(),这里只是为了兼容而保留的简单接口.
 // 参数jiffies- 以10毫秒计的滴答数; *fn() - 定时时间到时执行的函数.
 void add_timer(long jiffies, void (*fn)(void))
 {
-	struct timer_list * p;
+	struct timer_request * r;
+	unsigned long flags;
 
 	// 如果定时处理程序指针为空,则退出.否则关中断.
 	if (!fn)
 		return;
+	save_flags(flags);
 	cli();
-	// 如果定时值<=0,则立刻调用其处理程序.并且该定时器不加入链表中.
+	// 如果定时值<=0,则立刻调用其处理程序.并且该定时器不加入时间轮中.
 	if (jiffies <= 0)
 		(fn)();
 	else {
-		// 否则从定时器数组中,找一个空闲项.
-		for (p = timer_list ; p < timer_list + TIME_REQUESTS ; p++)
-			if (!p->fn)
-				break;
-		// 如果已经用完了定时器数组,则系统崩溃.否则向定时器数据结构填入就信息,并链入链表头.
-		if (p >= timer_list + TIME_REQUESTS)
-			panic("No more time requests free");
-		p->fn = fn;
-		p->jiffies = jiffies;
-		p->next = next_timer;
-		next_timer = p;
-		// 链表项按定时值从小到大排序.在排序时减去排在前面需要的滴答数,这样在处理定时器时只要查看链表头的第一项的定时是否到期即可.
-		// [[?? 这段程序好像没有考虑周全.如果新插入的定时器值小于原来关一个定时器值时则根本没会进入循环中,但此时还是应该将紧随后面
-		// 的一个定时器值减去新的第1个的定时值.即如果第1个定时值<=第2个,则第2个定时值扣除第1个的值即可,否则进入下面循环中进行处理.]]
-		while (p->next && p->next->jiffies < p->jiffies) {
-			p->jiffies -= p->next->jiffies;
-			fn = p->fn;
-			p->fn = p->next->fn;
-			p->next->fn = fn;
-			jiffies = p->jiffies;
-			p->jiffies = p->next->jiffies;
-			p->next->jiffies = jiffies;
-			p = p->next;
+		// 否则从定时器对象缓存中分配一项.add_timer()可能在中断中被调用,因此不能睡眠.分配不到定时器时只能立刻调用处理程序,这比丢失
+		// 这次定时要好.
+		if (!(r = (struct timer_request *) kmem_cache_alloc(timer_cachep, GFP_ATOMIC))) {
+			printk("add_timer: out of memory\n\r");
+			(fn)();
+		} else {
+			r->fn = fn;
+			r->timer.fn = timer_request_done;
+			r->timer.data = (unsigned long) r;
+			r->timer.pprev = NULL;
+			set_timer(&r->timer, jiffies);
+		}
+	}
+	restore_flags(flags);
+}
+
+// 下面是高精度定时器的代码.
+// 8253定时器通道0工作在方式0(计数到0时产生一次中断),每次中断时按下一个到期的事件重新设置计数值:通常是下一个滴答的边界,若有高精度
+// 定时器在这之前到期,则是该定时器的到期时刻.tick_cycles是当前滴答中已经过的计数周期数(1193180Hz),满LATCH时jiffies增1.高精度定时器
+// 的到期时刻用(jiffies, 计数周期数)表示,按到期时刻排序放在hr_timers链表中.这种定时器一般只有睡眠的任务使用,数量很少.
+// 为了限制中断频率,两次中断的间隔至少为HR_MIN_CYCLES个计数周期(约50微秒).
+// 每次读计数器都把经过的周期加到tick_cycles上,重新设置计数值之前也先读一次,因此中断处理本身花费的时间不会丢失.从锁存计数值到新的计数
+// 开始之间的几次端口操作所用的时间无法读出,按固定的PIT_WRITE_CYCLES个周期计算.
+#define HR_MIN_CYCLES 60
+#define PIT_WRITE_CYCLES 6
+#define HR_MAX_SECS (0x3fffffff / HZ)
+
+static unsigned long tick_cycles = 0;					// 当前滴答中已经过的计数周期数.
+static unsigned long pit_last = LATCH;					// 最近一次读出或设置的计数值.
+static struct hrtimer * hr_timers = NULL;				// 高精度定时器链表.
+
+// 取自最近一次读出或设置计数值以来经过的计数周期数,调用者须把它加到tick_cycles上.调用时须已关中断.
+// 方式0中计数到0以后计数器仍继续递减(从0xffff开始),因此按16位取差值即可,只要两次读数之间不超过32768个周期(约27毫秒).刚写入的计数值
+// 要到下一个时钟周期才装入计数器,这之前读出的值可能比写入的值大,这时差值为负,当作没有经过时间.
+static unsigned long pit_elapsed(void)
+{
+	unsigned long count, elapsed;
+
+	outb_p(0x00, 0x43);					/* latch counter 0 */	// 锁存通道0的当前计数值.
+	count = inb_p(0x40);
+	count |= inb_p(0x40) << 8;
+	elapsed = (pit_last - count) & 0xffff;
+	if (elapsed >= 0x8000)
+		return 0;
+	pit_last = count;
+	return elapsed;
+}
+
+// 按下一个到期的事件设置8253通道0的计数值.调用时须已关中断.
+// 先把到现在为止经过的周期以及写计数值所需的周期加到tick_cycles上,再计算计数值.
+static void program_pit(void)
+{
+	long count;
+
+	tick_cycles += pit_elapsed() + PIT_WRITE_CYCLES;
+	count = LATCH - tick_cycles;
+	if (hr_timers && (long) (hr_timers->expires - jiffies) <= 0) {
+		if (hr_timers->expires != jiffies)
+			count = 0;
+		else if ((long) (hr_timers->cycles - tick_cycles) < count)
+			count = hr_timers->cycles - tick_cycles;
+	}
+	if (count < HR_MIN_CYCLES)
+		count = HR_MIN_CYCLES;
+	pit_last = count;
+	outb_p(count & 0xff, 0x40);			/* LSB */
+	outb_p(count >> 8, 0x40);			/* MSB */
+}
+
+// 定时器a是否比b先到期(或同时到期).
+static inline int hrtimer_before(struct hrtimer * a, struct hrtimer * b)
+{
+	if (a->expires != b->expires)
+		return (long) (a->expires - b->expires) < 0;
+	return a->cycles <= b->cycles;
+}
+
+// 取消高精度定时器.定时器在链表中时把它取下并返回1;否则返回0.
+int del_hrtimer(struct hrtimer * timer)
+{
+	unsigned long flags;
+
+	save_flags(flags);
+	cli();
+	if (!timer->pprev) {
+		restore_flags(flags);
+		return 0;
+	}
+	if (*timer->pprev = timer->next)
+		timer->next->pprev = timer->pprev;
+	timer->next = NULL;
+	timer->pprev = NULL;
+	restore_flags(flags);
+	return 1;
+}
+
+// 设置高精度定时器在sec秒加usec微秒之后到期.定时器已在链表中时先取下它.
+// 到期时刻是现在的时刻(jiffies加上tick_cycles和8253计数器中已经过的周期数)加上该时间间隔,间隔最长为HR_MAX_SECS秒.若定时器成为链表
+// 中的第一项,则需要马上重新设置8253的计数值.
+void set_hrtimer(struct hrtimer * timer, unsigned long sec, unsigned long usec)
+{
+	struct hrtimer ** p;
+	unsigned long flags, cycles;
+
+	sec += usec / 1000000;
+	usec %= 1000000;
+	if (sec > HR_MAX_SECS)
+		sec = HR_MAX_SECS;
+	save_flags(flags);
+	cli();
+	del_hrtimer(timer);
+	tick_cycles += pit_elapsed();
+	cycles = tick_cycles + (usec % (1000000 / HZ)) * LATCH / (1000000 / HZ);
+	timer->expires = jiffies + sec * HZ + usec / (1000000 / HZ) + cycles / LATCH;
+	timer->cycles = cycles % LATCH;
+	for (p = &hr_timers ; *p && hrtimer_before(*p, timer) ; p = &(*p)->next)
+		/* nothing */ ;
+	if (timer->next = *p)
+		(*p)->pprev = &timer->next;
+	*p = timer;
+	timer->pprev = p;
+	if (hr_timers == timer)
+		program_pit();
+	restore_flags(flags);
+}
+
+// 取高精度定时器到期之前剩余的时间,以秒数和微秒数返回.定时器不在链表中时返回0.
+void hrtimer_left(struct hrtimer * timer, unsigned long * sec, unsigned long * usec)
+{
+	unsigned long flags, now, ticks;
+	long cycles;
+
+	*sec = *usec = 0;
+	save_flags(flags);
+	cli();
+	if (timer->pprev) {
+		tick_cycles += pit_elapsed();
+		now = tick_cycles;
+		ticks = timer->expires - jiffies - now / LATCH;
+		cycles = timer->cycles - now % LATCH;
+		if (cycles < 0) {
+			cycles += LATCH;
+			ticks--;
 		}
-		// 修正上述问题.
-		if(p->next && p->next->jiffies >= p->jiffies) {
-			p->next->jiffies -= p->jiffies;
+		if ((long) ticks >= 0) {
+			*sec = ticks / HZ;
+			*usec = (ticks % HZ) * (1000000 / HZ) + cycles * (1000000 / HZ) / LATCH;
 		}
 	}
-	sti();
+	restore_flags(flags);
 }
 
-// 时钟中断C函数处理程序,在sys_call.s中的timer_interrupt被调用.
+// 调用到期的高精度定时器的处理函数.在时钟中断中(已关中断)被调用.返回调用的处理函数个数.
+static int run_hrtimers(void)
+{
+	struct hrtimer * timer, now;
+	int nr = 0;
+
+	now.expires = jiffies;
+	now.cycles = tick_cycles;
+	while ((timer = hr_timers) && hrtimer_before(timer, &now)) {
+		if (hr_timers = timer->next)
+			hr_timers->pprev = &hr_timers;
+		timer->next = NULL;
+		timer->pprev = NULL;
+		(timer->fn)(timer->data);
+		nr++;
+	}
+	return nr;
+}
+
+// 时钟滴答处理程序,由下面的do_timer_interrupt()每个滴答调用一次.
+// 参数cpl是当前特权级0或3,是时钟中断发生时正被执行的代码选择符中的特权级.cpl=0时表示中断发生时正在执行内核代码,cpl=3时表示中断发生时正在执行用户
+// 代码.执行计时更新工作,当前进程的时间片用完时返回1.
 // 参数cpl是当前特权级0或3,是时钟中断发生时正被执行的代码选择符中的特权级.cpl=0时表示中断发生时正在执行内核代码,cpl=3时表示中断发生时正在执行用户
 // 代码.对于一个进程由于执行时间片用完时,则进行任务切换.并执行一个计时更新工作.
-void do_timer(long cpl)
+static int do_timer(long cpl)
 {
 	static int blanked = 0;
 
@@ -488,27 +931,78 @@ void do_timer(long cpl)
 	else
 		current->stime++;
 
-	// 如果有定时器存在,则将链表第1个定时器的值减1.如果已等于0,则调用相应的处理程序,并将该处理程序指针置空.然后去掉该项定时器.next_timer是
-	// 定时器链表的头指针.
-	if (next_timer) {
-		next_timer->jiffies--;
-		while (next_timer && next_timer->jiffies <= 0) {
-			void (*fn)(void);						// 这里插入了一个函数指针定义!!
-
-			fn = next_timer->fn;
-			next_timer->fn = NULL;
-			next_timer = next_timer->next;
-			(fn)();									// 调用定时处理函数.
-		}
-	}
+	// 处理时间轮中到期的定时器.
+	run_timers();
 	// 如果当前软盘控制器FDC的数字输出寄存器中马达启动位有置位的,则执行软盘定时程序.
 	if (current_DOR & 0xf0)
 		do_floppy_timer();
-	// 如果进程运行时间还没完,则退出.否则置当前任务运行计数值为0.并且若发生时钟中断时正在内核代码中运行则返回,否则调用执行调试函数.
-	if ((--current->counter) > 0) return;
+	// 如果进程运行时间还没完,则返回0.否则置当前任务运行计数值为0并返回1.
+	if ((--current->counter) > 0) return 0;
 	current->counter = 0;
-	if (!cpl) return;								// 对于内核态程序,不信赖counter值进行调试.
-	schedule();
+	return 1;
+}
+
+// 时钟中断C函数处理程序,在sys_call.s中的timer_interrupt被调用.
+// 先把8253本次经过的计数周期加到tick_cycles上,每满LATCH个周期jiffies增1并调用do_timer().然后调用到期的高精度定时器,再按下一个到期
+// 的事件重新设置8253.时间片用完或者高精度定时器唤醒了任务时,若中断发生时正在执行用户代码,则调用调度函数(内核态程序不可抢占).
+void do_timer_interrupt(long cpl)
+{
+	int resched = 0;
+
+	tick_cycles += pit_elapsed();
+	while (tick_cycles >= LATCH) {
+		tick_cycles -= LATCH;
+		jiffies++;
+		resched |= do_timer(cpl);
+	}
+	if (run_hrtimers())
+		resched = 1;
+	program_pit();
+	if (resched && cpl)
+		schedule();
+}
+
+// 睡眠定时器到期,唤醒睡眠的任务.
+static void sleep_expired(unsigned long data)
+{
+	struct task_struct * p = (struct task_struct *) data;
+
+	if (p->state == TASK_INTERRUPTIBLE)
+		wake_up_process(p);
+}
+
+// 系统调用功能 - 高精度睡眠.
+// 睡眠rqtp指定的时间,精度约为1个8253计数周期再加上中断延迟,而不是一个滴答.被信号中断时返回-EINTR,并在rmtp不为空时在其中返回剩余的
+// 时间.睡眠使用任务自己的高精度定时器sleep_timer.
+int sys_nanosleep(struct timespec * rqtp, struct timespec * rmtp)
+{
+	struct hrtimer * timer = &current->sleep_timer;
+	unsigned long sec, nsec, usec;
+
+	sec = get_fs_long((unsigned long *) &rqtp->tv_sec);
+	nsec = get_fs_long((unsigned long *) &rqtp->tv_nsec);
+	if ((long) sec < 0 || nsec >= 1000000000)
+		return -EINVAL;
+	timer->fn = sleep_expired;
+	timer->data = (unsigned long) current;
+	// 定时器在中断中到期时会把任务置为就绪状态,因此要在关中断的情况下检查定时器是否还在链表中,再进入睡眠.
+	cli();
+	set_hrtimer(timer, sec, (nsec + 999) / 1000);
+	while (timer->pprev && !(current->signal & ~(_BLOCKABLE & current->blocked))) {
+		current->state = TASK_INTERRUPTIBLE;
+		schedule();
+	}
+	sti();
+	if (!timer->pprev)
+		return 0;
+	hrtimer_left(timer, &sec, &usec);
+	del_hrtimer(timer);
+	if (rmtp) {
+		verify_area(rmtp, sizeof(*rmtp));
+		put_fs_long(sec, (unsigned long *) &rmtp->tv_sec);
+		put_fs_long(usec * 1000, (unsigned long *) &rmtp->tv_nsec);
+	}
+	return -EINTR;
 }
 
 // 系统调用功能 - 设置报警定时时间值（秒）。
@@ -524,6 +1018,13 @@ int sys_alarm(long seconds)
 	if (old)
 		old = (old - jiffies) / HZ;
 	current->alarm = (seconds>0)?(jiffies+HZ*seconds):0;
+	// 报警定时器到期时由alarm_expired()发送SIGALRM信号.
+	if (current->alarm) {
+		current->alarm_timer.fn = alarm_expired;
+		current->alarm_timer.data = (unsigned long) current;
+		set_timer(&current->alarm_timer, HZ * seconds);
+	} else
+		del_timer(&current->alarm_timer);
 	return (old);
 }
 
@@ -572,6 +1073,56 @@ int sys_nice(long increment)
 	return 0;
 }
 
+/*
+ * SYSENTER/SYSEXIT fast system calls. Both instructions load flat
+ * segments from fixed GDT slots, while user code runs in its LDT
+ * segments based at TASK_BASE. The kernel just runs on the flat alias
+ * of its own segments, and on the way back the user-side stub in
+ * <unistd.h> far-jumps to 0x0f and reloads 0x17 into %ss before it
+ * touches the stack. The user flat code segment is execute-only and
+ * the data segment is expand-down with the largest limit, so it covers
+ * no address at all (a limit of 0 would still allow offset 0), and
+ * loading them by hand gains nothing.
+ */
+/*
+ * SYSENTER/SYSEXIT快速系统调用.这两条指令都从全局描述符表的固定位置装入平坦段,而用户代码运行在基址为TASK_BASE的局部描述符表段中.
+ * 内核就在自己段的平坦别名中运行,返回时由<unistd.h>中的用户端代码在使用堆栈之前长跳转到0x0f并把0x17装入%ss.用户平坦代码段只能
+ * 执行,数据段是界限最大的向下扩展段,不包含任何地址(界限为0的普通段仍允许访问偏移0),因此用户自己装入它们也得不到什么.
+ */
+// 刚执行SYSENTER时(调试陷阱,NMI)使用的临时堆栈.入口代码的第1条指令就换到当前任务的内核态堆栈.
+static long sysenter_stack[64];
+
+#define wrmsr(msr, val) \
+__asm__ __volatile__("wrmsr"::"c" (msr), "a" (val), "d" (0))
+
+// 检测CPU是否支持SYSENTER并设置相应的段描述符和模型专用寄存器.
+// cpuid(1)返回的特性标志位11是SEP.最早的Pentium Pro(型号小于3且步进小于3)报告了该位但并不支持这两条指令.
+static void sysenter_init(void)
+{
+	unsigned long flags, old_flags, sig = 0, features = 0, max;
+	struct desc_struct * p = gdt + GDT_SYSENTER;
+
+	__asm__("pushfl ; popl %0 ; movl %0, %1 ; xorl $0x200000, %0\n\t"
+		"pushl %0 ; popfl ; pushfl ; popl %0 ; pushl %1 ; popfl"
+		:"=&r" (flags), "=&r" (old_flags));
+	if (!((flags ^ old_flags) & 0x200000))
+		return;
+	__asm__("cpuid":"=a" (max):"0" (0):"bx","cx","dx");
+	if (max >= 1)
+		__asm__("cpuid":"=a" (sig), "=d" (features):"0" (1):"bx","cx");
+	if (!(features & 0x800))
+		return;
+	if (((sig >> 8) & 15) == 6 && ((sig >> 4) & 15) < 3 && (sig & 15) < 3)
+		return;
+	p[0].a = 0x0000ffff; p[0].b = 0x00cf9a00;	// 内核代码段,4GB.
+	p[1].a = 0x0000ffff; p[1].b = 0x00cf9200;	// 内核数据段,4GB.
+	p[2].a = 0x0000ffff; p[2].b = 0x00cff800;	// 用户代码段,4GB,只能执行.
+	p[3].a = 0x0000ffff; p[3].b = 0x00cff600;	// 用户数据段,向下扩展,界限4GB,不含任何地址.
+	wrmsr(0x174, GDT_SYSENTER << 3);						// SYSENTER_CS
+	wrmsr(0x175, (unsigned long) (sysenter_stack + 64));	// SYSENTER_ESP
+	wrmsr(0x176, (unsigned long) sysenter_entry);			// SYSENTER_EIP
+}
+
 // 内核调度程序的初始化子程序
 void sched_init(void)
 {
@@ -607,9 +1158,11 @@ void sched_init(void)
 	// 只明确加这一次,以后新任务LDT的加载,是CPU根据TSS中的LDT项自动加载.
 	ltr(0);								// 定义在include/linux/sched.h
 	lldt(0);							// 其中参数(0)是任务号.
-	// 下面代码用于初始化8253定时器.通道0,选择工作方式3,二进制计数方式.通道0的输出引脚接在中断控制主芯片的IRQ0上,它每10毫秒发出一个IRQ0请求.
-	// LATCH是初始定时计数值.
-	outb_p(0x36, 0x43);					/* binary, mode 3, LSB/MSB, ch 0 */
+	// 建立定时器对象缓存,预留TIME_REQUESTS个定时器,使得在中断中添加定时器时通常不用申请页面.
+	timer_cachep = kmem_cache_create("timer", sizeof(struct timer_request), TIME_REQUESTS);
+	// 下面代码用于初始化8253定时器.通道0,选择工作方式0,二进制计数方式.通道0的输出引脚接在中断控制主芯片的IRQ0上,计数到0时发出一个IRQ0请求,
+	// 此后每次中断都由do_timer_interrupt()重新设置计数值.LATCH是初始定时计数值,即第一次中断在10毫秒之后.
+	outb_p(0x30, 0x43);					/* binary, mode 0, LSB/MSB, ch 0 */
 	outb_p(LATCH & 0xff, 0x40);			/* LSB */	// 定时值低字节
 	outb(LATCH >> 8, 0x40);				/* MSB */	// 定时值高字节
 	// 设置时钟中断处理程序句柄(设置时钟中断门).修改中断控制器屏蔽码,允许时钟中断.
@@ -617,4 +1170,5 @@ void sched_init(void)
 	set_intr_gate(0x20, &timer_interrupt);
 	outb(inb_p(0x21) & ~0x01, 0x21);
 	set_system_gate(0x80, &system_call);
+	sysenter_init();
 }
@@ -122,6 +122,28 @@ static inline void get_new(char * from, char * to)
 		*(to++) = get_fs_byte(from++);
 }
 
+// 把当前进程信号signum的sigaction结构复制给共享信号处理句柄的其他线程（clone(CLONE_SIGHAND)）。
+// 任务结构开始部分的sigaction[]数组被sys_call.s中的汇编代码按固定偏移访问，不能换成指向共享结构的指针，因此共享的线程
+// 各有一份，修改时在共享环中逐个更新。
+static void share_sigaction(int signum)
+{
+	struct task_struct * p;
+
+	for (p = current->sig_next ; p != current ; p = p->sig_next)
+		p->sigaction[signum - 1] = current->sigaction[signum - 1];
+}
+
+// 当前进程退出信号处理句柄共享环。在进程退出和执行execve()（句柄要被复位）时调用。
+void exit_sighand(void)
+{
+	struct task_struct * p;
+
+	for (p = current ; p->sig_next != current ; p = p->sig_next)
+		;
+	p->sig_next = current->sig_next;
+	current->sig_next = current;
+}
+
 // signal()系统调用。类似于sigaction()。为指定的信号安装新的信号句柄（信号处理程序）。
 // 信号句柄可以是用户指定的函数，也可以是SIG_DFL（默认句柄）或SIG_IGN（忽略）。
 // 参数signum -- 指定的信号； handler -- 指定的句柄； restorer -- 恢复函数指针，该函数由Libc库提供。用于在信号
@@ -144,6 +166,7 @@ int sys_signal(int signum, long handler, long restorer)
 	// 接着取该信号原来的处理句柄，并设置该信号的sigaction结构。最后返回原信号句柄。
 	handler = (long) current->sigaction[signum - 1].sa_handler;
 	current->sigaction[signum - 1] = tmp;
+	share_sigaction(signum);
 	return handler;
 }
 
@@ -168,6 +191,7 @@ int sys_sigaction(int signum, const struct sigaction * action,
 		current->sigaction[signum - 1].sa_mask = 0;
 	else
 		current->sigaction[signum - 1].sa_mask |= (1 << (signum - 1));
+	share_sigaction(signum);
 	return 0;
 }
 
@@ -257,8 +281,10 @@ int do_signal(long signr, long eax, long ebx, long ecx, long edx, long orig_eax,
 			current->state = TASK_STOPPED;
 			current->exit_code = signr;
 			if (!(current->p_pptr->sigaction[SIGCHLD - 1].sa_flags &
-					SA_NOCLDSTOP))
+					SA_NOCLDSTOP)) {
 				current->p_pptr->signal |= (1 << (SIGCHLD - 1));
+				signal_wake_up(current->p_pptr);
+			}
 			return(1);  							/* Reschedule another event */
 
 		// 如果信号是以下6种信号之一，那么若信号产生了core_dump，则以退出码为signr|0x80调用do_exit()退出。否则退出码就是信号
@@ -288,8 +314,10 @@ int do_signal(long signr, long eax, long ebx, long ecx, long edx, long orig_eax,
 	// 的代码指针eip为指向信号处理句柄，同时也将sa_restorer、signr、进程屏蔽码（如果SA_NOMASK没置位）、eax、
 	// ecx、edx作为参数以及原调用系统调用的程序返回指针及标志寄存器值压入用户堆栈。因此在本次系统调用中断返回用户
 	// 程序时会首先执行用户信号句柄程序，然后继续执行用户程序。
-	if (sa->sa_flags & SA_ONESHOT)
+	if (sa->sa_flags & SA_ONESHOT) {
 		sa->sa_handler = NULL;
+		share_sigaction(signr);
+	}
 	// 将内核态栈上用户调用系统调用 下一条代码指针eip指向该信号处理句柄。由于C函数是传值函数，因此给eip赋值时需要
 	// 使用“*(&eip)”的形式。另外，如果允许信号自己的处理句柄收到信号自己，则也需要将进程的阻塞码压入堆栈。
 	// 这里请注意，使用如下方式（第193行）对普通C函数参数进行修改是不起作用的。因为当函数返回时堆栈上的参数将会被
@@ -291,11 +291,12 @@ int sys_times(struct tms * tbuf)
 // 同，则表明有错误发生)。该函数并不被用户直接调用，而由libc库函数进行包装，并且返回值也不一样。
 int sys_brk(unsigned long end_data_seg)
 {
-	// 如果参数值大于代码结尾，并且小于（堆栈 - 16KB），则设置新数据段结尾值。
+	// 如果参数值大于代码结尾，并且小于（堆栈 - 16KB），则设置新数据段结尾值。数据段也不能伸进mmap()映射区。
 	if (end_data_seg >= current->end_code &&
-	    end_data_seg < current->start_stack - 16384)
-		current->brk = end_data_seg;
-	return current->brk;            			// 返回进程当前的数据段结尾值。
+	    end_data_seg < current->start_stack - 16384 &&
+	    end_data_seg <= MMAP_BASE)
+		current->mm->brk = end_data_seg;
+	return current->mm->brk;          			// 返回进程当前的数据段结尾值。
 }
 
 /*
@@ -567,6 +568,7 @@ int sys_getrusage(int who, struct rusage *ru)
 		r.ru_utime.tv_usec = CT_TO_USECS(current->utime);
 		r.ru_stime.tv_sec = CT_TO_SECS(current->stime);
 		r.ru_stime.tv_usec = CT_TO_USECS(current->stime);
+		r.ru_maxrss = current->mm->max_rss * (PAGE_SIZE / 1024);	// 驻留内存最大值(KB).
 	} else {
 		r.ru_utime.tv_sec = CT_TO_SECS(current->cutime);
 		r.ru_utime.tv_usec = CT_TO_USECS(current->cutime);
@@ -693,9 +695,9 @@ void adjust_clock()
 // 设置当前进程创建文件属性屏蔽码为mask & 0777。并返回原屏蔽码。
 int sys_umask(int mask)
 {
-	int old = current->umask;
+	int old = current->fs->umask;
 
-	current->umask = mask & 0777;
+	current->fs->umask = mask & 0777;
 	return (old);
 }
 
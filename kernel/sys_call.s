@@ -75,6 +75,8 @@ sa_restorer = 12					# 恢复函数指针,参见kernel/signal.c程序说明.
 
 nr_system_calls = 82				# Linux 0.12版内核中的系统调用总数.
 
+TASK_BASE = 0x40000000				# 任务线性地址空间的开始位置,见include/linux/sched.h.
+
 ENOSYS = 38							# 系统调用号出错码.
 
 /*
@@ -84,7 +86,7 @@ ENOSYS = 38							# 系统调用号出错码.
 /*
  * 好了,在使用软驱时我收到了并行打印机中断,很奇怪.呵,现在不管它.
  */
-.globl system_call,sys_fork,timer_interrupt,sys_execve
+.globl system_call,sysenter_entry,sys_fork,sys_vfork,sys_clone,timer_interrupt,sys_execve
 .globl hd_interrupt,floppy_interrupt,parallel_interrupt
 .globl device_not_available, coprocessor_error, sys_default
 
@@ -135,6 +137,7 @@ sys_call:
 	call *%ebx
 	# call *sys_call_table(, %eax, 4)	# 间接调用指定功能C函数.
 	pushl %eax							# 把系统调用返回值入栈.
+ret_from_call:
 
 # 下面行查看当前任务的运行状态.如果不在就绪状态(state不等于0)就去执行调试程序.如果该任务在就绪状态,但是其时间片已经用
 # 完(counter=0),则也去执行调度程序.
@@ -192,6 +195,96 @@ ret_from_sys_call:
 	pop %ds
 	iret 							# 系统调用结束
 
+/*
+ * SYSENTER entry. The user stub in <unistd.h> pushes %ebp and its return
+ * address and leaves %esp in %ebp, since sysenter saves nothing. We build
+ * the same frame as int 0x80 on the task's kernel stack, with the return
+ * address kept once more above it: if it is still in the frame when the
+ * call is done and there is nothing to schedule or deliver, we go back
+ * with sysexit, otherwise through the normal iret path.
+ */
+# SYSENTER快速系统调用入口.
+# sysenter不保存任何返回信息,因此用户端代码(include/unistd.h)先把%ebp和返回地址压入用户栈,并把%esp放在%ebp中.这里在当前任务的内核态
+# 堆栈上构造与int 0x80完全相同的堆栈帧,并在其上方再保存一次返回地址.系统调用结束时,若帧中返回地址没有被改变(execve()或信号处理会改变它),
+# 并且不需要调度或处理信号,就用sysexit返回,否则仍从ret_from_call处经iret返回.
+.align 4
+sysenter_entry:
+	movl %ss:current, %esp			# 换到当前任务的内核态堆栈(即tss.esp0).
+	addl $4096, %esp
+	pushl $0						# 返回地址,下面填入.
+	pushl $0x17						# oldss
+	pushl %ebp						# oldesp,下面再跳过用户端压入的8字节.
+	pushfl
+	orl $0x200, (%esp)				# sysenter复位了IF.
+	pushl $2						# sysenter只复位IF和VM,用户的NT,TF,AC和DF等标志仍然有效.
+	popfl							# 保存之后在内核中使用干净的标志,与int 0x80的中断门一样.
+	pushl $0x0f						# cs
+	pushl $0						# eip,下面填入.
+	push %ds
+	push %es
+	push %fs
+	pushl %eax						# orig_eax
+	pushl %edx
+	pushl %ecx
+	pushl %ebx
+	movl $0x10, %edx
+	mov %dx, %ds
+	mov %dx, %es
+	movl $0x17, %edx
+	mov %dx, %fs
+	sti
+	# 从用户栈中取出返回地址和原%ebp值,%ebp+8不能超出用户数据段限长.sysexit和iret都不恢复%ebp,这里直接把原值放回%ebp.
+	# 注意此时系统调用返回值还没有入栈,帧中各项的偏移比EIP等常数小4.
+	lsll %edx, %ecx
+	subl $7, %ecx
+	cmpl %ecx, %ebp
+	ja bad_sysenter
+	movl %fs:(%ebp), %ecx
+	movl %ecx, EIP-4(%esp)
+	movl %ecx, OLDSS(%esp)
+	addl $8, OLDESP-4(%esp)
+	movl %fs:4(%ebp), %ebp
+	cmpl NR_syscalls, %eax
+	jae bad_sys_call
+	movl sys_call_table(, %eax, 4), %ebx
+	testl %ebx, %ebx
+	jne 1f
+	call sys_default
+1:	call *%ebx
+	pushl %eax
+	# 任务0的段基址不是TASK_BASE,总是经iret返回.
+	movl current, %eax
+	cmpl task, %eax
+	je ret_from_call
+	cmpl $0, state(%eax)
+	jne ret_from_call
+	cmpl $0, counter(%eax)
+	je ret_from_call
+	movl blocked(%eax), %ecx
+	notl %ecx
+	testl signal(%eax), %ecx
+	jne ret_from_call
+	movl EIP(%esp), %edx
+	cmpl %edx, OLDSS+4(%esp)
+	jne ret_from_call
+	# sysexit从%edx和%ecx取得返回地址和堆栈指针.返回后使用平坦段,因此%edx是线性地址;%esp在用户端重新装入%ss之后才使用,保持原值.
+	cli
+	addl $TASK_BASE, %edx
+	movl OLDESP(%esp), %ecx
+	popl %eax
+	popl %ebx
+	addl $12, %esp					# skip ecx, edx and orig_eax
+	pop %fs
+	pop %es
+	pop %ds
+	sti								# sti之后的一条指令执行完才允许中断.
+	sysexit
+
+# 用户栈指针无效,无法返回用户程序.
+bad_sysenter:
+	pushl $11						# SIGSEGV
+	call do_exit
+
 #### int16 -- 处理器错误中断. 类型: 错误;无错误码.
 # 这是一个外部的基于硬件的异常.当协处理器检测到自己发生错误时,就会通过ERROR引脚通知CPU.下面代码用于处理协处理器发出的出错信号.并跳转去执行C函数
 # math_error()(kernel/math/error.c).返回后将跳转到标号ret_from_sys_call处继续执行.
@@ -252,9 +345,9 @@ device_not_available:
 	popl %ebp
 	ret								# 这里的ret将跳转到ret_from_sys_call.
 
-#### int32 -- (int 0x20)时钟中断处理程序.中断频率设置为100Hz(include/linux/sched.h),定时芯片8253/8254是
-# 在(kernel/sched.c)处初始化的.因此这里jiffies每10毫秒加1.这段代码将jiffies增1,发送结束中断指令给8259控制器,
-# 然后用当前特权级作为参数调用C函数do_timer(long CPL).当调用返回时转去检测并处理信号.
+#### int32 -- (int 0x20)时钟中断处理程序.定时芯片8253/8254是在(kernel/sched.c)处初始化的,工作在单次计数方式,
+# 每个滴答(10毫秒)以及每个高精度定时器到期时各中断一次.这段代码发送结束中断指令给8259控制器,然后用当前特权级作为参数
+# 调用C函数do_timer_interrupt(long CPL),由它决定jiffies是否加1.当调用返回时转去检测并处理信号.
 .align 4
 timer_interrupt:
 	push %ds						# save ds,es and put kernel data space
@@ -272,17 +365,16 @@ timer_interrupt:
 	mov %ax, %es
 	movl $0x17, %eax				# fs置为指向局部数据 (程序的数据段).
 	mov %ax, %fs
-	incl jiffies
 	# 由于初始化中断控制芯片时没有采用自己动EOI,所以这里需要发指令结束该硬件中断.
 	movb $0x20, %al					# EOI to interrupt controller #1
 	outb %al, $0x20
-	# 下面从堆栈中取出执行系统调用代码的选择符(CS段寄存器值)中的当前特权级别(0或3)并压入堆栈,作为do_timer的参数.do_timer()函数执行
-	# 任务切换,计时等工作,在kernel/sched.c实现.
+	# 下面从堆栈中取出执行系统调用代码的选择符(CS段寄存器值)中的当前特权级别(0或3)并压入堆栈,作为do_timer_interrupt的参数.
+	# do_timer_interrupt()更新jiffies,处理到期的定时器,重新设置8253并执行任务切换,计时等工作,在kernel/sched.c实现.
 	movl CS(%esp), %eax
 	andl $3, %eax					# %eax is CPL (0 or 3, 0=supervisor)
 	pushl %eax
-	call do_timer					# 'do_timer(long CPL)' does everything from
-	addl $4, %esp					# task switching to accounting ...
+	call do_timer_interrupt			# 'do_timer_interrupt(long CPL)' does everything
+	addl $4, %esp					# from task switching to accounting ...
 	jmp ret_from_sys_call
 
 #### 这是sys_execve()系统调用.取中断调用程序的代码指针作为参数调用C函数do_execve().
@@ -297,8 +389,11 @@ sys_execve:
 
 #### sys_fork()调用,用于创建子进程,是system_call功能2.原型在include/linux/sys.h中.
 # 首先调用C函数find_empty_process(),取得一个进程号last_pid.若返回负数则说明目前任务数组已满.然后调用copy_process()复制进程.
+# sys_vfork()和sys_clone()也使用这段代码,copy_process()根据栈中的orig_eax(系统调用号)区分它们.
 .align 4
 sys_fork:
+sys_vfork:
+sys_clone:
 	call find_empty_process			# 为新进程取得进程号last_pid(kernel/fork.c)
 	testl %eax, %eax				# 在eax中返回进程号.若返回负数则退出.
 	js 1f
@@ -172,6 +172,7 @@ void *malloc(unsigned int len)
 	struct _bucket_dir	*bdir;
 	struct bucket_desc	*bdesc;
 	void				*retval;
+	unsigned long		flags;
 
 	/*
 	 * First we search the bucket_dir to find the right bucket change
@@ -197,6 +198,8 @@ void *malloc(unsigned int len)
     /*
      * 现在我们来搜索具有空闲空间的桶描述符。
      */
+	// 保存原来的中断状态再关中断,这样在已经关中断的地方调用malloc()时,返回前不会错误地开中断.
+	save_flags(flags);
 	cli();								/* Avoid race conditions */     /* 为了避免出现竞争条件，首先关中断 */
 	// 搜索对应桶目录项中描述符链表，查找具有空闲空间的桶描述符。如果桶描述符的空闲内存指针freeptr不为空，则表示找到了相应的
 	// 桶描述符。
@@ -249,7 +252,7 @@ void *malloc(unsigned int len)
 	bdesc->freeptr = *((void **) retval);
 	bdesc->refcnt++;
 	// 最后开放中断，并返回指向空闲内在对象的指针。
-	sti();										/* OK, we're safe again */      /* OK，现在我们又安全了 */
+	restore_flags(flags);						/* OK, we're safe again */      /* OK，现在我们又安全了 */
 	return(retval);
 }
 
@@ -272,6 +275,7 @@ void free_s(void *obj, int size)
 	void				*page;
 	struct _bucket_dir	*bdir;
 	struct bucket_desc	*bdesc, *prev;
+	unsigned long		flags;
 
 	/* Calculate what page this object lives in */
     /* 计算该对象所在页面 */
@@ -296,6 +300,7 @@ void free_s(void *obj, int size)
 	panic("Bad address passed to kernel free_s()");
 found:
 	// 找到对应的桶描述符后，首先关中断。然后将该对象内存块链入空闲块对象链表中，并使该描述符的对象引用计数减1。
+	save_flags(flags);
 	cli(); 								/* To avoid race conditions */   /* 为了避免竞争条件 */
 	*((void **)obj) = bdesc->freeptr;
 	bdesc->freeptr = obj;
@@ -327,7 +332,7 @@ found:
 		bdesc->next = free_bucket_desc;
 		free_bucket_desc = bdesc;
 	}
-	// 开中断，返回。
-	sti();
+	// 恢复原来的中断状态，返回。
+	restore_flags(flags);
 	return;
 }
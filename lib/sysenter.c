@@ -0,0 +1,34 @@
+/*
+ *  linux/lib/sysenter.c
+ *
+ *  (C) 1991  Linus Torvalds
+ */
+
+#define __LIBRARY__
+#include <unistd.h>
+
+// 是否使用sysenter进入系统调用.-1表示还没有检测过.
+int __sysenter_ok = -1;
+
+// 检测CPU是否支持sysenter指令,检测方法与内核中的相同(kernel/sched.c).
+// 能改变标志寄存器中的ID位(位21)则CPU支持cpuid指令,cpuid(1)返回的特性标志位11是SEP.最早的Pentium Pro(型号小于3且步进小于3)报告了
+// 该位但并不支持这条指令.
+int __sysenter_check(void)
+{
+	unsigned long flags, old_flags, sig = 0, features = 0, max;
+
+	__sysenter_ok = 0;
+	__asm__("pushfl ; popl %0 ; movl %0, %1 ; xorl $0x200000, %0\n\t"
+		"pushl %0 ; popfl ; pushfl ; popl %0 ; pushl %1 ; popfl"
+		:"=&r" (flags), "=&r" (old_flags));
+	if (!((flags ^ old_flags) & 0x200000))
+		return 0;
+	__asm__("cpuid":"=a" (max):"0" (0):"bx","cx","dx");
+	if (max >= 1)
+		__asm__("cpuid":"=a" (sig), "=d" (features):"0" (1):"bx","cx");
+	if (!(features & 0x800))
+		return 0;
+	if (((sig >> 8) & 15) == 6 && ((sig >> 4) & 15) < 3 && (sig & 15) < 3)
+		return 0;
+	return __sysenter_ok = 1;
+}
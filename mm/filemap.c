@@ -0,0 +1,182 @@
+/*
+ *  linux/mm/filemap.c
+ *
+ *  (C) 1991  Linus Torvalds
+ */
+
+/*
+ * A small page cache for the text of executables and libraries. Clean
+ * pages read in by do_no_page() are remembered by (device, inode, block)
+ * and stay around after the last task using them has exited, so that
+ * running the same program again doesn't have to read and copy every
+ * page again. The cache holds a reference of its own on each page, so
+ * mapped pages are always write-protected and shared copy-on-write.
+ *
+ * Pages of files mapped with mmap() go through the same cache. Shared
+ * mappings rely on it: all tasks mapping a block map the cached page
+ * itself, so such pages stay in the cache as long as they are mapped.
+ *
+ * Each entry points at its in-core inode, which counts its cached pages
+ * in i_cached, so write() on an uncached file doesn't scan the cache.
+ * An in-core inode is only reused after its pages have been dropped.
+ */
+/*
+ * 执行文件和库文件代码页面的页面缓存.do_no_page()读入的干净页面按(设备号,i节点号,逻辑块号)记录下来,在最后一个使用它们的任务
+ * 退出后仍然保留,这样再次运行同一程序时就不必重新读入和复制每一个页面.缓存对每个页面自己持有一个引用,因此被映射的页面总是写保护的,
+ * 以写时复制的方式共享.
+ *
+ * mmap()映射的文件页面也经过这个缓存.共享映射依赖于它:映射同一块的所有任务都直接映射缓存中的页面,因此这样的页面在被映射期间一直留在缓存中.
+ *
+ * 每个缓存项都指向文件的内存i节点,i节点的i_cached记录它在缓存中的页面数,因此写没有缓存页面的文件时不必扫描缓存.内存i节点只有在其页面
+ * 被丢弃后才会被重用.
+ */
+
+#include <linux/sched.h>
+#include <linux/mm.h>
+#include <linux/kernel.h>
+
+// 页面缓存项数和散列表项数.
+#define NR_PAGE_CACHE 1024
+#define PAGE_CACHE_HASH 64
+#define page_hashfn(dev, ino, block) ((((dev) ^ (ino)) ^ ((block) >> 2)) % PAGE_CACHE_HASH)
+
+// 页面缓存项.page为0表示该项空闲.
+struct page_cache_entry {
+	unsigned long page;						// 物理页面地址.
+	unsigned short dev;						// 文件所在设备号.
+	unsigned short ino;						// 文件i节点号.
+	int block;								// 页面第1块在文件中的逻辑块号.
+	struct m_inode * inode;					// 文件的内存i节点.
+	struct page_cache_entry * next;			// 散列链表中下一项.
+};
+
+static struct page_cache_entry page_cache[NR_PAGE_CACHE];
+static struct page_cache_entry * page_hash[PAGE_CACHE_HASH];
+static int page_cache_hand = 0;				// 淘汰缓存项时的扫描位置(时钟指针).
+
+// 统计信息.
+static int page_cache_pages = 0;			// 缓存中的页面数.
+static unsigned long page_cache_hits = 0;	// 命中次数.
+static unsigned long page_cache_misses = 0;	// 未命中次数.
+
+// 把缓存项p从散列表中删除,并释放缓存对页面的引用.
+static void remove_page_cache(struct page_cache_entry * p)
+{
+	struct page_cache_entry ** q;
+
+	for (q = page_hash + page_hashfn(p->dev, p->ino, p->block); *q; q = &(*q)->next)
+		if (*q == p) {
+			*q = p->next;
+			break;
+		}
+	free_page(p->page);
+	p->page = 0;
+	p->inode->i_cached--;
+	page_cache_pages--;
+}
+
+// 在页面缓存中查找文件inode中从逻辑块block开始的页面.
+// 若找到则递增页面引用计数并返回页面物理地址,否则返回0.调用者负责以只读方式映射该页面.
+unsigned long find_page_cache(struct m_inode * inode, int block)
+{
+	struct page_cache_entry * p;
+
+	for (p = page_hash[page_hashfn(inode->i_dev, inode->i_num, block)]; p; p = p->next)
+		if (p->dev == inode->i_dev && p->ino == inode->i_num && p->block == block) {
+			mem_map[MAP_NR(p->page)]++;
+			page_cache_hits++;
+			return p->page;
+		}
+	page_cache_misses++;
+	return 0;
+}
+
+// 把刚从文件inode的逻辑块block开始读入的干净页面page加入页面缓存.
+// 缓存对页面持有一个引用.若缓存已满,则淘汰一个只被缓存引用的页面;若所有页面都在被使用,则不缓存.已在缓存中的页面不重复加入.
+// 页面被加入缓存时返回1,否则返回0.
+int add_page_cache(unsigned long page, struct m_inode * inode, int block)
+{
+	struct page_cache_entry * p;
+	int i;
+
+	if (page < LOW_MEM || page >= HIGH_MEMORY)
+		return 0;
+	for (p = page_hash[page_hashfn(inode->i_dev, inode->i_num, block)]; p; p = p->next)
+		if (p->dev == inode->i_dev && p->ino == inode->i_num && p->block == block)
+			return 0;
+	for (i = 0; i < NR_PAGE_CACHE; i++) {
+		p = page_cache + page_cache_hand;
+		if (++page_cache_hand >= NR_PAGE_CACHE)
+			page_cache_hand = 0;
+		if (!p->page)
+			break;
+		if (mem_map[MAP_NR(p->page)] == 1) {
+			remove_page_cache(p);
+			break;
+		}
+	}
+	if (i >= NR_PAGE_CACHE)
+		return 0;
+	p->page = page;
+	p->dev = inode->i_dev;
+	p->ino = inode->i_num;
+	p->block = block;
+	p->inode = inode;
+	inode->i_cached++;
+	p->next = page_hash[page_hashfn(p->dev, p->ino, block)];
+	page_hash[page_hashfn(p->dev, p->ino, block)] = p;
+	mem_map[MAP_NR(page)]++;
+	page_cache_pages++;
+	return 1;
+}
+
+// 文件inode的内容被修改或被截断时,删除其所有缓存页面.
+// 仍被进程映射的页面不受影响,只是不再留在缓存中.在file_write(),truncate()和重用内存i节点时被调用.该文件没有缓存页面时直接返回.
+// 按i节点指针比较,因为设备被更换后i节点的设备号可能已被清零.
+void invalidate_inode_pages(struct m_inode * inode)
+{
+	struct page_cache_entry * p;
+
+	if (!inode->i_cached)
+		return;
+	for (p = page_cache; p < page_cache + NR_PAGE_CACHE; p++)
+		if (p->page && p->inode == inode)
+			remove_page_cache(p);
+}
+
+// 删除设备dev上所有文件的缓存页面.在更换软盘时被调用.
+void invalidate_dev_pages(int dev)
+{
+	struct page_cache_entry * p;
+
+	for (p = page_cache; p < page_cache + NR_PAGE_CACHE; p++)
+		if (p->page && p->dev == dev)
+			remove_page_cache(p);
+}
+
+// 内存不够时释放缓存页面.
+// 从时钟指针处开始寻找一个只被缓存引用的页面并释放之.成功返回1,否则返回0.在get_free_page()中先于swap_out()被调用,因为丢弃
+// 干净的缓存页面比交换出页面代价小得多.
+int shrink_page_cache(void)
+{
+	struct page_cache_entry * p;
+	int i;
+
+	for (i = 0; i < NR_PAGE_CACHE; i++) {
+		p = page_cache + page_cache_hand;
+		if (++page_cache_hand >= NR_PAGE_CACHE)
+			page_cache_hand = 0;
+		if (p->page && mem_map[MAP_NR(p->page)] == 1) {
+			remove_page_cache(p);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+// 显示页面缓存统计信息.在show_mem()中被调用.
+void page_cache_show(void)
+{
+	printk("Page cache: %d pages, %d hits, %d misses\n\r",
+		page_cache_pages, page_cache_hits, page_cache_misses);
+}
@@ -0,0 +1,245 @@
+/*
+ *  linux/mm/ksm.c
+ *
+ *  (C) 1991  Linus Torvalds
+ */
+
+/*
+ * Same-page merging. While the system is idle, task 0 walks the page
+ * tables of all tasks and checksums their private pages. Pages with the
+ * same contents are merged into one read-only page through the usual
+ * mem_map[] reference count, so a later write just goes through
+ * un_wp_page() like any other copy-on-write page. Pages that are all
+ * zeroes are replaced by the shared zero page.
+ *
+ * Candidates are remembered by (task, address) only, and re-checked
+ * through the page tables before they are used, so nothing is held on
+ * a page until it has actually been merged. Merged pages keep one extra
+ * reference from the table here, which is dropped again once only one
+ * mapping is left.
+ *
+ * Merging is only done when the CPU honours write protection in kernel
+ * mode (486+): on a 386 a page verified by verify_area() could be made
+ * shared while its task sleeps, and the kernel would then write into it.
+ */
+/*
+ * 相同页面合并.系统空闲时,任务0扫描所有任务的页表并计算其私有页面的校验和.内容相同的页面通过通常的mem_map[]引用计数合并成一个
+ * 只读页面,以后对它的写操作就和其他写时复制页面一样由un_wp_page()处理.内容全为零的页面被换成共享的全零页面.
+ *
+ * 候选页面只按(任务号,线性地址)记录,使用之前要通过页表重新检查,因此在页面真正被合并之前不对它持有任何引用.已合并的页面在这里的
+ * 表中多持有一个引用,当只剩下一个映射时再释放该引用.
+ */
+
+#include <string.h>
+
+#include <linux/sched.h>
+#include <linux/mm.h>
+#include <linux/kernel.h>
+
+#define FIRST_VM_DIR (TASK_BASE >> 22)		// 用户空间的第一个页目录项.
+
+// 已合并页面表和候选页面表的项数.两个表都按校验和直接映射,冲突时新项覆盖旧项.
+#define NR_KSM_PAGES		256
+#define NR_KSM_CANDIDATES	512
+
+// 每次空闲时最多计算校验和的页面数,以及扫描完所有任务一遍之后等待的滴答数.
+#define KSM_SCAN_BATCH		32
+#define KSM_PASS_DELAY		(5 * HZ)
+
+// 已合并页面表项.page为0表示该项空闲.
+struct ksm_page {
+	unsigned long csum;						// 页面内容校验和.
+	unsigned long page;						// 物理页面地址.
+};
+
+// 候选页面表项.task为0表示该项空闲.
+struct ksm_candidate {
+	unsigned long csum;						// 扫描时页面内容的校验和.
+	int task;								// 任务号.
+	unsigned long address;					// 页面线性地址.
+};
+
+static struct ksm_page ksm_pages[NR_KSM_PAGES];
+static struct ksm_candidate ksm_candidates[NR_KSM_CANDIDATES];
+static int ksm_hand = 0;					// 检查已合并页面是否还被共享的扫描位置.
+
+// 统计信息.
+static unsigned long ksm_scanned = 0;		// 计算过校验和的页面数.
+static unsigned long ksm_merged = 0;		// 合并到已合并页面中的页面数.
+static unsigned long ksm_zero = 0;			// 换成全零页面的页面数.
+
+// 是否有其他任务可以运行.若有,空闲扫描应该立即停止.扫描在任务0中进行,因此就绪队列不空就说明有其他任务可以运行.
+static int other_runnable(void)
+{
+	return nr_running > 0;
+}
+
+// 计算页面page的校验和,并通过*zero返回页面内容是否全为零.
+static unsigned long page_csum(unsigned long page, int * zero)
+{
+	unsigned long * p = (unsigned long *) page;
+	unsigned long csum = 0, all = 0;
+	int i;
+
+	for (i = 0 ; i < 1024 ; i++, p++) {
+		csum = ((csum << 5) | (csum >> 27)) + *p;
+		all |= *p;
+	}
+	*zero = !all;
+	return csum;
+}
+
+// 取任务nr中线性地址address的页表项指针.
+// 只有页表是任务私有的(目录项可写),并且页面存在,没有被锁定,只被该页表项引用时才返回,否则返回NULL.合并后写入时会发生写时复制,
+// 这正是锁定页面要避免的.
+static unsigned long * private_pte(int nr, unsigned long address)
+{
+	struct task_struct * p = task[nr];
+	unsigned long * dir, * pte, page;
+
+	if (!p || !mm_owner(p) || (p->flags & PF_MLOCKALL))
+		return NULL;
+	dir = PAGE_DIR_OFFSET(p->tss.cr3, address);
+	if ((*dir & 3) != 3)
+		return NULL;
+	pte = (unsigned long *) (0xfffff000 & *dir) + ((address >> 12) & 0x3ff);
+	page = *pte;
+	if (!(page & PAGE_PRESENT) || (page & PAGE_LOCKED))
+		return NULL;
+	page &= 0xfffff000;
+	if (page < LOW_MEM || page >= HIGH_MEMORY || mem_map[MAP_NR(page)] != 1)
+		return NULL;
+	return pte;
+}
+
+// 把任务nr中页表项pte映射的页面换成只读的页面page,并释放原页面.页表项中的其他标志(包括已修改标志D)保持不变.
+// page的引用计数由调用者负责递增.被修改的是当前任务的页表时需要刷新对应的页变换高速缓冲项.
+static void replace_page(int nr, unsigned long * pte, unsigned long address, unsigned long page)
+{
+	unsigned long old_page = 0xfffff000 & *pte;
+
+	*pte = page | (*pte & 0xfff & ~PAGE_RW);
+	if (task[nr]->tss.cr3 == current->tss.cr3)
+		invalidate_page(address);
+	free_page(old_page);
+}
+
+// 已合并页面只剩一个映射时,释放表中对它的引用.此后页面就是普通的私有页面,写入时不必再复制.
+static void release_ksm_page(struct ksm_page * k)
+{
+	if (k->page && mem_map[MAP_NR(k->page)] <= 2) {
+		free_page(k->page);
+		k->page = 0;
+	}
+}
+
+// 检查任务nr中线性地址address处的页面能否合并.
+// 全零页面直接换成全零页面.然后在已合并页面表中查找内容相同的页面;找不到时再在候选页面表中查找,若候选页面的内容仍然相同,就把它
+// 变成已合并页面.都找不到时把本页面记为候选页面.
+static void ksm_page(int nr, unsigned long * pte, unsigned long address)
+{
+	struct ksm_page * k;
+	struct ksm_candidate * c;
+	unsigned long page = 0xfffff000 & *pte, csum, * other;
+	int zero;
+
+	ksm_scanned++;
+	csum = page_csum(page, &zero);
+	if (zero) {
+		replace_page(nr, pte, address, ZERO_PAGE);
+		ksm_zero++;
+		return;
+	}
+	k = ksm_pages + csum % NR_KSM_PAGES;
+	release_ksm_page(k);
+	if (k->page && k->csum == csum && !memcmp((void *) k->page, (void *) page, PAGE_SIZE)) {
+		mem_map[MAP_NR(k->page)]++;
+		replace_page(nr, pte, address, k->page);
+		ksm_merged++;
+		return;
+	}
+	c = ksm_candidates + csum % NR_KSM_CANDIDATES;
+	if (c->task && c->csum == csum && (c->task != nr || c->address != address) &&
+	    !k->page && (other = private_pte(c->task, c->address)) &&
+	    !memcmp((void *) (0xfffff000 & *other), (void *) page, PAGE_SIZE)) {
+		// 候选页面成为已合并页面:表持有一个引用,候选页面本身的页表项改为只读.
+		k->csum = csum;
+		k->page = 0xfffff000 & *other;
+		mem_map[MAP_NR(k->page)] += 2;
+		*other &= ~PAGE_RW;
+		if (task[c->task]->tss.cr3 == current->tss.cr3)
+			invalidate_page(c->address);
+		replace_page(nr, pte, address, k->page);
+		ksm_merged++;
+		c->task = 0;
+		return;
+	}
+	c->csum = csum;
+	c->task = nr;
+	c->address = address;
+}
+
+// 相同页面合并扫描.
+// 由任务0在空闲时(执行pause()系统调用时)调用.扫描位置(任务号,目录项,页表项)保存在静态变量中,每次最多计算KSM_SCAN_BATCH个页面的
+// 校验和,其间一旦有其他任务可以运行就立即返回.所有任务扫描完一遍之后等待KSM_PASS_DELAY个滴答再开始下一遍.
+void ksm_scan(void)
+{
+	static int ksm_task = NR_TASKS;			// 正在扫描的任务号.
+	static int dir_entry = 1024;			// 正在扫描的目录项.
+	static int page_entry = 0;				// 下一个要扫描的页表项.
+	static long next_pass = 0;				// 下一遍扫描的开始时间.
+	unsigned long pg_table, * pte, address;
+	int batch = KSM_SCAN_BATCH;
+
+	// 在386上内核写用户页面时不检查写保护(wp_works_ok为0),内核在verify_area()之后睡眠时若其页面被换成只读的共享页面,随后的put_fs_xxx()
+	// 就会直接写入共享页面.因此只有写保护对内核也有效时才进行合并.
+	if (!wp_works_ok || jiffies < next_pass)
+		return;
+	// 顺便检查一个已合并页面是否已不再被共享.
+	release_ksm_page(ksm_pages + ksm_hand);
+	if (++ksm_hand >= NR_KSM_PAGES)
+		ksm_hand = 0;
+	while (batch > 0) {
+		if (other_runnable())
+			return;
+		// 任务已不存在或其页目录已扫描完,则换到下一个任务(任务0没有用户空间页面,不扫描).所有任务扫描完一遍后暂停一段时间.
+		if (!ksm_task || ksm_task >= NR_TASKS || !task[ksm_task] || dir_entry >= 1024) {
+			if (++ksm_task >= NR_TASKS) {
+				ksm_task = 0;
+				next_pass = jiffies + KSM_PASS_DELAY;
+				return;
+			}
+			dir_entry = FIRST_VM_DIR;
+			page_entry = 0;
+			continue;
+		}
+		// 跳过二级页表不存在或仍被共享的目录项,以及与属主共用页目录的vfork()子进程和线程.
+		pg_table = ((unsigned long *) task[ksm_task]->tss.cr3)[dir_entry];
+		if ((pg_table & 3) != 3 || !mm_owner(task[ksm_task]) || page_entry >= 1024) {
+			dir_entry++;
+			page_entry = 0;
+			continue;
+		}
+		address = (dir_entry << 22) | (page_entry << 12);
+		page_entry++;
+		if (pte = private_pte(ksm_task, address)) {
+			ksm_page(ksm_task, pte, address);
+			batch--;
+		}
+	}
+}
+
+// 显示相同页面合并统计信息.在show_mem()中被调用.
+// 已节省的页面数是各已合并页面的映射数减1之和,再加上换成全零页面的页面数.
+void ksm_show(void)
+{
+	int i, shared = 0, saved = 0;
+
+	for (i = 0 ; i < NR_KSM_PAGES ; i++)
+		if (ksm_pages[i].page) {
+			shared++;
+			saved += mem_map[MAP_NR(ksm_pages[i].page)] - 2;
+		}
+	printk("KSM: %d pages scanned, %d shared, %d saved, %d merged (%d into zero page)\n\r",
+		ksm_scanned, shared, saved + ksm_zero, ksm_merged, ksm_zero);
+}
@@ -45,6 +45,7 @@
  * 91.12.20 - OK，把交换设备修改成可更改的了，就像根文件设备那样。
  */
 
+#include <errno.h>
 #include <signal.h>
 
 #include <asm/system.h>
@@ -58,12 +59,35 @@
 
 unsigned long HIGH_MEMORY = 0;	/* 全局变量,存放实际物理内存最高端地址 */
 
+// CPU是否支持invlpg指令(486及以后),以及刷新整个页变换高速缓冲和只刷新一个页面的次数.
+int invlpg_ok = 0;
+unsigned long tlb_full_flushes = 0;
+unsigned long tlb_page_flushes = 0;
+
+// cr0中的写保护位WP是否已置位(486及以后).
+int wp_works_ok = 0;
+
+// CPU是否支持4MB页面(PSE)和全局页面(PGE).若支持,内核恒等映射使用4MB页面,以减少内核访问内存时占用的页变换高速缓冲项;全局页面
+// 的缓冲项在重新加载cr3(任务切换)时也不会被丢弃.
+static int pse_ok = 0;
+static int pge_ok = 0;
+
+// 缺页异常统计:缺页异常次数,写保护异常次数,以及缺页时顺带预先映射的相邻页面数.
+unsigned long nr_no_page_faults = 0;
+unsigned long nr_wp_faults = 0;
+unsigned long nr_fault_around = 0;
+unsigned long nr_zero_page_maps = 0;		// 映射全零页面的次数.
+
+// 缺页时最多预先映射的相邻页面数.
+#define FAULT_AROUND_PAGES 7
+
 // 从from处复制一页内存到to处(4KB)
 #define copy_page(from,to) __asm__("cld ; rep ; movsl"::"S" (from),"D" (to),"c" (1024):)
 
-// 内存映射字节图(1字节代表1页内存).每个页面对应的字节用于标志页面当前被引用(占用)次数.它最大可以映射15MB的内存空间.
-// 在初始化函数mem_init()中,对于不能用作主内存区页面的位置均都参选被设置成USED(100).
-unsigned char mem_map [ PAGING_PAGES ] = {0, };
+// 内存映射字节图(1字节代表1页内存).每个页面对应的字节用于标志页面当前被引用(占用)次数.它由mem_init()按实际内存大小在主内存区
+// 开始处分配.在初始化函数mem_init()中,对于不能用作主内存区页面的位置均都参选被设置成USED(100).
+unsigned char * mem_map = NULL;
+unsigned long paging_pages = 0;	// mem_map[]的项数.
 
 /*
  * Free a page of memory at physical address 'addr'. Used by
@@ -104,8 +128,9 @@ void free_page(unsigned long addr)
 // 着目录空间),共4个页表.每个页表有1024项,每项4B.因此也占4KB(1页)内存.各进程(除了在内核代码中的进程0和1)的页表所
 // 占据的页面在进程被创建时由内核为其在主内存区申请得到.每个页表项对应1页物理内存,因此一个页表最多可映射4MB的物理
 // 内存.
-// 参数:from - 起始线性基地址;size - 释放的字节长度.
-int free_page_tables(unsigned long from, unsigned long size)
+// 参数:page_dir - 页目录物理地址;from - 起始线性基地址;size - 释放的字节长度.
+// 释放的是当前进程的页面时,同时递减其驻留页面数.
+int free_page_tables(unsigned long page_dir, unsigned long from, unsigned long size)
 {
 	unsigned long *pg_table;
 	unsigned long * dir, nr;
@@ -120,10 +145,10 @@ int free_page_tables(unsigned long from, unsigned long size)
 	// 因为1个页表可管理4MB物理内存,所以这里用右移22位的方式把需要复制的内存长度值除以4MB.其中加上0x3fffff(即4MB-1)
 	// 用于得到进位整数倍结果,即除操作若有余数则进1.例如,如果原size = 4.01MB,那么可得到结果size = 2.
 	size = (size + 0x3fffff) >> 22;
-	// 接着计算给出的线性基地址对应的起始目录项, 对应的目录项号 = from >>22.因为每项点4字节,并且由于页目录表从物理
-	// 地址0开始存放,因此实际目录项指针 = 目录项号<<2,也即(from >> 20),"与"上0xffc确保目录项指针范围有效.
+	// 接着计算给出的线性基地址对应的起始目录项, 对应的目录项号 = from >>22.因为每项点4字节,因此目录项在页目录中的偏移 = 目录项号<<2,
+	// 也即(from >> 20),"与"上0xffc确保目录项指针范围有效.
 	// dir表示起始的页目录项物理地址
-	dir = (unsigned long *) ((from >> 20) & 0xffc); 			/* _pg_dir = 0 */
+	dir = PAGE_DIR_OFFSET(page_dir, from);
 	// 此时size是释放的页表个数,即页目录项数,而dir是起始目录项指针.现在开始循环操作页目录项,依次释放每个页表中的页
 	// 表项.如果当前目录项无效(P位=0),表示该目录项没有使用(对应的页表不存在),则继续处理下一个页表项.否则从目录项中
 	// 取出页表地址pg_table,并对该页表中的1024个表项进行处理,释放有效页表(P位=1)对应的物理内存页面,或者从交换设备中
@@ -135,13 +160,21 @@ int free_page_tables(unsigned long from, unsigned long size)
 		if (!(1 & *dir))
 			continue;
 		pg_table = (unsigned long *) (0xfffff000 & *dir);// 取页表地址.
+		// 如果该页表还被其他进程(fork()产生的父进程或子进程)共享,那么其中的页面仍在被使用,因此只递减页表的引用计数.
+		if ((unsigned long) pg_table >= LOW_MEM && mem_map[MAP_NR((unsigned long) pg_table)] > 1) {
+			free_page((unsigned long) pg_table);
+			*dir = 0;
+			continue;
+		}
 		for (nr = 0 ; nr < 1024 ; nr++) {
 			if (*pg_table) {							// 若所指页表项内容不为0,则若该项有效,则释放对
 														// 应面.
-				if (1 & *pg_table)
+				if (1 & *pg_table) {
 					free_page(0xfffff000 & *pg_table);
-				else									// 否则释放交换设备中对应页.
-					swap_free(*pg_table >> 1);
+					if (page_dir == current->tss.cr3)
+						dec_rss(current);
+				} else									// 否则释放交换设备中对应页.
+					swap_free(*pg_table);
 				*pg_table = 0;							// 该页表项内容清零.
 			}
 			pg_table++;									//指向页表中下一项.
@@ -153,6 +186,21 @@ int free_page_tables(unsigned long from, unsigned long size)
 	return 0;
 }
 
+// 为新任务申请一页页目录.
+// 线性地址TASK_BASE以下是内核对物理内存的恒等映射,其页表由所有任务共用,因此从任务0的页目录pg_dir中复制这些目录项,其余目录项为空.
+// 返回页目录的物理地址,内存不够时返回0.在fork()和vfork()子进程执行execve()时被调用,页目录在任务被释放时(release())释放.
+unsigned long new_page_dir(void)
+{
+	unsigned long dir;
+	int i;
+
+	if (!(dir = get_free_page()))
+		return 0;
+	for (i = 0 ; i < (TASK_BASE >> 22) ; i++)
+		((unsigned long *) dir)[i] = pg_dir[i];
+	return dir;
+}
+
 /*
  *  Well, here is one of the most complicated functions in mm. It
  * copies a range of linerar addresses by copying only the pages.
@@ -182,12 +230,24 @@ int free_page_tables(unsigned long from, unsigned long size)
  * 更多的内存,在低1MB内存范围内不执行写时复制操作,所以这些页面可以与内核共享.因此这是nr=xxxx的特殊情况(nr在程序
  * 中指页面数).
  */
+// 页表中是否有被mlock()锁定的页面.
+static int table_locked(unsigned long * table)
+{
+	int nr;
+
+	for (nr = 0 ; nr < 1024 ; nr++)
+		if ((table[nr] & (PAGE_LOCKED | PAGE_PRESENT)) == (PAGE_LOCKED | PAGE_PRESENT))
+			return 1;
+	return 0;
+}
+
 // 复制目录表项和页表项.
 // 复制指定线性地址和长度内存对应的页目录项和页表项,从而被复制的页目录和页表对应的原物理内存页面区被两套页表映
 // 射而共享使用.复制时,需申请新页面来存放新页表,原物理内存区将被共享.此后两个进程(父进程和其子进程)将共享内存区,
 // 直到有一个进程执行写操作时,内核才会为写操作进程分配新的内存页(写时复制机制).
-// 参数from,to是线性地址,size是需要复制(共享)的内存长度,单位是字节.
-int copy_page_tables(unsigned long from, unsigned long to, long size)
+// 参数from,to是线性地址,from_dir,to_dir是它们所在的页目录的物理地址,size是需要复制(共享)的内存长度,单位是字节.
+int copy_page_tables(unsigned long from_pg_dir, unsigned long from,
+	unsigned long to_pg_dir, unsigned long to, long size)
 {
 	unsigned long * from_page_table;
 	unsigned long * to_page_table;
@@ -202,21 +262,34 @@ int copy_page_tables(unsigned long from, unsigned long to, long size)
 	// do_dir).再根据参数给出的长度size计算要复制的内存块占用的页表数(即目录项数)
 	if ((from & 0x3fffff) || (to & 0x3fffff))
 		panic("copy_page_tables called with wrong alignment");
-	from_dir = (unsigned long *) ((from >> 20) & 0xffc); 				/* _pg_dir = 0 */
-	to_dir = (unsigned long *) ((to >> 20) & 0xffc);
+	from_dir = PAGE_DIR_OFFSET(from_pg_dir, from);
+	to_dir = PAGE_DIR_OFFSET(to_pg_dir, to);
 	size = ((unsigned) (size + 0x3fffff)) >> 22;
 	// 在得到了源起始目录项指针from_dir和目的起始目录项指针to_dir以及需要复制的页表个数size后,下面开始对每个页目
-	// 录项依次申请1页内存来保存对应的面表,并且开始页表项复制操作.如果目的目录项指定的页表已经存在(P=1),则出错死
-	// 机.如果源目录项无效,即指定的页表不存在(P=0),则继续循环处理下一个页目录项.
+	// 录项依次处理.如果目的目录项指定的页表已经存在(P=1),则出错死机.如果源目录项无效,即指定的页表不存在(P=0),则继续循环处理下一个页目录项.
 	for( ; size-- > 0 ; from_dir++, to_dir++) {
 		if (1 & *to_dir)
 			panic("copy_page_tables: already exist");
 		if (!(1 & *from_dir))
 			continue;
+		// 对于普通进程的fork(),并不复制页表,而是让子进程的目录项直接指向父进程的页表,并把父子进程的目录项都设置为只读,同时递增页表页面的
+		// 引用计数.目录项只读使得通过该页表映射的所有页面都只读,因此任何一方写页面时都会引起写保护异常,这时do_wp_page()才为写进程复制一份
+		// 页表(写时复制页表).这样fork()的开销只与目录项个数有关,而与进程的大小无关.任务0的页表位于1MB以下,不能用mem_map[]计数,因此仍
+		// 使用下面的复制方法.页表中有被mlock()锁定的页面时也立即复制,并去掉子进程页表项中的锁定标志:锁定不被子进程继承,而共享的页表
+		// 以后由哪一方复制是不确定的.
+		if (from && !(current->locked_pages && table_locked((unsigned long *) (0xfffff000 & *from_dir)))) {
+			*from_dir &= ~2;
+			*to_dir = *from_dir;
+			mem_map[MAP_NR(0xfffff000 & *from_dir)]++;
+			continue;
+		}
 		// 在验证了当前源目录项和目的项正常之后,取源目录项中页表地址from_page_table.为了保存目的目录项对应的页表,
 		// 需要在主内存区中申请1页空闲内存页.如果取空闲页面函数get_free_page()返回0,则说明没有申请到空闲内存页面,
 		// 可能是内存不够.于是返回-1值退出.
+		// 内核恒等映射使用4MB页面时,源目录项没有页表.这时改用head.s中的页表pg0,它仍保存着前4MB的恒等映射.
 		from_page_table = (unsigned long *) (0xfffff000 & *from_dir);
+		if (*from_dir & PAGE_4M)
+			from_page_table = (unsigned long *) 0x1000;
 		if (!(to_page_table = (unsigned long *) get_free_page()))
 			return -1;	/* Out of memory, see freeing */
 		// 否则我们设置目的目录项信息,把最后3位置位,即当前目的目录项"或"上7,表示对应页表映射的内存页面是用户级的,并且可读写,存在(User,R/W,Present).(如果
@@ -235,10 +308,10 @@ int copy_page_tables(unsigned long from, unsigned long to, long size)
 			// 目的页表项中.并修改源页表项内容指向该新申请的内存页.
 			if (!(1 & this_page)) {
 				// 申请一页新的内存然后将交换设备中的数据读取到该页面中
-				if (!(new_page = get_free_page()))
+				if (!(new_page = get_free_page_nozero()))
 					return -1;
 				// 从交换设备中将页面读取出来
-				read_swap_page(this_page >> 1, (char *) new_page);
+				read_swap_page(this_page, (char *) new_page);
 				// 目的页表项指向源页表项值
 				*to_page_table = this_page;
 				// 并修改源页表项内容指向该新申请的内存页,并设置表项标志为"页面脏"加上7
@@ -246,9 +319,9 @@ int copy_page_tables(unsigned long from, unsigned long to, long size)
 				// 继续处理下一页表项
 				continue;
 			}
-			// 复位页表项中R/W标志(位1置0),即让页表项对应的内存页面只读,然后将该页表项复制到目的页表中
+			// 复位页表项中R/W标志(位1置0),即让页表项对应的内存页面只读,然后将该页表项(去掉锁定标志)复制到目的页表中
 			this_page &= ~2;
-			*to_page_table = this_page;
+			*to_page_table = this_page & ~PAGE_LOCKED;
 			// 如果该页表项所指物理页面的地址在1MB以上,则需要设置内存页面映射数组mem_map[],于是计算页面号,并以它为索引在页面同数组相应项中增加引用次数.而对于位于1MB以下
 			// 的页面,说明是内核页面,因此不需要对mem_map[]进行设置.因为mem_map[]仅用于管理主内存区中的页面使用请问.因此对于内核移动到任务0中并且调用fork()创建任务1时
 			// (用于运行init()),由于此时复制的页面还仍然都在内核代码区域,因此以下判断中的语句不会执行,任务0的页面仍然可以随时读写.只有当调用fork()的父进程代码处于主内存
@@ -267,6 +340,106 @@ int copy_page_tables(unsigned long from, unsigned long to, long size)
 	return 0;
 }
 
+/*
+ * Page tables are shared between parent and child after fork(), with
+ * the page-directory entries write-protected. The first write through
+ * such an entry comes here and gives the writer its own copy.
+ */
+/*
+ * fork()之后父子进程共享页表,它们的目录项都被写保护.第一次通过这样的目录项执行写操作时会调用这里的函数,为写进程复制一份自己的页表.
+ */
+// 取消页表共享.
+// 参数dir是当前进程的目录项指针.若该页表只被当前进程使用(其他共享进程已经复制了自己的页表或已经退出),则把目录项设置为可写即可.否则申请
+// 一页新页表,复制所有页表项并把其中的页面都设置为只读,递增页面引用计数,就像原来fork()时所做的那样.交换设备中的页面不能被两个页表项引用,
+// 因此先把它们全部读入内存,放在原页表中(释放交换项),然后再复制.复制时不会再睡眠,因此页表的共享状态在复制期间保持不变.
+void unshare_page_table(unsigned long * dir)
+{
+	unsigned long old_table, new_table, this_page, new_page;
+	unsigned long * from_page_table, * to_page_table;
+	int nr;
+
+	old_table = 0xfffff000 & *dir;
+	if (old_table < LOW_MEM || mem_map[MAP_NR(old_table)] == 1) {
+		*dir |= 2;
+		invalidate();
+		return;
+	}
+	if (!(new_table = get_free_page()))
+		oom();
+	from_page_table = (unsigned long *) old_table;
+repeat:
+	// 申请页面和读交换页面时都可能睡眠,期间其他共享进程可能已经取消了共享或退出,同一地址空间中的线程也可能已经复制了该页表.
+	// 因此每次睡眠之后都重新检查.
+	if ((0xfffff000 & *dir) != old_table) {
+		free_page(new_table);
+		return;
+	}
+	if (mem_map[MAP_NR(old_table)] == 1) {
+		free_page(new_table);
+		*dir |= 2;
+		invalidate();
+		return;
+	}
+	for (nr = 0 ; nr < 1024 ; nr++) {
+		this_page = from_page_table[nr];
+		if (!this_page || (1 & this_page))
+			continue;
+		if (!(new_page = get_free_page_nozero()))
+			oom();
+		read_swap_page(this_page, (char *) new_page);
+		// 若页表项在读页面期间已被修改(例如被其他共享进程换入),则放弃读入的页面.
+		if (from_page_table[nr] == this_page) {
+			swap_free(this_page);
+			from_page_table[nr] = new_page | (PAGE_DIRTY | 7);
+		} else
+			free_page(new_page);
+		goto repeat;
+	}
+	to_page_table = (unsigned long *) new_table;
+	for (nr = 0 ; nr < 1024 ; nr++) {
+		this_page = from_page_table[nr];
+		if (!this_page)
+			continue;
+		this_page &= ~2;
+		from_page_table[nr] = this_page;
+		to_page_table[nr] = this_page;
+		if (this_page > LOW_MEM)
+			mem_map[MAP_NR(this_page)]++;
+	}
+	*dir = new_table | 7;
+	free_page(old_table);
+	invalidate();
+}
+
+// 释放当前进程线性地址范围[from, from+size)中的页面,用于解除映射(munmap()).from和size都是页面对齐的.
+// 与free_page_tables()不同,这里只释放部分页表项,页表本身保留.页表仍与其他进程共享时先复制一份,否则会把别的进程的页面也释放掉.
+void zap_page_range(unsigned long from, unsigned long size)
+{
+	unsigned long * dir, * pte, end = from + size;
+
+	for ( ; from < end ; from += PAGE_SIZE) {
+		dir = PAGE_DIR_OFFSET(current->tss.cr3, from);
+		if (!(*dir & 1)) {
+			from |= 0x3ff000;
+			continue;
+		}
+		if (!(*dir & 2))
+			unshare_page_table(dir);
+		pte = (unsigned long *) (0xfffff000 & *dir) + ((from >> 12) & 0x3ff);
+		if (!*pte)
+			continue;
+		if (*pte & 1) {
+			if ((*pte & PAGE_LOCKED) && current->locked_pages)
+				current->locked_pages--;
+			free_page(0xfffff000 & *pte);
+			dec_rss(current);
+		} else
+			swap_free(*pte);
+		*pte = 0;
+	}
+	invalidate();
+}
+
 /*
  * This function puts a page in memory at the wanted address.
  * It returns the physical address of the page gotten, 0 if
@@ -285,9 +458,6 @@ static unsigned long put_page(unsigned long page, unsigned long address)
 {
 	unsigned long tmp, *page_table;
 
-	/* NOTE !!! This uses the fact that _pg_dir=0 */
-	/* 注意!!!这里使用了页目录表基地址pg_dir=0的条件 */
-
 	// 首先判断参数给定物理内存页面page的有效性.如果该页面位置低于LOW_MEM(1MB)或超出系统实际含有内存高端HIGH_MEMORY,则发出警告.LOW_MEM是主内存区可能有的
 	// 最小起始位置.当系统后果内存小于或等于6MB时,主内存区始于LOW_MEM处.再查看一下该page页面是不已经申请的页面,即判断其在内存页面映射字节图mem_map[]中相应
 	// 字节是否以置位.若没有则需发出警告.
@@ -297,7 +467,7 @@ static unsigned long put_page(unsigned long page, unsigned long address)
 		printk("mem_map disagrees with %p at %p\n", page, address);
 	// 然后根据参数指定的线性地址address计算其在页目录表中对应的目录项指针,并从中取得一级页表地址.如果该目录项有效(P=1),即指定的页表在内存中,则从中取得指定页表
 	// 地址放到page_table变量中.否则申请一空闲页面给页表使用,并在对应目录项中置相应标志(7 - User,U/S,R/W).然后将该页表地址放到page_table变量中.
-	page_table = (unsigned long *) ((address >> 20) & 0xffc);
+	page_table = PAGE_DIR_OFFSET(current->tss.cr3, address);
 	if ((*page_table) & 1)
 		page_table = (unsigned long *) (0xfffff000 & *page_table);
 	else {
@@ -309,6 +479,7 @@ static unsigned long put_page(unsigned long page, unsigned long address)
 	// 最后在找到的页表page_table中设置相关页表项内容,即把物理页面page的地址填入表项同时置位3个标志(U/S,W/R,P).该页表项在页表中的索引值等于线性地址位21~位12
 	// 组成的10位的值.每个页表共可有1024项(0~0x3ff).
 	page_table[(address >> 12) & 0x3ff] = page | 7;
+	inc_rss(current);
 	/* no need for invalidate */
 	/* 不需要刷新页变换高速缓冲 */
 	return page;					// 返回物理页面地址.
@@ -330,8 +501,6 @@ unsigned long put_dirty_page(unsigned long page, unsigned long address)
 {
 	unsigned long tmp, *page_table;
 
-	/* NOTE !!! This uses the fact that _pg_dir=0 */
-
 	// 首先判断参数给定物理内存页面page的有效性.如果该页面位置低于LOW_MEM(1MB)或超出系统实际含有内存高端HIGH_MEMORY,则发出警告.LOW_MEM是主内存区可能有的
 	// 最小起始位置.当系统后果内存小于或等于6MB时,主内存区始于LOW_MEM处.再查看一下该page页面是不已经申请的页面,即判断其在内存页面映射字节图mem_map[]中相应
 	// 字节是否以置位.若没有则需发出警告.
@@ -341,7 +510,7 @@ unsigned long put_dirty_page(unsigned long page, unsigned long address)
 		printk("mem_map disagrees with %p at %p\n", page, address);
 	// 然后根据参数指定的线性地址address计算其在页目录表中对应的目录项指针,并从中取得一级页表地址.如果该目录项有效(P=1),即指定的页表在内存中,则从中取得指定页表
 	// 地址放到page_table变量中.否则申请一空闲页面给页表使用,并在对应目录项中置相应标志(7 - User,U/S,R/W).然后将该页表地址放到page_table变量中.
-	page_table = (unsigned long *) ((address >> 20) & 0xffc);
+	page_table = PAGE_DIR_OFFSET(current->tss.cr3, address);
 	if ((*page_table) & 1)
 		page_table = (unsigned long *) (0xfffff000 & *page_table);
 	else {
@@ -353,6 +522,7 @@ unsigned long put_dirty_page(unsigned long page, unsigned long address)
 	// 最后在找到的页表page_table中设置相关页表项内容,即把物理页面page的地址填入表项同时置位3个标志(U/S,W/R,P).该页表项在页表中的索引值等于线性地址位21~位12
 	// 组成的10位的值.每个页表共可有1024项(0~0x3ff).
 	page_table[(address >> 12) & 0x3ff] = page | (PAGE_DIRTY | 7);
+	inc_rss(current);
 	/* no need for invalidate */
 	/* 不需要刷新页变换高速缓冲 */
 	return page;
@@ -362,31 +532,47 @@ unsigned long put_dirty_page(unsigned long page, unsigned long address)
 // 用于页异常中断过程中写保护异常的处理(写时复制).在内核创建进程时,新进程与父进程被设置成共享代码和数据内存页面,并且所有这些页面均被设置成只读页面.而当新进程或原
 // 进程需要向内存页面写数据时,CPU就会检测到这个情况并产生页面写保护异常.于是在这个函数中内核就会首先判断要写的页面是否被共享.若没有则把页面设置成可写然后退出.若页面
 // 处于共享状态,则要重新申请一新页面并复制被写页面内容,以供写进程单独使用.共享被取消.
-// 输入参数为页面表项指针,是物理地址.[un_wp_page -- Un-Write Protect Page]
-void un_wp_page(unsigned long * table_entry)
+// 输入参数为页面表项指针,是物理地址;address是该页面的线性地址,用于刷新对应的页变换高速缓冲项.[un_wp_page -- Un-Write Protect Page]
+void un_wp_page(unsigned long * table_entry, unsigned long address)
 {
 	unsigned long old_page, new_page;
+	struct vm_area_struct * vma;
 
 	// 首先取参数指定的页表项中物理页面位置(地址)并判断该页面是不是共享页面.如果原页面地址大于内存低端LOW_MEM(表示在主内存区中),并且其在页面映射字节图数组中值为1(表示
 	// 页面仅被引用1次,页面没有被共享),则在该页面的页表项中 R/W标志(可写),并刷新页变换高速缓冲,然后返回.即如果该内存页面此时只被一个进程使用,并且不是内核中的进程,就直接
 	// 把属性改为可写即可,不必重新申请一个新页面.
 	old_page = 0xfffff000 & *table_entry;				// 取指定页表项中物理页面地址.
+	// 可写的共享映射页面被所有映射它的进程共用(至少还被页面缓存引用),写入时不复制,直接设置为可写即可.
+	if (current->mm->mmap && (vma = find_vma(current, address - current->start_code)) &&
+	    (vma->vm_flags & (VM_SHARED | VM_WRITE)) == (VM_SHARED | VM_WRITE)) {
+		*table_entry |= 2;
+		invalidate_page(address);
+		return;
+	}
 	if (old_page >= LOW_MEM && mem_map[MAP_NR(old_page)] == 1) {
 		*table_entry |= 2;
-		invalidate();
+		invalidate_page(address);
+		return;
+	}
+	// 如果是全零页面,则第一次写入时才真正分配页面.get_free_page()返回的页面已经清零,不用复制.
+	if (old_page == ZERO_PAGE) {
+		if (!(new_page = get_free_page()))
+			oom();
+		*table_entry = new_page | 7 | (*table_entry & PAGE_LOCKED);
+		invalidate_page(address);
 		return;
 	}
 	// 否则就需要在主内存区内申请一页空闲页面给执行写操作的进程单独使用,取消页面共享.如果原页面大于内存低端(则意味着mem_map[]>1,页面是共享的),则将原页面的页面映射字节数组
 	// 值递减1.然后将指定页表项内容更新为新页面地址,并置可读写标志(U/S,R/W,P).在刷新页变换高速缓冲之后,最后将原页面内容复制到新页面.
-	if (!(new_page = get_free_page()))
+	if (!(new_page = get_free_page_nozero()))
 		oom();											// 内存不够处理.
 	if (old_page >= LOW_MEM)
 		mem_map[MAP_NR(old_page)]--;
 	copy_page(old_page, new_page);
-	// 将新的页面设置为可读可写且存在
-	*table_entry = new_page | 7;
-	// 刷新高速缓冲
-	invalidate();
+	// 将新的页面设置为可读可写且存在,并保持页面的锁定标志.
+	*table_entry = new_page | 7 | (*table_entry & PAGE_LOCKED);
+	// 刷新该页面的高速缓冲项
+	invalidate_page(address);
 }
 
 /*
@@ -408,15 +594,23 @@ void un_wp_page(unsigned long * table_entry)
 // 线性地址.写共享页面时需复制页面(写时复制).
 void do_wp_page(unsigned long error_code, unsigned long address)
 {
+	unsigned long * dir, * table_entry;
+	struct vm_area_struct * vma;
+
+	nr_wp_faults++;
 	// 首先判断CPU控制寄存器CR2给出的引起页面异常的线性地址在什么范围中.如果address小于TASK_SIZE(0x4000000,即64MB),表示异常页面位置
 	// 在内核或任务0和任务1所处的线性地址范围内,于是发出警告信息"内核范围内存被写保护";如果(address - 当前进程代码起始地址)大于一个进程的
 	// 长度(64MB),表示address所指的线性地址不在引起异常的进程线性地址空间范围内,则在发出出错信息后退出.
-	if (address < TASK_SIZE)
+	if (address < TASK_BASE)
 		printk("\n\rBAD! KERNEL MEMORY WP-ERR!\n\r");
 	if (address - current->start_code > TASK_SIZE) {
 		printk("Bad things happen: page error in do_wp_page\n\r");
 		do_exit(SIGSEGV);
 	}
+	// 写没有PROT_WRITE权限的映射区.
+	if (current->mm->mmap && (vma = find_vma(current, address - current->start_code)) &&
+	    !(vma->vm_flags & VM_WRITE))
+		do_exit(SIGSEGV);
 #if 0
 	/* we cannot do this yet: the estdio library writes to code space */
 	/* stupid, stupid. I really want the libc.a from GNU */
@@ -436,9 +630,17 @@ void do_wp_page(unsigned long error_code, unsigned long address)
 	// 的物理地址.最后与上0xffffff000用于屏蔽掉页目录项内容中的一些标志位(目录项低12位).直观表示为(0xffffff000 & *((unsigned long *) (((
 	// address>>22) & 0x3ff)<<2))).3:由1中页表项在页表中偏移地址加上2中目录表项内容中对应页表的物理地址即可得到页表项的指针(物理地址).这里对
 	// 共享的页面进行复制.
+	// 如果目录项是只读的,说明页表还与其他进程共享,需要先为当前进程复制一份页表.复制之后所有页面都是只读的.若当前进程已是页表的唯一使用者,
+	// 那么页表项可能本来就是可写的,此时异常已经处理完毕.若页面在此期间被换出,则留给缺页处理.
+	dir = PAGE_DIR_OFFSET(current->tss.cr3, address);
+	if (!(*dir & 2)) {
+		unshare_page_table(dir);
+		table_entry = (unsigned long *) ((0xfffff000 & *dir) + ((address >> 10) & 0xffc));
+		if ((*table_entry & 3) != 1)
+			return;
+	}
 	un_wp_page((unsigned long *)
-		(((address >> 10) & 0xffc) + (0xfffff000 &
-		*((unsigned long *) ((address >> 20) & 0xffc)))));
+		(((address >> 10) & 0xffc) + (0xfffff000 & *dir)), address);
 
 }
 
@@ -447,21 +649,27 @@ void do_wp_page(unsigned long error_code, unsigned long address)
 // 参数address是指定页面在4GB空间中的线性地址.
 void write_verify(unsigned long address)
 {
-	unsigned long page;
+	unsigned long page, * dir;
 
 	// 首先取指定线性地址对应的页目录项,根据目录项中的存在位(P)判断目录项对应的页表是否存在(存在位P=1?),若不存在(P=0)则返回.这样处理
 	// 是因为对于不存在的页面没有共享和写时复制可言,并且若程序对此不存在的页面执行写操作时,系统就会因为缺页异常而去执行do_no_page(),
 	// 并为这个地方使用put_page()函数映射一个物理页面.接着程序从目录项中取页表地址,加上指定页面在页表中的页表项偏移值,得对应地址的页表
 	// 项指针.在该表项中包含着给定线性地址对应的物理页面.
-	if (!( (page = *((unsigned long *) ((address >> 20) & 0xffc)) ) & 1))
+	dir = PAGE_DIR_OFFSET(current->tss.cr3, address);
+	if (!( (page = *dir) & 1) || (page & PAGE_4M))
 		return;
+	// 内核态写用户页面时386不检查写保护,因此若页表还在与其他进程共享(目录项只读),需要在这里先为当前进程复制一份页表.
+	if (!(page & 2)) {
+		unshare_page_table(dir);
+		page = *dir;
+	}
 	page &= 0xfffff000;
 	// 得到页表项的物理地址
 	page += ((address >> 10) & 0xffc);
 	// 然后判断该页表项中位1(P/W),位0(P)标志.如果该页面不可写(R/W=0)且存在,那么就执行共享检验和复制页面操作(写时复制).否则什么也不做,
 	// 直接退出.
 	if ((3 & *(unsigned long *) page) == 1)  /* non-writeable, present */
-		un_wp_page((unsigned long *) page);
+		un_wp_page((unsigned long *) page, address);
 	return;
 }
 
@@ -508,13 +716,10 @@ static int try_to_share(unsigned long address, struct task_struct * p)
 	unsigned long to_page;
 	unsigned long phys_addr;
 
-	// 首先分别求得指定进程p中和当前进程中逻辑地址address对应的页目录项。为了计算方便先求出指定逻辑地址address处的“逻辑”页
-	// 目录号，即以进程空间（0 - 64MB）算出的页目录项号。该“逻辑”页目录项号加上进程p在CPU 4GB线性空间中起始地址对应的页目录
-	// 项，即得到进程p中地址address处页面所对应的4GB线性空间中实际页目录项from_page。而“逻辑”页目录项号加上当前进程CPU 4GB
-	// 线性空间中的实际页目录项to_page。
-	from_page = to_page = ((address >> 20) & 0xffc);
-	from_page += ((p->start_code >> 20) & 0xffc);             		// p进程目录项。
-	to_page += ((current->start_code >> 20) & 0xffc);         		// 当前进程目录项。
+	// 首先分别求得指定进程p中和当前进程中逻辑地址address对应的页目录项。每个进程有自己的页目录，因此分别在进程p的页目录和
+	// 当前进程的页目录中取逻辑地址address（加上各自的代码段基址）对应的目录项from_page和to_page。
+	from_page = (unsigned long) PAGE_DIR_OFFSET(p->tss.cr3, p->start_code + address);          	// p进程目录项。
+	to_page = (unsigned long) PAGE_DIR_OFFSET(current->tss.cr3, current->start_code + address);	// 当前进程目录项。
 	// 在得到p进程和当前进程address对应的目录项后，下面分别对进程p和当前进程处理。首先对p进程的表项进行操作。目录是取得p进程中
 	// address对应的物理内在页面地址，并且该物理页面存在，而且干净（没有被修改过，不脏）。
 	// 方法是先取目录项内容。如果该目录项元效（P=0），表示目录项对应的二级页表不存在，于是返回。否则取该目录项对应页表地址from，
@@ -556,15 +761,52 @@ static int try_to_share(unsigned long address, struct task_struct * p)
 	/* share them: write-protect */
 	/* 对它们进行共享处理：写保护区*/
 	*(unsigned long *) from_page &= ~2;
-	*(unsigned long *) to_page = *(unsigned long *) from_page;
-	// 随后刷新页变换高速缓冲。计算所操作物理页面的页面号，并将对应页面映射字节数组项中的引用递增1.最后返回1,表示共享处理成功。
-	invalidate();
+	*(unsigned long *) to_page = *(unsigned long *) from_page & ~PAGE_LOCKED;
+	inc_rss(current);
+	// 随后刷新页变换高速缓冲。当前进程的页表项原来不存在，不会被缓冲，因此只需刷新进程p中被设置为只读的那个页面。计算所操作物理页
+	// 面的页面号，并将对应页面映射字节数组项中的引用递增1.最后返回1,表示共享处理成功。
+	invalidate_page(p->start_code + address);
 	phys_addr -= LOW_MEM;
 	phys_addr >>= 12;                       						// 得页面号。
 	mem_map[phys_addr]++;
 	return 1;
 }
 
+// 把任务p加入其执行文件i节点和库文件i节点的任务链表.
+// 在fork()复制进程,execve()更换执行文件和uselib()更换库文件之后调用.
+void link_text_inodes(struct task_struct * p)
+{
+	if (p->executable) {
+		p->exec_next = p->executable->i_exec_tasks;
+		p->executable->i_exec_tasks = p;
+	}
+	if (p->library) {
+		p->lib_next = p->library->i_lib_tasks;
+		p->library->i_lib_tasks = p;
+	}
+}
+
+// 把任务p从其执行文件i节点和库文件i节点的任务链表中删除.
+// 在放回(iput)这两个i节点之前调用.
+void unlink_text_inodes(struct task_struct * p)
+{
+	struct task_struct ** q;
+
+	if (p->executable)
+		for (q = &p->executable->i_exec_tasks ; *q ; q = &(*q)->exec_next)
+			if (*q == p) {
+				*q = p->exec_next;
+				break;
+			}
+	if (p->library)
+		for (q = &p->library->i_lib_tasks ; *q ; q = &(*q)->lib_next)
+			if (*q == p) {
+				*q = p->lib_next;
+				break;
+			}
+	p->exec_next = p->lib_next = NULL;
+}
+
 /*
  * share_page() tries to find a process that could share a page with
  * the current one. Address is the address of the wanted page relative
@@ -589,32 +831,247 @@ static int try_to_share(unsigned long address, struct task_struct * p)
 // 回1 - 共享操作成功,0 - 失败.
 static int share_page(struct m_inode * inode, unsigned long address)
 {
-	struct task_struct ** p;
+	struct task_struct * p;
+	unsigned long tmp, * dir;
 
 	// 首先检查一下参数指定的内存i节点引用计数值.如果该内存i节点的引用计数值等于1(executalbe->i_count=1)或者i节点指针空,表示当前系
 	// 统中只有1个进程在运行该执行文件或者提供的i节点无效.因此无共享可言,直接退出函数.
 	if (inode->i_count < 2 || !inode)
 		return 0;
-	// 否则搜索任务数组中所有任务.寻找与当前进程可共享页面的进程,即运行相同执行文件的另一个进程,并尝试对指定地址的页面进行共享.若进程逻
-	// 辑地址address小于进程库文件在逻辑地址空间的起始地址LIBRARY_OFFSET,则表明共享的页面在进程执行文件对应的逻辑地址空间范围内,于是
-	// 检查一下指定i节点是否与进程的执行文件i节点(即进程executable相同,若不相同则继续寻找.若进程逻辑地址address大于等于进程库文件在
-	// 逻辑地址空间的起始地址LIBRARY_OFFSET,则表明想要共享的页面在进程使用的库文件中,于是检查指定节点inode是否与进程的库文件i节点相同,
-	// 若不相同则继续寻找.如果找到某个进程p,其executable或library与指定的节点inode相同,则调用页面试探函数try_to_share()尝试页面共
-	// 享.若共享操作成功,则函数返回1.否则返回0,表示共享页面操作失败.
-	for (p = &LAST_TASK ; p > &FIRST_TASK ; --p) {
-		if (!*p)								// 如果该任务项空闲,则继续寻找.
+	// 否则在i节点的任务链表中寻找与当前进程可共享页面的进程,即运行相同执行文件(或使用相同库文件)的另一个进程,并尝试对指定地址的页面
+	// 进行共享.若进程逻辑地址address小于进程库文件在逻辑地址空间的起始地址LIBRARY_OFFSET,则表明共享的页面在进程执行文件对应的逻辑
+	// 地址空间范围内,于是搜索以inode为执行文件的任务链表,否则搜索以inode为库文件的任务链表.链表中的进程都映射着该i节点,因此不用再
+	// 扫描整个任务数组.若共享操作成功,则函数返回1.否则返回0,表示共享页面操作失败.
+	// 搜索前先为当前进程在address处准备好页表.这样try_to_share()就不会因申请页表页面而睡眠,链表在搜索过程中也就不会被改变.
+	dir = PAGE_DIR_OFFSET(current->tss.cr3, current->start_code + address);
+	if (!(*dir & 1)) {
+		if (!(tmp = get_free_page()))
+			oom();
+		if (*dir & 1)
+			free_page(tmp);
+		else
+			*dir = tmp | 7;
+	}
+	if (address < LIBRARY_OFFSET)
+		p = inode->i_exec_tasks;				// 进程执行文件i节点.
+	else
+		p = inode->i_lib_tasks;					// 进程使用库文件i节点.
+	for ( ; p ; p = (address < LIBRARY_OFFSET) ? p->exec_next : p->lib_next) {
+		if (current == p)						// 如果是当前任务,则继续寻找.
 			continue;
-		if (current == *p)						// 如果是当前任务,也继续寻找.
+		if (try_to_share(address, p))			// 尝试共享页面.
+			return 1;
+	}
+	return 0;
+}
+
+// 取执行文件或库文件中逻辑地址tmp处页面对应的4个设备逻辑块号,放在nr[]中,并返回页面第1块在文件中的逻辑块号.
+// 文件第1块是程序头结构,因此页面数据从第2块开始.
+static int file_page_blocks(struct m_inode * inode, unsigned long tmp, int nr[4])
+{
+	int block, i;
+
+	if (tmp >= LIBRARY_OFFSET)
+		block = 1 + (tmp - LIBRARY_OFFSET) / BLOCK_SIZE;
+	else
+		block = 1 + tmp / BLOCK_SIZE;
+	for (i = 0 ; i < 4 ; block++, i++)
+		nr[i] = bmap(inode, block);
+	return block - 4;
+}
+
+// 把页面以页表项标志flags映射到线性地址address处.
+// 与put_page()不同,不检查页面的引用计数,用于映射页面缓存中的页面和全零页面.
+static unsigned long map_page(unsigned long page, unsigned long address, unsigned long flags)
+{
+	unsigned long tmp, *page_table;
+
+	page_table = PAGE_DIR_OFFSET(current->tss.cr3, address);
+	if ((*page_table) & 1)
+		page_table = (unsigned long *) (0xfffff000 & *page_table);
+	else {
+		if (!(tmp = get_free_page()))
+			return 0;
+		*page_table = tmp | 7;
+		page_table = (unsigned long *) tmp;
+	}
+	page_table[(address >> 12) & 0x3ff] = page | flags;
+	inc_rss(current);
+	return page;
+}
+
+// 把页面以只读方式映射到线性地址address处.
+// 页面缓存中的页面同时被缓存引用,因此不能用put_page()映射(它要求页面只被引用一次),并且必须是写保护的,写时才复制.全零页面也用它映射.
+static unsigned long put_shared_page(unsigned long page, unsigned long address)
+{
+	return map_page(page, address, 5);
+}
+
+// 映射从文件读入的页面.若页面已加入页面缓存则只读映射,否则与原来一样用put_page()映射.
+static unsigned long put_file_page(unsigned long page, unsigned long address)
+{
+	if (mem_map[MAP_NR(page)] > 1)
+		return put_shared_page(page, address);
+	return put_page(page, address);
+}
+
+// 判断缺页地址address之后的相邻页面能否被预先映射.
+// 相邻页面必须与缺页页面在同一个页表中,其页表项为空(既不存在也不在交换设备中),并且位于执行文件的代码段内或库文件的范围内.数据页面
+// 可能根本不会被访问,因此不预先映射.若可以则返回该页面的页表项指针,否则返回NULL.
+static unsigned long * fault_around_pte(struct m_inode * inode, unsigned long tmp,
+	unsigned long address)
+{
+	unsigned long dir;
+
+	if (!(address & 0x3fffff))
+		return NULL;
+	if (tmp >= LIBRARY_OFFSET) {
+		if (tmp - LIBRARY_OFFSET + BLOCK_SIZE >= inode->i_size)
+			return NULL;
+	} else if (tmp >= current->end_code)
+		return NULL;
+	dir = *PAGE_DIR_OFFSET(current->tss.cr3, address);
+	if (!(dir & 1))
+		return NULL;
+	dir = (0xfffff000 & dir) + ((address >> 10) & 0xffc);
+	if (*(unsigned long *) dir)
+		return NULL;
+	return (unsigned long *) dir;
+}
+
+// 预读缺页页面之后的相邻页面.
+// 在读缺页页面之前先为可以预先映射的相邻页面发出预读请求,这样它们能与缺页页面在同一批磁盘操作中被读入.
+static void prefetch_around(struct m_inode * inode, unsigned long tmp, unsigned long address)
+{
+	int nr[4];
+	int i;
+
+	for (i = 0 ; i < FAULT_AROUND_PAGES ; i++) {
+		tmp += PAGE_SIZE;
+		address += PAGE_SIZE;
+		if (!fault_around_pte(inode, tmp, address))
+			break;
+		file_page_blocks(inode, tmp, nr);
+		prefetch_page(inode->i_dev, nr);
+	}
+}
+
+// 缺页预映射(fault-around).
+// 在处理完逻辑地址tmp(线性地址address)处的缺页后,把其后相邻的代码页面也映射进来,从而减少程序启动时逐页顺序执行代码引起的缺页异常.
+// 只映射不需要额外磁盘操作的页面:能与其他进程共享的页面,或者数据块都已在高速缓冲中(例如刚被prefetch_around()预读)的页面.遇到不
+// 满足条件的页面就停止.
+static void fault_around(struct m_inode * inode, unsigned long tmp, unsigned long address)
+{
+	struct buffer_head * bh;
+	unsigned long page, * pte;
+	int nr[4];
+	int i, j, block;
+
+	for (i = 0 ; i < FAULT_AROUND_PAGES ; i++) {
+		tmp += PAGE_SIZE;
+		address += PAGE_SIZE;
+		if (!fault_around_pte(inode, tmp, address))
+			return;
+		if (share_page(inode, tmp)) {
+			nr_fault_around++;
 			continue;
-		if (address < LIBRARY_OFFSET) {
-			if (inode != (*p)->executable)		// 进程执行文件i节点.
-				continue;
-		} else {
-			if (inode != (*p)->library)			// 进程使用库文件i节点.
-				continue;
 		}
-		if (try_to_share(address, *p))			// 尝试共享页面.
-			return 1;
+		// 页面缓存中有该页面时直接只读映射.
+		block = file_page_blocks(inode, tmp, nr);
+		if (page = find_page_cache(inode, block)) {
+			if (!put_shared_page(page, address)) {
+				free_page(page);
+				return;
+			}
+			nr_fault_around++;
+			continue;
+		}
+		// 检查页面的数据块是否都在高速缓冲中.get_hash_table()会增加缓冲块引用计数,因此检查后要释放.
+		for (j = 0 ; j < 4 ; j++)
+			if (nr[j]) {
+				if (!(bh = get_hash_table(inode->i_dev, nr[j])))
+					return;
+				brelse(bh);
+			}
+		if (!(page = get_free_page_nozero()))
+			return;
+		bread_page(page, inode->i_dev, nr);
+		// 与do_no_page()中一样,把超出执行文件end_data的部分清零.没有被清零的页面只含文件数据,可以加入页面缓存.
+		if (tmp < LIBRARY_OFFSET && (j = tmp + 4096 - current->end_data) > 0)
+			while (j-- > 0)
+				*(char *) (page + 4095 - j) = 0;
+		else
+			add_page_cache(page, inode, block);
+		// 读页面时可能睡眠,需要再检查一下页表项是否仍然为空.
+		if (!(pte = fault_around_pte(inode, tmp, address)) || !put_file_page(page, address)) {
+			free_page(page);
+			return;
+		}
+		nr_fault_around++;
+	}
+}
+
+// 处理mmap()映射区vma中逻辑地址tmp(线性地址address)处的缺页.
+// 共享内存段的页面由shm_nopage()取得(已递增引用计数),直接映射.匿名映射与动态申请的数据页面一样处理.文件映射先在页面缓存中查找,找不到就从文件中读入并加入缓存,超出文件末尾的部分清零.私有映射只读
+// 映射缓存中的页面,写时复制;没能加入缓存的页面只属于本进程,可以直接可写映射.共享映射必须映射缓存中的页面,这样所有映射它的进程看到的
+// 都是同一页面,对它的修改由msync()或解除映射时写回文件.
+// PROT_NONE映射区(没有VM_READ)中的任何访问都是非法的.调用者持有映射区链表锁,因此这里不能直接退出进程,而是返回出错码由调用者解锁后处理:-EFAULT表示非法访问,-ENOMEM表示内存不够.
+static int do_mmap_page(struct vm_area_struct * vma, unsigned long error_code,
+	unsigned long tmp, unsigned long address)
+{
+	struct m_inode * inode = vma->vm_inode;
+	unsigned long page, offset, flags;
+	int nr[4];
+	int block, i;
+
+	if (!(vma->vm_flags & VM_READ) || ((error_code & 2) && !(vma->vm_flags & VM_WRITE)))
+		return -EFAULT;
+	if (vma->vm_shm) {
+		page = shm_nopage(vma, vma->vm_offset + tmp - vma->vm_start);
+		if (!map_page(page, address, (vma->vm_flags & VM_WRITE) ? 7 : 5)) {
+			free_page(page);
+			return -ENOMEM;
+		}
+		return 0;
+	}
+	if (!inode) {
+		if (!(error_code & 2) && put_shared_page(ZERO_PAGE, address)) {
+			nr_zero_page_maps++;
+			return 0;
+		}
+		get_empty_page(address);
+		return 0;
+	}
+	offset = vma->vm_offset + tmp - vma->vm_start;
+	block = offset / BLOCK_SIZE;
+	if (!(page = find_page_cache(inode, block))) {
+		// 文件中的空洞没有对应的逻辑块,bread_page()不读它们,因此用清零的页面.
+		if (!(page = get_free_page()))
+			return -ENOMEM;
+		for (i = 0 ; i < 4 ; i++)
+			nr[i] = bmap(inode, block + i);
+		bread_page(page, inode->i_dev, nr);
+		if (offset + PAGE_SIZE > inode->i_size) {
+			i = (inode->i_size > offset) ? inode->i_size - offset : 0;
+			while (i < PAGE_SIZE)
+				*(char *) (page + i++) = 0;
+		}
+		// 读页面时可能睡眠,期间其他进程可能已把同一页面加入了缓存,共享映射这时要改用缓存中的页面.
+		if (!add_page_cache(page, inode, block) && (vma->vm_flags & VM_SHARED)) {
+			free_page(page);
+			if (!(page = find_page_cache(inode, block))) {
+				printk("do_mmap_page: page cache full\n\r");
+				return -EFAULT;
+			}
+		}
+	}
+	flags = 5;
+	if ((vma->vm_flags & VM_WRITE) &&
+	    ((vma->vm_flags & VM_SHARED) || mem_map[MAP_NR(page)] == 1))
+		flags = 7;
+	if (!map_page(page, address, flags)) {
+		free_page(page);
+		return -ENOMEM;
 	}
 	return 0;
 }
@@ -631,20 +1088,27 @@ void do_no_page(unsigned long error_code, unsigned long address)
 	unsigned long page;
 	int block, i;
 	struct m_inode * inode;
+	struct vm_area_struct * vma;
 
+	nr_no_page_faults++;
 	// 首先判断CPU控制寄存器CR2给出的引起页面异常的线性地址在什么范围中.如果address小于TASK_SIZE(0x4000000,即64MB),表示异常页面位置在内核
 	// 或任务0和任务1所处的线性地址范围内,于是发出警告信息"内核范围内存被写保护";如果(address-当前进程代码起始地址)大于一个进程的长度(64MB),表示
 	// address所指的线性地址不在引起异常的进程线性地址空间范围内,则在发出出错信息后退出
-	if (address < TASK_SIZE)
+	if (address < TASK_BASE)
 		printk("\n\rBAD!! KERNEL PAGE MISSING\n\r");
 	if (address - current->start_code > TASK_SIZE) {
 		printk("Bad things happen: nonexistent page error in do_no_page\n\r");
 		do_exit(SIGSEGV);
 	}
+	// 若进程的驻留页面数已达到RLIMIT_RSS限制,则先换出它自己的一个页面,而不是让别的进程为它付出代价.借用父进程地址空间的vfork()子进程
+	// 和锁定了全部页面的进程除外.换不出页面时仍然继续处理缺页(软限制).
+	if (current->mm->rss >= current->rlim[RLIMIT_RSS].rlim_cur / PAGE_SIZE &&
+	    !(current->flags & (PF_VFORK | PF_MLOCKALL)))
+		swap_out_task(current);
 	// 然后根据指定的线性地址address求出其对应的二级页表项指针,并根据该页表项内容判断address处的页面是否在交换设备中.若是则调入页面并退出.方法是首先
 	// 取指定线性地址address对应的目录项内容.如果对应的二级页表存在,则取出该目录项中二级页表的地址,加上页表项偏移值即得到线性地址address处页面对应的
 	// 页表项指针,从而获得页表项内容.若页表内容不为0并且页表项存在位P=0,则说明该页表项指定的物理页面应该在交换设备中.于是从交换设备中调入指定页面后退出函数.
-	page = *(unsigned long *) ((address >> 20) & 0xffc);				// 取目录项内容.
+	page = *PAGE_DIR_OFFSET(current->tss.cr3, address);				// 取目录项内容.
 	if (page & 1) {
 		page &= 0xfffff000;												// 二级页表地址.
 		page += (address >> 10) & 0xffc;								// 页表项指针.
@@ -658,6 +1122,21 @@ void do_no_page(unsigned long error_code, unsigned long address)
 	// 中或在库文件中的具体起始数据块号.
 	address &= 0xfffff000;												// address处缺页页面地址.
 	tmp = address - current->start_code;								// 缺页页面对应逻辑地址.
+	// 缺页位于mmap()映射区中时由do_mmap_page()处理.处理过程中可能睡眠,因此锁定映射区链表,以免同一地址空间中的其他线程同时解除映射
+	// 而释放映射区.
+	if (current->mm->mmap) {
+		lock_mmap(current->mm);
+		if (vma = find_vma(current, tmp)) {
+			i = do_mmap_page(vma, error_code, tmp, address);
+			unlock_mmap(current->mm);
+			if (i == -ENOMEM)
+				oom();
+			if (i)
+				do_exit(SIGSEGV);
+			return;
+		}
+		unlock_mmap(current->mm);
+	}
 	// 如果缺页对应的逻辑地址tmp大于库映像文件在进程逻辑空间中的起始位置,说明缺少的页面在库映像文件中.于是从当前进程任务数据结构中可以取得库映像文件的i节点library,
 	// 并计算出该缺页在库文件中的起始数据块号block.
 	// 因为设置上存放的执行文件映像第1块数据是程序头结构,因此在读取该文件时需要跳过第1块数据.所以需要首先计算缺页所在数据块号.因为每块数据长度为BLOCK_SIZE = 1KB,因此
@@ -676,22 +1155,42 @@ void do_no_page(unsigned long error_code, unsigned long address)
 		block = 0;
 	}
 	// 若是进程访问其动态申请的页面或为了存放栈信息而引起的缺页异常,则直接申请一页物理内存页面并映射到线性地址address处即可.
+	// 若只是读操作(错误码位1为0),则先只读映射全零页面,等到第一次写入时再由do_wp_page()分配页面.这样只读不写的大数组不占用内存.
 	if (!inode) {														// 是动态申请的数据内存页面.
+		if (!(error_code & 2) && put_shared_page(ZERO_PAGE, address)) {
+			nr_zero_page_maps++;
+			return;
+		}
 		get_empty_page(address);
 		return;
 	}
-	// 否则说明所缺页面进程执行文件或库文件范围内,于是就尝试共享页面操作,若成功则退出.
-	if (share_page(inode, tmp))											// 尝试逻辑地址tmp处页面的共享.
+	// 否则说明所缺页面进程执行文件或库文件范围内,于是就尝试共享页面操作,若成功则再预先映射其后的相邻页面,然后退出.
+	if (share_page(inode, tmp)) {										// 尝试逻辑地址tmp处页面的共享.
+		fault_around(inode, tmp, address);
 		return;
+	}
+	// 再在页面缓存中查找.缓存中只有不需要清零末端的页面,因此只对这样的页面查找.找到就只读映射该页面.
+	if ((tmp >= LIBRARY_OFFSET || tmp + 4096 <= current->end_data) &&
+	    (page = find_page_cache(inode, block))) {
+		if (put_shared_page(page, address)) {
+			fault_around(inode, tmp, address);
+			return;
+		}
+		free_page(page);
+		oom();
+	}
 	// 如果共享不成功就只能申请一页物理内存页面page,然后从设备上读取执行文件中的相应页面并放置(映射)到进程页面逻辑地址tmp处.
-	if (!(page = get_free_page()))										// 申请一页物理内存.
+	// 页面将由bread_page()整页写入,因此不需要清零.
+	if (!(page = get_free_page_nozero()))								// 申请一页物理内存.
 		oom();
 	/* remember that 1 block is used for header */
 	/* 记住,(程序)头要使用1个数据块 */
 	// 根据这个块号和执行文件的i节点,我们就可以从映射位图中找到对应块设备中对应的设备逻辑块号(保存在nr[]数组中).利用break_page()
 	// 即可把这4个逻辑块读入到物理页面page中.
+	// 在读入缺页页面之前,先对随后可以预先映射的相邻页面发出预读请求.
 	for (i = 0 ; i < 4 ; block++, i++)
 		nr[i] = bmap(inode, block);
+	prefetch_around(inode, tmp, address);
 	bread_page(page, inode->i_dev, nr);
 	// 在读设备逻辑块操作时,可能会出现这样一种情况,即在执行文件中的读取页面位置可能离文件尾不到1个页面的长度.因此就可能读入一些无用
 	// 的信息.下面的操作就是把这部分超出执行文件end_data以后的部分进行清零处理.当然,若该页面离末端超过1页,说明不是从执行文件映像中
@@ -699,14 +1198,20 @@ void do_no_page(unsigned long error_code, unsigned long address)
 	i = tmp + 4096 - current->end_data;									// 超出的字节长度值.
 	if (i > 4095)														// 离末端超过1页则不用清零.
 		i = 0;
+	// 不需要清零的代码页面或库页面只含文件数据,把它加入页面缓存,供以后运行同一程序时使用.
+	if (i <= 0 && (tmp < current->end_code || tmp >= LIBRARY_OFFSET))
+		add_page_cache(page, inode, block - 4);
 	tmp = page + 4096;
 	while (i-- > 0) {
 		tmp--;															// tmp指向页面末端.
 		*(char *)tmp = 0;       										// 页面末端i字节清零.
 	}
-	// 最后把引起缺页异常的一页物理页面映射到指定线性地址address处.若操作成功就返回.否则就释放内存页,显示内存不够.
-	if (put_page(page, address))
+	// 最后把引起缺页异常的一页物理页面映射到指定线性地址address处,并预先映射其后已读入高速缓冲的相邻页面.若操作成功就返回.否则就释放
+	// 内存页,显示内存不够.
+	if (put_file_page(page, address)) {
+		fault_around(inode, address - current->start_code, address);
 		return;
+	}
 	free_page(page);
 	oom();
 }
@@ -720,14 +1225,71 @@ void do_no_page(unsigned long error_code, unsigned long address)
 // 只使用0~640KB,剩下的部分被部分高速缓冲和设备内存占用).
 // 参数start_mem是可用作页面分配的主内存区起始地址(已去除RAMDISK所占内存空间).end_mem是实际物理内存最大地址.而地址范围start_mem到
 // end_mem是主内存区.
-void mem_init(long start_mem, long end_mem)
+// 现在最多支持1GB内存:16MB以上内存的内核页表以及mem_map[]本身都从主内存区开始处分配,函数返回扣除它们之后的主内存区开始地址.
+long mem_init(long start_mem, long end_mem)
 {
 	int i;
+	unsigned long flags, old_flags, features = 0;
+	unsigned long addr, global = 0, * pg_table = NULL;
 
-	// 首先将1MB到16MB范围内所有内存页面对应的内存映射字节数组项置为已占用状态,即各项字节值全部设置成USED(100).PAGING_PAGES被定义为(
-	// PAGING_MEMORY>>12),即1MB以上所有物理内存分页后的内存页面数(15MB/4KB = 3840).
-	HIGH_MEMORY = end_mem;									// 设置内存最高端(16MB).
-	for (i = 0; i < PAGING_PAGES; i++)
+	// 首先检测CPU是否是486或以后的处理器,即是否支持invlpg指令.方法是测试能否改变标志寄存器中的AC位(位18),386上该位不能被设置.
+	__asm__("pushfl ; popl %0 ; movl %0, %1 ; xorl $0x40000, %0\n\t"
+		"pushl %0 ; popfl ; pushfl ; popl %0 ; pushl %1 ; popfl"
+		:"=&r" (flags), "=&r" (old_flags));
+	invlpg_ok = ((flags ^ old_flags) & 0x40000) != 0;
+	// 486及以后的CPU还有cr0中的写保护位WP(位16).置位后内核态写用户空间只读页面时同样会引起写保护异常,由do_wp_page()进行写时复制,
+	// verify_area()就不必再逐页预先检查了.386上该位不存在,仍然使用verify_area().
+	if (invlpg_ok) {
+		__asm__ __volatile__("movl %%cr0,%%eax ; orl $0x10000,%%eax ; movl %%eax,%%cr0":::"ax");
+		wp_works_ok = 1;
+	}
+	// 再看能否改变标志寄存器中的ID位(位21).若能则CPU支持cpuid指令,用它取得CPU特性标志:位3是PSE(4MB页面),位13是PGE(全局页面).
+	__asm__("pushfl ; popl %0 ; movl %0, %1 ; xorl $0x200000, %0\n\t"
+		"pushl %0 ; popfl ; pushfl ; popl %0 ; pushl %1 ; popfl"
+		:"=&r" (flags), "=&r" (old_flags));
+	if ((flags ^ old_flags) & 0x200000) {
+		__asm__("cpuid":"=a" (i):"0" (0):"bx","cx","dx");
+		if (i >= 1)
+			__asm__("cpuid":"=d" (features):"a" (1):"bx","cx");
+	}
+	pse_ok = (features & 0x08) != 0;
+	pge_ok = pse_ok && (features & 0x2000);
+	// 若CPU支持4MB页面,则置位cr4中的PSE位(位4),并把head.s为前16MB建立的内核页表换成4MB页面的页目录项.若还支持全局页面,则这些目录项
+	// 同时设置全局位,在最后置位cr4中的PGE位(位7).
+	if (pse_ok) {
+		__asm__ __volatile__("movl %%cr4,%%eax ; orl $0x10,%%eax ; movl %%eax,%%cr4":::"ax");
+		if (pge_ok)
+			global = PAGE_GLOBAL;
+		for (i = 0; i < 4; i++)
+			pg_dir[i] = (i << 22) | PAGE_4M | global | 7;
+	}
+	// 然后为16MB以上的内存建立内核恒等映射.head.s只映射了前16MB,这里完整的4MB内存在支持4MB页面时直接使用4MB页面,其余的每4MB从
+	// 主内存区开始处取一页作为页表(主内存区开始处在16MB以下,已被映射),并填入页目录中.页表项属性与head.s中的相同.
+	start_mem = (start_mem + 4095) & ~4095;
+	for (addr = 16 * 1024 * 1024; addr < end_mem; addr += 4096) {
+		if (!(addr & 0x3fffff)) {
+			if (pse_ok && addr + 0x400000 <= end_mem) {
+				pg_dir[addr >> 22] = addr | PAGE_4M | global | 7;
+				addr += 0x400000 - 4096;
+				continue;
+			}
+			pg_table = (unsigned long *) start_mem;
+			start_mem += 4096;
+			for (i = 0; i < 1024; i++)
+				pg_table[i] = 0;
+			pg_dir[addr >> 22] = (unsigned long) pg_table | 7;
+		}
+		pg_table[(addr >> 12) & 1023] = addr | global | 7;
+	}
+	invalidate();
+	if (pge_ok)
+		__asm__ __volatile__("movl %%cr4,%%eax ; orl $0x80,%%eax ; movl %%eax,%%cr4":::"ax");
+	// 然后在主内存区开始处分配mem_map[],每个1MB以上的物理页面占1字节,并将其所有项置为已占用状态,即各项字节值全部设置成USED(100).
+	HIGH_MEMORY = end_mem;									// 设置内存最高端.
+	paging_pages = (end_mem - LOW_MEM) >> 12;				// 1MB以上物理内存的页面数.
+	mem_map = (unsigned char *) start_mem;
+	start_mem = (start_mem + paging_pages + 4095) & ~4095;
+	for (i = 0; i < paging_pages; i++)
 		mem_map[i] = USED;
 	// 然后计算主内存区起始内存start_mem处页面对应内存映射字节数组中项号i和主内存区页面数.此时mem_map[]数组的第i项正对应主内存区中第1个页面.
 	// 最后将主内存区中页面对应的数组项清零(表示空闲).对于具有16MB物理内存的系统,mem_map[]中对应4MB~16MB主内存区的项被清零.
@@ -738,6 +1300,15 @@ void mem_init(long start_mem, long end_mem)
 	// 将主内存区对应的页面数的应用数置零
 	while (end_mem-- > 0)
 		mem_map[i++] = 0;									// 主内存区页面对应字节值清零.
+	return start_mem;
+}
+
+// 把物理地址addr处的页面标记为已占用,它将永远不会被分配.
+// 用于BIOS内存分布图中不可用的区域(内存空洞,ACPI表等).只能在mem_init()之后,分配任何页面之前调用.
+void reserve_page(unsigned long addr)
+{
+	if (addr >= LOW_MEM && addr < HIGH_MEMORY)
+		mem_map[MAP_NR(addr)] = USED;
 }
 
 // 显示系统内存信息.
@@ -746,13 +1317,14 @@ void mem_init(long start_mem, long end_mem)
 // 即当按下"Shift + Scroll Lock"组合键时会显示系统内存统计信息.
 void show_mem(void)
 {
-	int i, j, k, free = 0, total = 0;
+	int i, j, k, n, free = 0, total = 0;
 	int shared = 0;
-	unsigned long * pg_tbl;
+	unsigned long * pg_tbl, * dir;
+	struct task_struct * p;
 
 	// 根据内存映射字节数组mem_map[],统计系统主内存区页面总数total,以及其中空闲页面数free和被共享的页面数shared.并显示这些信息.
 	printk("Mem-info:\n\r");
-	for(i = 0 ; i < PAGING_PAGES ; i++) {
+	for(i = 0 ; i < paging_pages ; i++) {
 		if (mem_map[i] == USED)								// 1MB以上内存系统占用的页面.
 			continue;
 		// 统计主内存中的页面数
@@ -766,23 +1338,29 @@ void show_mem(void)
 	}
 	printk("%d free pages of %d\n\r", free, total);
 	printk("%d pages shared\n\r", shared);
-	// 统计处理器分页管理逻辑页面数.页目录表前4项供内核代码使用,不列为统计范围,因此扫描处理的页目录项从第5项开始.方法是循环处理所有页目录项
-	// (除前4个项),若对应的二级页表存在,那么先统计二级页表本身占用的内存页面,然后对该页表中所有页表项对应页面情况进行统计.
-	k = 0;													// 一个进程占用页面统计值.
-	for(i = 4 ; i < 1024 ;) {
-		if (1 & pg_dir[i]) {
+	// 统计处理器分页管理逻辑页面数.每个任务有自己的页目录,其中TASK_BASE以下的目录项是所有任务共用的内核页表,不列为统计范围.方法是
+	// 对每个任务(除任务0)循环处理其页目录中的用户空间目录项,若对应的二级页表存在,那么先统计二级页表本身占用的内存页面,然后对该页表中所有
+	// 页表项对应页面情况进行统计.与属主共用地址空间的vfork()子进程和线程不重复统计.
+	for (n = 1 ; n < NR_TASKS ; n++) {
+		if (!(p = task[n]) || !mm_owner(p))
+			continue;
+		k = 0;												// 一个进程占用页面统计值.
+		dir = (unsigned long *) p->tss.cr3;
+		for (i = TASK_BASE >> 22 ; i < 1024 ; i++) {
+			if (!(1 & dir[i]))
+				continue;
 			// (如果页目录项对应二级页表地址大于机器最高物理内存地址HIGH_MEMORY,说明该目录项有问题.于是显示该目录项信息并继续处理下一个目录项.
-			if (pg_dir[i] > HIGH_MEMORY) {					// 目录项内容不正常.
+			if (dir[i] > HIGH_MEMORY) {						// 目录项内容不正常.
 				printk("page directory[%d]: %08X\n\r",
-					i, pg_dir[i]);
+					i, dir[i]);
 				continue;
 			}
 			// 如果页目录项对应二级页表的"地址"大于LOW_MEM(即1MB),则把一个进程占用的物理内存页统计值k增1,把系统占用的所有物理内存页统计值free增1.
 			// 然后邓对应页表地址pg_tb1,并对该页表中所有页表项进行统计.如果当前页表项所指物理页面存在并且该物理页面"地址"大于LOW_MEME,那么就将页表项对应页面
 			// 纳入统计值.
-			if (pg_dir[i] > LOW_MEM)
+			if (dir[i] > LOW_MEM)
 				free++, k++;								// 统计页表占用页面.
-			pg_tbl = (unsigned long *) (0xfffff000 & pg_dir[i]);
+			pg_tbl = (unsigned long *) (0xfffff000 & dir[i]);
 			for(j = 0 ; j < 1024 ; j++)
 				if ((pg_tbl[j]&1) && pg_tbl[j] > LOW_MEM)
 					// (若该物理页面地址大于机器最高物理内存地址HIGH_MEMORY,则说明该页表项内容有问题,于是显示该页表项内容.否则将页表项对应页面纳入统计值.)
@@ -792,15 +1370,23 @@ void show_mem(void)
 					else
 						k++, free++;						// 统计责表项对应页面.
 		}
-		// 因每个任务线性空间长度是64MB,所以一个任务占用16个目录项.因此这每统计了16个目录项就把进程的任务结构占用的页表统计进来.若此时k=0则表示当前的16个页
-		// 目录所对应的进程在系统中不存在(没有创建或者已经终止).在显示了对应进程号和其占用的物理内存页统计值k后,将k清零,以用于统计下一个进程占用的内存页面数.
-		i++;
-		if (!(i & 15) && k) {
-			k++, free++;									/* one page/process for task_struct */
-			printk("Process %d: %d pages\n\r", (i >> 4) - 1, k);
-			k = 0;
-		}
+		// 最后把进程的任务结构和页目录占用的页面统计进来,并显示对应进程号和其占用的物理内存页统计值k.
+		k += 2, free += 2;									/* task_struct and page directory */
+		printk("Process %d: %d pages (rss %d, max %d)\n\r", n, k, p->mm->rss, p->mm->max_rss);
 	}
 	// 最后显示系统中正在使用的内存页面和主内存区中总的内存页面数.
 	printk("Memory found: %d (%d)\n\r\n\r", free - shared, total);
+	printk("Page faults: %d no-page, %d write-protect, %d pages mapped around, %d zero pages\n\r",
+		nr_no_page_faults, nr_wp_faults, nr_fault_around, nr_zero_page_maps);
+	printk("Zeroed free pages: %d\n\r", nr_zeroed_pages);
+	printk("TLB flushes: %d full, %d single page%s\n\r", tlb_full_flushes,
+		tlb_page_flushes, invlpg_ok ? "" : " (no invlpg)");
+	printk("Kernel mapping: %s pages%s%s\n\r", pse_ok ? "4MB" : "4KB",
+		pge_ok ? ", global" : "", wp_works_ok ? ", write-protected user pages" : "");
+	page_cache_show();
+	kmem_cache_show();
+	ksm_show();
+	shm_show();
+	// 显示压缩交换缓存的压缩比和页面池使用情况.
+	zswap_show();
 }
@@ -0,0 +1,227 @@
+/*
+ *  linux/mm/mlock.c
+ *
+ *  (C) 1991  Linus Torvalds
+ */
+
+/*
+ * Locking pages in memory. mlock() faults the pages in, makes them
+ * private and writable (so that no copy-on-write fault is left to take
+ * later) and marks their page table entries with PAGE_LOCKED, which
+ * try_to_swap_out() checks before anything else. Pages of mappings
+ * without PROT_WRITE are only faulted in for reading. mlockall(MCL_FUTURE)
+ * just flags the task, and swap_out() skips flagged tasks as a whole.
+ *
+ * The number of locked pages is kept in the task structure and limited
+ * by RLIMIT_MEMLOCK. Locks are not inherited by fork() and are dropped
+ * by exec().
+ */
+/*
+ * 把页面锁定在内存中.mlock()先把页面调入内存,并使其成为私有可写页面(以后就不会再发生写时复制异常),然后在页表项中设置PAGE_LOCKED
+ * 标志,try_to_swap_out()最先检查该标志.没有PROT_WRITE权限的映射区中的页面只按读访问调入.mlockall(MCL_FUTURE)只是给任务设置一个标志,swap_out()会整个跳过有该标志的任务.
+ *
+ * 锁定的页面数记录在任务结构中,并受RLIMIT_MEMLOCK限制.fork()的子进程不继承锁定,exec()时解除锁定.
+ */
+
+#include <errno.h>
+#include <sys/mman.h>
+
+#include <linux/sched.h>
+#include <linux/mm.h>
+#include <linux/kernel.h>
+
+extern void write_verify(unsigned long address);
+extern void unshare_page_table(unsigned long * dir);
+extern void do_no_page(unsigned long error_code, unsigned long address);
+
+// 取当前进程线性地址address的页表项指针,页表可以是共享的.调用者需保证页表存在.
+static inline unsigned long * table_pte(unsigned long address)
+{
+	return (unsigned long *) (0xfffff000 & *PAGE_DIR_OFFSET(current->tss.cr3, address)) +
+		((address >> 12) & 0x3ff);
+}
+
+// 取当前进程线性地址address的页表项指针.若页表不存在或仍与其他进程共享(目录项只读),则返回NULL.
+static unsigned long * private_pte(unsigned long address)
+{
+	unsigned long * dir = PAGE_DIR_OFFSET(current->tss.cr3, address);
+
+	if ((*dir & 3) != 3)
+		return NULL;
+	return table_pte(address);
+}
+
+// 判断当前进程再锁定pages个页面后是否会超出RLIMIT_MEMLOCK.超级用户不受限制.
+static int memlock_ok(unsigned long pages)
+{
+	unsigned long limit = current->rlim[RLIMIT_MEMLOCK].rlim_cur;
+
+	if (suser() || limit == RLIM_INFINITY)
+		return 1;
+	return current->locked_pages + pages <= limit / PAGE_SIZE;
+}
+
+// 锁定当前进程线性地址address处的页面.
+// 页面不存在时先调入(按写访问处理,因此不会映射全零页面);页面只读或页表仍被共享时用write_verify()复制一份私有的.这两个操作都可能
+// 睡眠,期间页面可能又被交换出去,所以每次都重新检查,直到页面存在,可写并且页表私有时才设置锁定标志.
+// 没有PROT_WRITE权限的映射区中的页面不能写,因此按读访问调入,只复制共享的页表,页面本身保持只读.PROT_NONE映射区中的页面不能访问,
+// 调入它会使进程收到SIGSEGV,因此跳过不锁定.
+static void lock_page(unsigned long address)
+{
+	struct vm_area_struct * vma = NULL;
+	unsigned long * dir, * pte;
+	int writable;
+
+	if (current->mm->mmap)
+		vma = find_vma(current, address - current->start_code);
+	if (vma && !(vma->vm_flags & VM_READ))
+		return;
+	writable = !vma || (vma->vm_flags & VM_WRITE);
+	for (;;) {
+		dir = PAGE_DIR_OFFSET(current->tss.cr3, address);
+		if ((*dir & 3) == 1) {
+			if (writable)
+				write_verify(address);
+			else
+				unshare_page_table(dir);
+			continue;
+		}
+		pte = private_pte(address);
+		if (!pte || !(*pte & PAGE_PRESENT)) {
+			do_no_page(writable ? (PAGE_USER | PAGE_RW) : PAGE_USER, address);
+			continue;
+		}
+		if (writable && !(*pte & PAGE_RW)) {
+			write_verify(address);
+			continue;
+		}
+		break;
+	}
+	if (!(*pte & PAGE_LOCKED)) {
+		*pte |= PAGE_LOCKED;
+		current->locked_pages++;
+	}
+}
+
+// 解除当前进程线性地址address处页面的锁定.PAGE_LOCKED是留给软件使用的位,CPU不使用它,因此不必刷新页变换高速缓冲.
+static void unlock_page(unsigned long address)
+{
+	unsigned long * pte = private_pte(address);
+
+	if (pte && (*pte & PAGE_LOCKED)) {
+		*pte &= ~PAGE_LOCKED;
+		if (current->locked_pages)
+			current->locked_pages--;
+	}
+}
+
+// 判断当前进程线性地址address处的页面是否已被锁定.
+static int page_locked(unsigned long address)
+{
+	unsigned long * pte = private_pte(address);
+
+	return pte && (*pte & PAGE_PRESENT) && (*pte & PAGE_LOCKED);
+}
+
+// 把进程逻辑地址范围[addr, addr+len)换算成页面对齐的线性地址范围[*start, *end).范围超出数据段时返回-EINVAL.
+static int lock_range(unsigned long addr, size_t len, unsigned long * start, unsigned long * end)
+{
+	if (addr + len < addr || addr + len > get_limit(0x17))
+		return -EINVAL;
+	*start = current->start_code + (addr & 0xfffff000);
+	*end = current->start_code + ((addr + len + 0xfff) & 0xfffff000);
+	return 0;
+}
+
+// 系统调用mlock().锁定进程逻辑地址范围[addr, addr+len)中的页面,使其不会被交换出去.
+// 先统计范围中还没有锁定的页面数,若锁定后超出RLIMIT_MEMLOCK则返回-ENOMEM.
+int sys_mlock(unsigned long addr, size_t len)
+{
+	unsigned long start, end, address, pages = 0;
+	int err;
+
+	if (err = lock_range(addr, len, &start, &end))
+		return err;
+	for (address = start ; address < end ; address += PAGE_SIZE)
+		if (!page_locked(address))
+			pages++;
+	if (!memlock_ok(pages))
+		return -ENOMEM;
+	for (address = start ; address < end ; address += PAGE_SIZE)
+		lock_page(address);
+	return 0;
+}
+
+// 系统调用munlock().解除进程逻辑地址范围[addr, addr+len)中页面的锁定.
+int sys_munlock(unsigned long addr, size_t len)
+{
+	unsigned long start, end, address;
+	int err;
+
+	if (err = lock_range(addr, len, &start, &end))
+		return err;
+	for (address = start ; address < end ; address += PAGE_SIZE)
+		unlock_page(address);
+	return 0;
+}
+
+// 系统调用mlockall().
+// MCL_CURRENT锁定进程当前已在内存中的所有页面;MCL_FUTURE给进程设置PF_MLOCKALL标志,swap_out()不再扫描该进程,因此以后映射的页面
+// 也不会被交换出去.由于以后的页面数无法预先统计,非超级用户只有在RLIMIT_MEMLOCK没有限制时才能使用MCL_FUTURE.
+int sys_mlockall(int flags)
+{
+	unsigned long address, end, pages = 0, * pte;
+
+	if (!flags || (flags & ~(MCL_CURRENT | MCL_FUTURE)))
+		return -EINVAL;
+	if ((flags & MCL_FUTURE) && !suser() &&
+	    current->rlim[RLIMIT_MEMLOCK].rlim_cur != RLIM_INFINITY)
+		return -ENOMEM;
+	end = current->start_code + get_limit(0x17);
+	if (flags & MCL_CURRENT) {
+		// 先统计在内存中但还没有锁定的页面数.跳过页表不存在的整个目录项.
+		for (address = current->start_code ; address < end ; address += PAGE_SIZE) {
+			if (!(1 & *PAGE_DIR_OFFSET(current->tss.cr3, address))) {
+				address |= 0x3ff000;
+				continue;
+			}
+			pte = table_pte(address);
+			if ((*pte & PAGE_PRESENT) && !(*pte & PAGE_LOCKED))
+				pages++;
+		}
+		if (!memlock_ok(pages))
+			return -ENOMEM;
+		for (address = current->start_code ; address < end ; address += PAGE_SIZE) {
+			if (!(1 & *PAGE_DIR_OFFSET(current->tss.cr3, address))) {
+				address |= 0x3ff000;
+				continue;
+			}
+			pte = table_pte(address);
+			if (*pte & PAGE_PRESENT)
+				lock_page(address);
+		}
+	}
+	if (flags & MCL_FUTURE)
+		current->flags |= PF_MLOCKALL;
+	else
+		current->flags &= ~PF_MLOCKALL;
+	return 0;
+}
+
+// 系统调用munlockall().清除进程的PF_MLOCKALL标志,并解除其所有页面的锁定.
+int sys_munlockall(void)
+{
+	unsigned long address, end;
+
+	current->flags &= ~PF_MLOCKALL;
+	end = current->start_code + get_limit(0x17);
+	for (address = current->start_code ; address < end ; address += PAGE_SIZE) {
+		if (!(1 & *PAGE_DIR_OFFSET(current->tss.cr3, address))) {
+			address |= 0x3ff000;
+			continue;
+		}
+		unlock_page(address);
+	}
+	current->locked_pages = 0;
+	return 0;
+}
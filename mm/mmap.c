@@ -0,0 +1,394 @@
+/*
+ *  linux/mm/mmap.c
+ *
+ *  (C) 1991  Linus Torvalds
+ */
+
+/*
+ * Memory mappings. mmap() only records an area in the task's list of
+ * mappings - pages are brought in by do_no_page() when first touched,
+ * through the page cache for file mappings. Private file mappings are
+ * copy-on-write just like executable pages. Shared mappings map the
+ * cached page itself, so all tasks see each other's changes, and dirty
+ * pages are written back to the file by msync() and when the mapping
+ * goes away (munmap(), exit() or exec()).
+ *
+ * Mappings live in a fixed window of the address space (MMAP_BASE to
+ * MMAP_END), between the brk() heap and the stack. Shared anonymous
+ * mappings are not supported. The file is not kept coherent with
+ * write(): a write() drops the file's pages from the page cache, so
+ * tasks that have it mapped shared keep their old pages.
+ *
+ * Threads share the list of mappings, and both unmapping and faulting
+ * a page in can sleep. Anything that changes the list, or uses an area
+ * across a sleep, holds the mm's mmap_lock.
+ */
+/*
+ * 内存映射.mmap()只是在任务的映射区链表中记录一个映射区,页面在第一次被访问时由do_no_page()调入,文件映射的页面经过页面缓存.私有
+ * 文件映射与执行文件页面一样写时复制.共享映射直接映射缓存中的页面,因此所有任务都能看到彼此的修改,已修改的页面由msync()以及在映射
+ * 被解除时(munmap(),exit()或exec())写回文件.
+ *
+ * 映射区位于地址空间中固定的一段(MMAP_BASE到MMAP_END),在brk()堆和栈之间.不支持共享的匿名映射.文件内容与write()不保持一致:
+ * write()会把文件的页面从页面缓存中丢弃,共享映射了该文件的任务仍然使用原来的页面.
+ *
+ * 线程共享映射区链表,而解除映射和调入页面都可能睡眠.修改链表或跨睡眠使用映射区时都要持有地址空间的mmap_lock.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include <linux/sched.h>
+#include <linux/mm.h>
+#include <linux/kernel.h>
+#include <asm/segment.h>
+#include <asm/system.h>
+
+static struct kmem_cache * vm_area_cachep;		// 映射区结构的对象缓存.
+
+// 初始化映射区结构的对象缓存.在init/main.c中被调用.
+void mmap_init(void)
+{
+	vm_area_cachep = kmem_cache_create("vm_area", sizeof(struct vm_area_struct), 0);
+}
+
+// 锁定地址空间mm的映射区链表.
+void lock_mmap(struct mm_struct * mm)
+{
+	cli();
+	while (mm->mmap_lock)
+		sleep_on(&mm->mmap_wait);
+	mm->mmap_lock = 1;
+	sti();
+}
+
+// 对映射区链表解锁.
+void unlock_mmap(struct mm_struct * mm)
+{
+	mm->mmap_lock = 0;
+	wake_up(&mm->mmap_wait);
+}
+
+// 取任务p中包含逻辑地址addr的映射区.链表按地址排序,越过addr就可以停止查找.没有则返回NULL.
+struct vm_area_struct * find_vma(struct task_struct * p, unsigned long addr)
+{
+	struct vm_area_struct * vma;
+
+	for (vma = p->mm->mmap ; vma && vma->vm_start <= addr ; vma = vma->vm_next)
+		if (addr < vma->vm_end)
+			return vma;
+	return NULL;
+}
+
+// 映射区被复制(fork()或分成两个)时,递增它所引用的文件i节点或共享内存段的引用计数.
+static void open_vma(struct vm_area_struct * vma)
+{
+	if (vma->vm_inode)
+		vma->vm_inode->i_count++;
+	if (vma->vm_shm)
+		shm_open(vma);
+}
+
+// 释放映射区结构,同时放回它所引用的文件i节点或共享内存段.
+static void free_vma(struct vm_area_struct * vma)
+{
+	iput(vma->vm_inode);
+	if (vma->vm_shm)
+		shm_close(vma);
+	kmem_cache_free(vm_area_cachep, vma);
+}
+
+// 把页面page的内容写回文件inode中偏移offset处.
+// 只写到文件末尾为止,映射不改变文件长度.页面超出文件末尾的部分在读入时已被清零.
+static void write_back_page(struct m_inode * inode, unsigned long offset, unsigned long page)
+{
+	struct buffer_head * bh;
+	int i, block;
+
+	for (i = 0 ; i < 4 && offset < inode->i_size ; i++) {
+		if (!(block = create_block(inode, offset / BLOCK_SIZE)))
+			break;
+		if (!(bh = bread(inode->i_dev, block)))
+			break;
+		memcpy(bh->b_data, (char *) page, BLOCK_SIZE);
+		bh->b_dirt = 1;
+		brelse(bh);
+		offset += BLOCK_SIZE;
+		page += BLOCK_SIZE;
+	}
+	inode->i_mtime = CURRENT_TIME;
+	inode->i_dirt = 1;
+}
+
+// 把当前进程共享文件映射区vma中逻辑地址范围[start, end)内已修改的页面写回文件.
+// 先清除页表项中的已修改标志再写,写的过程中又被修改的页面会重新被标记.写回时会睡眠,因此先递增页面的引用计数.共享映射的页面都在
+// 页面缓存中,已修改的页面不会被交换出去.
+static void sync_area(struct vm_area_struct * vma, unsigned long start, unsigned long end)
+{
+	unsigned long address, page, * dir, * pte;
+
+	if (!(vma->vm_flags & VM_SHARED) || !vma->vm_inode)
+		return;
+	for ( ; start < end ; start += PAGE_SIZE) {
+		address = current->start_code + start;
+		dir = PAGE_DIR_OFFSET(current->tss.cr3, address);
+		if (!(*dir & 1)) {
+			start |= 0x3ff000;
+			continue;
+		}
+		pte = (unsigned long *) (0xfffff000 & *dir) + ((address >> 12) & 0x3ff);
+		if ((*pte & (PAGE_DIRTY | PAGE_PRESENT)) != (PAGE_DIRTY | PAGE_PRESENT))
+			continue;
+		page = 0xfffff000 & *pte;
+		if (page < LOW_MEM || page >= HIGH_MEMORY)
+			continue;
+		*pte &= ~PAGE_DIRTY;
+		invalidate_page(address);
+		mem_map[MAP_NR(page)]++;
+		write_back_page(vma->vm_inode, vma->vm_offset + start - vma->vm_start, page);
+		free_page(page);
+	}
+}
+
+// 解除当前进程逻辑地址范围[start, end)内的映射.调用者持有映射区链表锁.
+// 与范围相交的映射区先写回已修改的共享页面并释放页面,然后整个删除,或从头部,尾部截掉一段,或从中间分成两个.分成两个时需要一个新的映射区
+// 结构,它在修改链表之前预先分配,因此以后的操作不会失败.
+int do_munmap(unsigned long start, unsigned long end)
+{
+	struct vm_area_struct ** p, * vma, * new = NULL;
+	unsigned long s, e;
+
+	for (vma = current->mm->mmap ; vma && vma->vm_start < end ; vma = vma->vm_next)
+		if (vma->vm_start < start && vma->vm_end > end) {
+			if (!(new = kmem_cache_alloc(vm_area_cachep, GFP_KERNEL)))
+				return -ENOMEM;
+			break;
+		}
+	p = &current->mm->mmap;
+	while ((vma = *p) && vma->vm_start < end) {
+		if (vma->vm_end <= start) {
+			p = &vma->vm_next;
+			continue;
+		}
+		s = (vma->vm_start > start) ? vma->vm_start : start;
+		e = (vma->vm_end < end) ? vma->vm_end : end;
+		sync_area(vma, s, e);
+		zap_page_range(current->start_code + s, e - s);
+		if (s == vma->vm_start && e == vma->vm_end) {
+			*p = vma->vm_next;
+			free_vma(vma);
+			continue;
+		}
+		if (s == vma->vm_start) {
+			vma->vm_offset += e - vma->vm_start;
+			vma->vm_start = e;
+		} else if (e == vma->vm_end)
+			vma->vm_end = s;
+		else {
+			*new = *vma;
+			new->vm_start = e;
+			new->vm_offset += e - vma->vm_start;
+			open_vma(new);
+			vma->vm_end = s;
+			vma->vm_next = new;
+			vma = new;
+			new = NULL;
+		}
+		p = &vma->vm_next;
+	}
+	kmem_cache_free(vm_area_cachep, new);
+	return 0;
+}
+
+// 在映射区范围内找一段长度为len的空闲地址,返回其开始地址.没有则返回0.
+static unsigned long get_unmapped_area(unsigned long len)
+{
+	struct vm_area_struct * vma;
+	unsigned long addr = MMAP_BASE;
+
+	for (vma = current->mm->mmap ; vma ; vma = vma->vm_next) {
+		if (addr + len <= vma->vm_start)
+			break;
+		if (vma->vm_end > addr)
+			addr = vma->vm_end;
+	}
+	if (addr + len > MMAP_END)
+		return 0;
+	return addr;
+}
+
+// 在当前进程中建立映射区[addr, addr+len),返回其地址或出错码.调用者持有映射区链表锁.
+// len已页面对齐.fixed不为0时映射在addr处,并先解除该范围内原有的映射;否则由get_unmapped_area()选择地址.映射区引用文件i节点inode
+// (从文件偏移off处开始)或共享内存段shm(从段内偏移off处开始),两者都为NULL时是匿名映射.
+int do_mmap(unsigned long addr, unsigned long len, int vm_flags, int fixed,
+	struct m_inode * inode, unsigned long off, struct shm_seg * shm)
+{
+	struct vm_area_struct * vma, ** p;
+	int err;
+
+	if (fixed) {
+		if ((addr & 0xfff) || addr < MMAP_BASE || addr > MMAP_END - len)
+			return -EINVAL;
+	} else if (!(addr = get_unmapped_area(len)))
+		return -ENOMEM;
+	if (!(vma = kmem_cache_alloc(vm_area_cachep, GFP_KERNEL)))
+		return -ENOMEM;
+	if (fixed && (err = do_munmap(addr, addr + len))) {
+		kmem_cache_free(vm_area_cachep, vma);
+		return err;
+	}
+	vma->vm_start = addr;
+	vma->vm_end = addr + len;
+	vma->vm_offset = off;
+	vma->vm_inode = inode;
+	vma->vm_shm = shm;
+	vma->vm_flags = vm_flags;
+	open_vma(vma);
+	for (p = &current->mm->mmap ; *p && (*p)->vm_start < addr ; p = &(*p)->vm_next)
+		/* nothing */ ;
+	vma->vm_next = *p;
+	*p = vma;
+	return addr;
+}
+
+// 系统调用mmap().
+// 系统调用最多只能用寄存器传递3个参数,因此6个参数(addr, len, prot, flags, fd, offset)放在用户空间的数组buffer中.成功时返回映射区
+// 的逻辑地址,否则返回出错码.映射区都在MMAP_BASE之上,MMAP_END不超过2GB,因此地址不会被当作负的出错码.
+// 借用父进程地址空间的vfork()子进程不能建立映射,它很快就要执行execve()或退出,映射只会留给睡眠中的父进程.线程则可以.
+int sys_mmap(unsigned long * buffer)
+{
+	unsigned long addr, len, prot, flags, fd, off;
+	struct m_inode * inode = NULL;
+	struct file * file;
+
+	addr = get_fs_long(buffer);
+	len = get_fs_long(buffer + 1);
+	prot = get_fs_long(buffer + 2);
+	flags = get_fs_long(buffer + 3);
+	fd = get_fs_long(buffer + 4);
+	off = get_fs_long(buffer + 5);
+	if (current->flags & PF_VFORK)
+		return -EINVAL;
+	if (!len || len > MMAP_END - MMAP_BASE || (off & 0xfff) ||
+	    (prot & ~(PROT_READ | PROT_WRITE | PROT_EXEC)))
+		return -EINVAL;
+	len = (len + 0xfff) & 0xfffff000;
+	if ((flags & (MAP_SHARED | MAP_PRIVATE)) != MAP_SHARED &&
+	    (flags & (MAP_SHARED | MAP_PRIVATE)) != MAP_PRIVATE)
+		return -EINVAL;
+	// 文件映射要求文件是可读的普通文件;可写的共享映射会修改文件,还要求文件是以读写方式打开的.
+	if (flags & MAP_ANONYMOUS) {
+		if (flags & MAP_SHARED)
+			return -EINVAL;
+		off = 0;
+	} else {
+		if (fd >= NR_OPEN || !(file = current->files->fd[fd]))
+			return -EBADF;
+		inode = file->f_inode;
+		if (!inode || !S_ISREG(inode->i_mode))
+			return -EACCES;
+		if ((file->f_flags & O_ACCMODE) == O_WRONLY)
+			return -EACCES;
+		if ((flags & MAP_SHARED) && (prot & PROT_WRITE) &&
+		    (file->f_flags & O_ACCMODE) != O_RDWR)
+			return -EACCES;
+	}
+	// 页表项不能区分读和写或执行权限,可写或可执行的页面总是可读的.
+	prot &= VM_READ | VM_WRITE | VM_EXEC;
+	if (prot)
+		prot |= VM_READ;
+	if (flags & MAP_SHARED)
+		prot |= VM_SHARED;
+	lock_mmap(current->mm);
+	addr = do_mmap(addr, len, prot, flags & MAP_FIXED, inode, off, NULL);
+	unlock_mmap(current->mm);
+	return addr;
+}
+
+// 系统调用munmap().解除逻辑地址范围[addr, addr+len)内的映射.范围内没有映射的部分被忽略.
+int sys_munmap(unsigned long addr, size_t len)
+{
+	int err;
+
+	if ((addr & 0xfff) || !len || addr >= TASK_SIZE || len > TASK_SIZE - addr)
+		return -EINVAL;
+	if (current->flags & PF_VFORK)
+		return -EINVAL;
+	lock_mmap(current->mm);
+	err = do_munmap(addr, addr + ((len + 0xfff) & 0xfffff000));
+	unlock_mmap(current->mm);
+	return err;
+}
+
+// 系统调用msync().把逻辑地址范围[addr, addr+len)内共享映射中已修改的页面写回文件.
+// 写回只是修改了高速缓冲中的缓冲块;MS_SYNC还把文件所在设备的缓冲块写到设备上.共享映射直接使用页面缓存中的页面,没有其他副本,因此
+// MS_INVALIDATE不需要做什么.范围内有没有映射的部分时返回-ENOMEM.
+int sys_msync(unsigned long addr, size_t len, int flags)
+{
+	struct vm_area_struct * vma;
+	unsigned long end, next = addr;
+	int unmapped = 0;
+
+	if ((addr & 0xfff) || (flags & ~(MS_ASYNC | MS_INVALIDATE | MS_SYNC)) ||
+	    ((flags & MS_ASYNC) && (flags & MS_SYNC)))
+		return -EINVAL;
+	end = addr + ((len + 0xfff) & 0xfffff000);
+	if (end < addr)
+		return -ENOMEM;
+	lock_mmap(current->mm);
+	for (vma = current->mm->mmap ; vma && vma->vm_start < end ; vma = vma->vm_next) {
+		if (vma->vm_end <= addr)
+			continue;
+		if (vma->vm_start > next)
+			unmapped = 1;
+		next = vma->vm_end;
+		sync_area(vma, (vma->vm_start > addr) ? vma->vm_start : addr,
+			(vma->vm_end < end) ? vma->vm_end : end);
+		if ((flags & MS_SYNC) && (vma->vm_flags & VM_SHARED) && vma->vm_inode)
+			sync_dev(vma->vm_inode->i_dev);
+	}
+	unlock_mmap(current->mm);
+	if (next < end)
+		unmapped = 1;
+	return unmapped ? -ENOMEM : 0;
+}
+
+// 为fork()的子进程p复制映射区链表,文件i节点的引用计数随之递增.页面本身由copy_page_tables()与父进程共享.内存不够时释放已复制的部分,
+// 返回-ENOMEM.分配时可能睡眠,因此锁定父进程的链表,以免同一地址空间中的其他线程在此期间修改它.
+int copy_mmap(struct task_struct * p)
+{
+	struct vm_area_struct * vma, * new, ** q = &p->mm->mmap;
+
+	*q = NULL;
+	lock_mmap(current->mm);
+	for (vma = current->mm->mmap ; vma ; vma = vma->vm_next) {
+		if (!(new = kmem_cache_alloc(vm_area_cachep, GFP_KERNEL))) {
+			unlock_mmap(current->mm);
+			exit_mmap(p);
+			return -ENOMEM;
+		}
+		*new = *vma;
+		new->vm_next = NULL;
+		open_vma(new);
+		*q = new;
+		q = &new->vm_next;
+	}
+	unlock_mmap(current->mm);
+	return 0;
+}
+
+// 解除任务p的所有映射.在地址空间的最后一个使用者退出(exit_mm())和exec()释放页表之前被调用,p是当前进程时先把共享映射中已修改的
+// 页面写回文件;fork()失败时也用它释放子进程的链表.
+void exit_mmap(struct task_struct * p)
+{
+	struct vm_area_struct * vma;
+
+	while (vma = p->mm->mmap) {
+		if (p == current)
+			sync_area(vma, vma->vm_start, vma->vm_end);
+		p->mm->mmap = vma->vm_next;
+		free_vma(vma);
+	}
+}
@@ -0,0 +1,417 @@
+/*
+ *  linux/mm/shm.c
+ *
+ *  (C) 1991  Linus Torvalds
+ */
+
+/*
+ * System V shared memory. A segment is just a table of pages, each of
+ * which the segment holds one mem_map[] reference on. shmat() creates
+ * a shared mapping (see mm/mmap.c) pointing at the segment, and
+ * do_no_page() maps the segment's pages into the task on first touch,
+ * taking another reference - so the same frames show up in every
+ * attached task and no data is ever copied.
+ *
+ * Swapping works in two steps: try_to_swap_out() just drops the page
+ * table entries of segment pages (the contents live in the segment),
+ * and once no task maps a page any more, shm_swap() writes it out and
+ * keeps the swap entry in the segment table instead.
+ */
+/*
+ * System V共享内存.共享内存段只是一张页面表,段对其中每个页面持有一个mem_map[]引用.shmat()建立一个指向该段的共享映射区(见
+ * mm/mmap.c),进程第一次访问时由do_no_page()把段中的页面映射进来,并再递增一次引用计数.因此同样的物理页面出现在所有附加该段的进程中,
+ * 数据不需要复制.
+ *
+ * 交换分两步进行:try_to_swap_out()对段中的页面只是清除页表项(页面内容还在段中),当没有进程再映射某个页面时,shm_swap()把它写到交换设备
+ * 上,并在段的页面表中改为保存交换项.
+ */
+
+#include <errno.h>
+#include <sys/shm.h>
+
+#include <linux/sched.h>
+#include <linux/mm.h>
+#include <linux/kernel.h>
+#include <asm/segment.h>
+
+// 共享内存段.
+struct shm_seg {
+	struct shmid_ds ds;						// 段状态(键值,属主,权限,长度,时间等).
+	unsigned long * pages;					// 页面表.每项是页面地址|1,交换项,或者0(页面还没有分配).
+	int npages;								// 段的页面数.
+	int nr;									// 段在shm_segs[]中的索引.
+	int destroy;							// 已被IPC_RMID删除,最后一个进程分离时释放.
+};
+
+static struct shm_seg * shm_segs[SHMMNI];
+static unsigned short shm_seq = 0;			// 表项使用序号.标识符 = 序号 * SHMMNI + 索引,旧标识符不会误用新段.
+
+// 统计信息.
+static int shm_pages = 0;					// 在内存中的段页面数.
+static int shm_swapped = 0;					// 被交换出去的段页面数.
+
+// 取标识符shmid对应的段.没有则返回NULL.
+static struct shm_seg * shm_lookup(int shmid)
+{
+	struct shm_seg * seg;
+
+	if (shmid < 0 || !(seg = shm_segs[shmid % SHMMNI]))
+		return NULL;
+	if (seg->ds.shm_perm.seq != shmid / SHMMNI)
+		return NULL;
+	return seg;
+}
+
+// 检查当前进程对段的访问权限.flag与文件权限一样用低9位表示要求的权限,例如0444为读,0666为读写.
+static int shm_perms(struct ipc_perm * perm, int flag)
+{
+	int requested = (flag >> 6) | (flag >> 3) | flag;
+	int granted = perm->mode;
+
+	if (current->euid == perm->cuid || current->euid == perm->uid)
+		granted >>= 6;
+	else if (in_group_p(perm->cgid) || in_group_p(perm->gid))
+		granted >>= 3;
+	if ((requested & ~granted & 0007) && !suser())
+		return -EACCES;
+	return 0;
+}
+
+// 释放段seg的所有页面(或交换页面),页面表和段结构本身.
+static void shm_destroy(struct shm_seg * seg)
+{
+	unsigned long entry;
+	int i;
+
+	for (i = 0 ; i < seg->npages ; i++) {
+		if (!(entry = seg->pages[i]))
+			continue;
+		if (entry & 1) {
+			free_page(entry & 0xfffff000);
+			shm_pages--;
+		} else {
+			swap_free(entry);
+			shm_swapped--;
+		}
+	}
+	shm_segs[seg->nr] = NULL;
+	free_page((unsigned long) seg->pages);
+	free(seg);
+}
+
+// 递减段的附加次数.段已被删除并且不再有进程附加时释放它.
+static void shm_put(struct shm_seg * seg)
+{
+	if (!--seg->ds.shm_nattch && seg->destroy)
+		shm_destroy(seg);
+}
+
+// 映射区vma被复制(fork()或munmap()把它分成两个)时调用,递增段的附加次数.
+void shm_open(struct vm_area_struct * vma)
+{
+	vma->vm_shm->ds.shm_nattch++;
+}
+
+// 映射区vma被释放时调用.
+void shm_close(struct vm_area_struct * vma)
+{
+	vma->vm_shm->ds.shm_lpid = current->pid;
+	vma->vm_shm->ds.shm_dtime = CURRENT_TIME;
+	shm_put(vma->vm_shm);
+}
+
+// 取映射区vma所附加的段中偏移offset处的页面,递增其引用计数后返回.在do_no_page()中被调用.
+// 页面还没有分配时分配一页清零的页面;在交换设备中时读回.这两种操作都会睡眠,期间页面表项可能已被修改(例如被其他进程读回),因此重新检查.
+unsigned long shm_nopage(struct vm_area_struct * vma, unsigned long offset)
+{
+	unsigned long * slot = vma->vm_shm->pages + (offset >> 12);
+	unsigned long entry, page;
+
+	for (;;) {
+		entry = *slot;
+		if (entry & 1) {
+			page = entry & 0xfffff000;
+			mem_map[MAP_NR(page)]++;
+			return page;
+		}
+		if (!entry) {
+			if (!(page = get_free_page()))
+				oom();
+			if (*slot) {
+				free_page(page);
+				continue;
+			}
+			*slot = page | 1;
+			shm_pages++;
+			continue;
+		}
+		if (!(page = get_free_page_nozero()))
+			oom();
+		read_swap_page(entry, (char *) page);
+		if (*slot != entry) {
+			free_page(page);
+			continue;
+		}
+		swap_free(entry);
+		*slot = page | 1;
+		shm_swapped--;
+		shm_pages++;
+	}
+}
+
+// 把一个段页面交换出去.
+// 从上次的位置开始寻找只被段本身引用(已没有进程映射)的页面,写到交换设备上并在页面表中保存交换项.与try_to_swap_out()一样,页面先尝试
+// 压缩保存.在get_free_page()中swap_out()之后被调用.成功返回1,否则返回0.
+int shm_swap(void)
+{
+	static int seg_nr = 0;						// 正在扫描的段.
+	static int page_nr = 0;						// 下一个要尝试的页面.
+	struct shm_seg * seg;
+	unsigned long * slot, page, entry;
+	int segs = SHMMNI + 1;
+
+	while (segs > 0) {
+		if (!(seg = shm_segs[seg_nr]) || page_nr >= seg->npages) {
+			if (++seg_nr >= SHMMNI)
+				seg_nr = 0;
+			page_nr = 0;
+			segs--;
+			continue;
+		}
+		slot = seg->pages + page_nr++;
+		if (!(*slot & 1))
+			continue;
+		page = *slot & 0xfffff000;
+		if (mem_map[MAP_NR(page)] != 1)
+			continue;
+		if (!(entry = get_swap_page()))
+			return 0;
+		*slot = entry;
+		shm_pages--;
+		shm_swapped++;
+		switch (zswap_store(entry, page)) {
+			case ZSWAP_KEPT:
+				return 1;
+			case ZSWAP_NONE:
+				write_swap_page(entry, (char *) page);
+		}
+		free_page(page);
+		return 1;
+	}
+	return 0;
+}
+
+// 把段中属于交换区type的页面全部读回内存,返回读回的页面数.内存不够时返回-ENOMEM.在swapoff()中被调用.
+int shm_unuse(int type)
+{
+	struct shm_seg * seg;
+	unsigned long entry, page;
+	int i, n, found = 0;
+
+	for (i = 0 ; i < SHMMNI ; i++)
+		for (n = 0 ; (seg = shm_segs[i]) && n < seg->npages ; n++) {
+			entry = seg->pages[n];
+			if (!entry || (entry & 1) || SWP_TYPE(entry) != type)
+				continue;
+			if (!(page = get_free_page_nozero()))
+				return -ENOMEM;
+			read_swap_page(entry, (char *) page);
+			// 读页面时会睡眠,段可能已被释放或页面已被读回.
+			if (shm_segs[i] != seg || seg->pages[n] != entry) {
+				free_page(page);
+				continue;
+			}
+			swap_free(entry);
+			seg->pages[n] = page | 1;
+			shm_swapped--;
+			shm_pages++;
+			found++;
+		}
+	return found;
+}
+
+// 系统调用shmget().取键值为key的段的标识符,需要时建立长度为size字节的新段.
+// IPC_PRIVATE总是建立新段.分配内存时可能睡眠,期间其他进程可能已用同一键值建立了段,因此分配之后重新查找.
+int sys_shmget(key_t key, int size, int shmflg)
+{
+	struct shm_seg * seg, * new = NULL;
+	int i, err;
+
+repeat:
+	if (key != IPC_PRIVATE)
+		for (i = 0 ; i < SHMMNI ; i++)
+			if ((seg = shm_segs[i]) && seg->ds.shm_perm.key == key) {
+				if (new) {
+					free_page((unsigned long) new->pages);
+					free(new);
+				}
+				if ((shmflg & IPC_CREAT) && (shmflg & IPC_EXCL))
+					return -EEXIST;
+				if (size > seg->ds.shm_segsz)
+					return -EINVAL;
+				if (err = shm_perms(&seg->ds.shm_perm, shmflg))
+					return err;
+				return seg->ds.shm_perm.seq * SHMMNI + i;
+			}
+	if (!(shmflg & IPC_CREAT))
+		return -ENOENT;
+	if (size < SHMMIN || size > SHMMAX)
+		return -EINVAL;
+	if (!new) {
+		if (!(new = (struct shm_seg *) malloc(sizeof(struct shm_seg))))
+			return -ENOMEM;
+		if (!(new->pages = (unsigned long *) get_free_page())) {
+			free(new);
+			return -ENOMEM;
+		}
+		goto repeat;
+	}
+	for (i = 0 ; i < SHMMNI ; i++)
+		if (!shm_segs[i])
+			break;
+	if (i >= SHMMNI) {
+		free_page((unsigned long) new->pages);
+		free(new);
+		return -ENOSPC;
+	}
+	new->npages = (size + PAGE_SIZE - 1) / PAGE_SIZE;
+	new->nr = i;
+	new->destroy = 0;
+	new->ds.shm_perm.key = key;
+	new->ds.shm_perm.uid = new->ds.shm_perm.cuid = current->euid;
+	new->ds.shm_perm.gid = new->ds.shm_perm.cgid = current->egid;
+	new->ds.shm_perm.mode = shmflg & 0777;
+	new->ds.shm_perm.seq = shm_seq++ % (0x7fff / SHMMNI);
+	new->ds.shm_segsz = size;
+	new->ds.shm_atime = new->ds.shm_dtime = 0;
+	new->ds.shm_ctime = CURRENT_TIME;
+	new->ds.shm_cpid = current->pid;
+	new->ds.shm_lpid = 0;
+	new->ds.shm_nattch = 0;
+	shm_segs[i] = new;
+	return new->ds.shm_perm.seq * SHMMNI + i;
+}
+
+// 系统调用shmat().把段shmid附加到当前进程的地址空间中,返回附加的地址.
+// shmaddr为0时由内核在映射区范围内选择地址,否则附加在shmaddr处(SHM_RND时向下舍入到SHMLBA的倍数),该范围内不能已有映射.建立映射区时
+// 可能睡眠,期间先多算一次附加,以免段被删除.
+int sys_shmat(int shmid, unsigned long shmaddr, int shmflg)
+{
+	struct shm_seg * seg;
+	struct vm_area_struct * vma;
+	unsigned long len;
+	int err, flags = VM_READ | VM_SHARED;
+
+	if (!(seg = shm_lookup(shmid)))
+		return -EINVAL;
+	if (current->flags & PF_VFORK)
+		return -EINVAL;
+	if (err = shm_perms(&seg->ds.shm_perm, (shmflg & SHM_RDONLY) ? 0444 : 0666))
+		return err;
+	if (!(shmflg & SHM_RDONLY))
+		flags |= VM_WRITE;
+	len = seg->npages * PAGE_SIZE;
+	if (shmaddr) {
+		if (shmflg & SHM_RND)
+			shmaddr &= ~(SHMLBA - 1);
+		else if (shmaddr & (SHMLBA - 1))
+			return -EINVAL;
+	}
+	lock_mmap(current->mm);
+	if (shmaddr)
+		for (vma = current->mm->mmap ; vma ; vma = vma->vm_next)
+			if (vma->vm_start < shmaddr + len && vma->vm_end > shmaddr) {
+				unlock_mmap(current->mm);
+				return -EINVAL;
+			}
+	seg->ds.shm_nattch++;
+	if ((err = do_mmap(shmaddr, len, flags, shmaddr != 0, NULL, 0, seg)) >= 0) {
+		seg->ds.shm_atime = CURRENT_TIME;
+		seg->ds.shm_lpid = current->pid;
+	}
+	unlock_mmap(current->mm);
+	shm_put(seg);
+	return err;
+}
+
+// 系统调用shmdt().分离附加在地址shmaddr处的段.munmap()可能已把附加的映射区分成几段,因此删除所有属于该次附加的映射区.
+int sys_shmdt(unsigned long shmaddr)
+{
+	struct vm_area_struct * vma;
+	int found = 0;
+
+	if (current->flags & PF_VFORK)
+		return -EINVAL;
+	lock_mmap(current->mm);
+	for (;;) {
+		for (vma = current->mm->mmap ; vma ; vma = vma->vm_next)
+			if (vma->vm_shm && vma->vm_start - vma->vm_offset == shmaddr)
+				break;
+		if (!vma)
+			break;
+		do_munmap(vma->vm_start, vma->vm_end);
+		found = 1;
+	}
+	unlock_mmap(current->mm);
+	return found ? 0 : -EINVAL;
+}
+
+// 系统调用shmctl().
+// IPC_STAT把段状态复制到用户缓冲区buf中;IPC_SET按buf设置段的属主和访问权限;IPC_RMID删除段,段在最后一个进程分离时才真正释放,但
+// 此后不能再被shmget()找到.后两者只有段的属主,创建者或超级用户才能执行.访问用户缓冲区时可能睡眠,因此先访问用户空间再查找段.
+int sys_shmctl(int shmid, int cmd, struct shmid_ds * buf)
+{
+	struct shm_seg * seg;
+	struct shmid_ds ds;
+	unsigned long * lp;
+	int i, err;
+
+	switch (cmd) {
+		case IPC_STAT:
+			verify_area(buf, sizeof(struct shmid_ds));
+			if (!(seg = shm_lookup(shmid)))
+				return -EINVAL;
+			if (err = shm_perms(&seg->ds.shm_perm, 0444))
+				return err;
+			ds = seg->ds;
+			for (lp = (unsigned long *) &ds, i = 0 ; i < sizeof(ds) / 4 ; i++)
+				put_fs_long(lp[i], i + (unsigned long *) buf);
+			return 0;
+		case IPC_SET:
+			for (lp = (unsigned long *) &ds, i = 0 ; i < sizeof(ds) / 4 ; i++)
+				lp[i] = get_fs_long(i + (unsigned long *) buf);
+			/* fall through */
+		case IPC_RMID:
+			if (!(seg = shm_lookup(shmid)))
+				return -EINVAL;
+			if (current->euid != seg->ds.shm_perm.uid &&
+			    current->euid != seg->ds.shm_perm.cuid && !suser())
+				return -EPERM;
+			if (cmd == IPC_SET) {
+				seg->ds.shm_perm.uid = ds.shm_perm.uid;
+				seg->ds.shm_perm.gid = ds.shm_perm.gid;
+				seg->ds.shm_perm.mode = (seg->ds.shm_perm.mode & ~0777) |
+					(ds.shm_perm.mode & 0777);
+				seg->ds.shm_ctime = CURRENT_TIME;
+				return 0;
+			}
+			seg->ds.shm_perm.key = IPC_PRIVATE;
+			seg->destroy = 1;
+			if (!seg->ds.shm_nattch)
+				shm_destroy(seg);
+			return 0;
+	}
+	return -EINVAL;
+}
+
+// 显示共享内存统计信息.在show_mem()中被调用.
+void shm_show(void)
+{
+	int i, segs = 0;
+
+	for (i = 0 ; i < SHMMNI ; i++)
+		if (shm_segs[i])
+			segs++;
+	printk("Shm: %d segments, %d pages in memory, %d swapped\n\r",
+		segs, shm_pages, shm_swapped);
+}
@@ -0,0 +1,236 @@
+/*
+ *  linux/mm/slab.c
+ *
+ *  (C) 1991  Linus Torvalds
+ */
+
+/*
+ * A simple object cache for fixed-size kernel objects (inodes, file
+ * structures, block requests, timers). Each cache takes whole pages
+ * (slabs) from get_free_page() and carves them into objects of one
+ * size. The slab header sits at the start of its page, so the slab that
+ * owns an object is found by masking the object address - no searching
+ * as in free_s(). Cache descriptors themselves come from malloc().
+ *
+ * Slabs are kept on three lists: full, partially used and empty. Empty
+ * slabs are not given back at once, but only when get_free_page() runs
+ * short of memory (kmem_cache_shrink()), keeping at least the number of
+ * objects reserved when the cache was created.
+ */
+/*
+ * 用于固定大小内核对象(i节点,文件结构,块设备请求项,定时器)的简单对象缓存.每个缓存从get_free_page()取得整页内存(称为slab),
+ * 并把它分成大小相同的对象.slab头结构放在其页面的开始处,因此用对象地址屏蔽掉低12位就能找到对象所属的slab,不必像free_s()那样
+ * 搜索.缓存描述符本身用malloc()分配.
+ *
+ * slab被放在三个链表上:全满,部分使用和全空.全空的slab并不立即释放,而是在get_free_page()内存不够时(kmem_cache_shrink())才
+ * 释放,但会保留创建缓存时指定的预留对象数.
+ */
+
+#include <string.h>
+
+#include <linux/kernel.h>
+#include <linux/mm.h>
+#include <asm/system.h>
+
+// slab头结构.位于slab页面的开始处,其后是该slab的对象.
+struct kmem_slab {
+	struct kmem_cache * cache;				// 所属缓存.
+	struct kmem_slab * next, * prev;		// 缓存中同一链表上的前后slab.
+	void * freelist;						// 空闲对象链表.
+	int inuse;								// 已分配对象数.
+};
+
+// 对象缓存描述符.
+struct kmem_cache {
+	const char * name;						// 缓存名称(用于显示统计信息).
+	int size;								// 对象大小(已按4字节对齐).
+	int objs_per_slab;						// 每个slab中的对象数.
+	int reserve;							// 内存紧张时也保留的对象数.
+	struct kmem_slab * full;				// 对象已全部分配的slab链表.
+	struct kmem_slab * partial;				// 部分对象已分配的slab链表.
+	struct kmem_slab * empty;				// 没有对象被分配的slab链表.
+	int nr_slabs;							// slab(页面)数.
+	int nr_active;							// 已分配对象数.
+	unsigned long nr_allocs;				// 累计分配次数.
+	struct kmem_cache * next;				// 所有缓存组成的链表.
+};
+
+#define SLAB_OBJ_OFFSET ((sizeof(struct kmem_slab) + 3) & ~3)
+
+static struct kmem_cache * cache_chain = NULL;	// 所有缓存的链表.
+
+// 把slab插入链表*list的头部.
+static inline void slab_link(struct kmem_slab ** list, struct kmem_slab * slab)
+{
+	slab->prev = NULL;
+	if (slab->next = *list)
+		slab->next->prev = slab;
+	*list = slab;
+}
+
+// 把slab从链表*list中删除.
+static inline void slab_unlink(struct kmem_slab ** list, struct kmem_slab * slab)
+{
+	if (slab->prev)
+		slab->prev->next = slab->next;
+	else
+		*list = slab->next;
+	if (slab->next)
+		slab->next->prev = slab->prev;
+}
+
+// 为缓存增加一个slab.
+// 页面在关中断之外申请,因为get_free_page()可能会睡眠.新slab中的对象被链成空闲链表,slab放在全空链表上.成功返回1,否则返回0.
+static int kmem_cache_grow(struct kmem_cache * cachep, int priority)
+{
+	struct kmem_slab * slab;
+	unsigned long flags;
+	char * obj;
+	int i;
+
+	if (priority == GFP_ATOMIC)
+		slab = (struct kmem_slab *) get_free_page_atomic();
+	else
+		slab = (struct kmem_slab *) get_free_page_nozero();
+	if (!slab)
+		return 0;
+	slab->cache = cachep;
+	slab->inuse = 0;
+	slab->freelist = obj = SLAB_OBJ_OFFSET + (char *) slab;
+	for (i = cachep->objs_per_slab; i > 1; i--) {
+		*((char **) obj) = obj + cachep->size;
+		obj += cachep->size;
+	}
+	*((char **) obj) = NULL;
+	save_flags(flags);
+	cli();
+	slab_link(&cachep->empty, slab);
+	cachep->nr_slabs++;
+	restore_flags(flags);
+	return 1;
+}
+
+// 创建对象缓存.
+// 参数name是缓存名称;size是对象大小;reserve是预留对象数,创建时就为这些对象分配好slab,并且以后收缩缓存时也不释放.预留对象使得
+// 在中断中用GFP_ATOMIC分配时(例如块设备请求项和定时器)通常不用再申请页面.
+struct kmem_cache * kmem_cache_create(const char * name, int size, int reserve)
+{
+	struct kmem_cache * cachep;
+
+	size = (size + 3) & ~3;
+	if (size < sizeof(void *) || size > PAGE_SIZE - SLAB_OBJ_OFFSET)
+		panic("kmem_cache_create: bad object size");
+	if (!(cachep = (struct kmem_cache *) malloc(sizeof(struct kmem_cache))))
+		panic("kmem_cache_create: out of memory");
+	memset(cachep, 0, sizeof(struct kmem_cache));
+	cachep->name = name;
+	cachep->size = size;
+	cachep->objs_per_slab = (PAGE_SIZE - SLAB_OBJ_OFFSET) / size;
+	cachep->reserve = reserve;
+	while (cachep->nr_slabs * cachep->objs_per_slab < reserve)
+		if (!kmem_cache_grow(cachep, GFP_KERNEL))
+			panic("kmem_cache_create: out of memory");
+	cachep->next = cache_chain;
+	cache_chain = cachep;
+	return cachep;
+}
+
+// 从缓存中分配一个对象,对象内容被清零.
+// 参数priority为GFP_KERNEL时需要的话可以申请新页面(可能会睡眠);为GFP_ATOMIC时不会睡眠,可以在中断中使用.若没有内存则返回NULL.
+void * kmem_cache_alloc(struct kmem_cache * cachep, int priority)
+{
+	struct kmem_slab * slab;
+	unsigned long flags;
+	void * obj;
+
+	save_flags(flags);
+	cli();
+	// 先从部分使用的slab中分配,其次是全空的slab.都没有时再增加一个slab.增加slab时开着中断,期间可能有其他对象被释放,所以要重新查找.
+	while (!(slab = cachep->partial)) {
+		if (slab = cachep->empty) {
+			slab_unlink(&cachep->empty, slab);
+			slab_link(&cachep->partial, slab);
+			break;
+		}
+		restore_flags(flags);
+		if (!kmem_cache_grow(cachep, priority))
+			return NULL;
+		save_flags(flags);
+		cli();
+	}
+	obj = slab->freelist;
+	slab->freelist = *((void **) obj);
+	if (++slab->inuse == cachep->objs_per_slab) {
+		slab_unlink(&cachep->partial, slab);
+		slab_link(&cachep->full, slab);
+	}
+	cachep->nr_active++;
+	cachep->nr_allocs++;
+	restore_flags(flags);
+	memset(obj, 0, cachep->size);
+	return obj;
+}
+
+// 把对象obj释放回缓存.
+// 用对象地址找到所属slab,把对象放回slab的空闲链表.slab全空时移到全空链表上,但不释放页面.可以在中断中调用.
+void kmem_cache_free(struct kmem_cache * cachep, void * obj)
+{
+	struct kmem_slab * slab;
+	unsigned long flags;
+
+	if (!obj)
+		return;
+	slab = (struct kmem_slab *) (0xfffff000 & (unsigned long) obj);
+	if (slab->cache != cachep || !slab->inuse)
+		panic("kmem_cache_free: bad object");
+	save_flags(flags);
+	cli();
+	*((void **) obj) = slab->freelist;
+	slab->freelist = obj;
+	if (slab->inuse-- == cachep->objs_per_slab) {
+		slab_unlink(&cachep->full, slab);
+		slab_link(&cachep->partial, slab);
+	}
+	if (!slab->inuse) {
+		slab_unlink(&cachep->partial, slab);
+		slab_link(&cachep->empty, slab);
+	}
+	cachep->nr_active--;
+	restore_flags(flags);
+}
+
+// 释放所有缓存中超出预留对象数的全空slab,返回释放的页面数.
+// 在get_free_page()内存不够时,先于丢弃页面缓存和交换页面被调用.
+int kmem_cache_shrink(void)
+{
+	struct kmem_cache * cachep;
+	struct kmem_slab * slab;
+	unsigned long flags;
+	int freed = 0;
+
+	for (cachep = cache_chain ; cachep ; cachep = cachep->next) {
+		save_flags(flags);
+		cli();
+		while ((slab = cachep->empty) &&
+		       (cachep->nr_slabs - 1) * cachep->objs_per_slab >= cachep->reserve) {
+			slab_unlink(&cachep->empty, slab);
+			cachep->nr_slabs--;
+			free_page((unsigned long) slab);
+			freed++;
+		}
+		restore_flags(flags);
+	}
+	return freed;
+}
+
+// 显示各对象缓存的使用统计信息.在show_mem()中被调用.
+void kmem_cache_show(void)
+{
+	struct kmem_cache * cachep;
+
+	for (cachep = cache_chain ; cachep ; cachep = cachep->next)
+		printk("Slab %-8s %4d bytes: %d/%d objects, %d pages, %d allocs\n\r",
+			cachep->name, cachep->size, cachep->nr_active,
+			cachep->nr_slabs * cachep->objs_per_slab, cachep->nr_slabs,
+			cachep->nr_allocs);
+}
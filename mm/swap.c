@@ -12,14 +12,20 @@
  * 本程序应该包括绝大部分执行内存交换的代码(从内存到磁盘或反之).从91年12月18日开始编制.
  */
 
+#include <errno.h>
 #include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
 #include <linux/mm.h>
 #include <linux/sched.h>
 #include <linux/head.h>
 #include <linux/kernel.h>
+#include <asm/system.h>
 
 /* 每个字节8位,因此1页(4096B)共有32768个位.若1个位对应1页内存,则最多可管理32768个页面,对应128MB内存容量 */
 #define SWAP_BITS (4096 << 3)
+// 每个交换区的位图最多可占用的页面数.交换项中页面号占20位,因此一个交换区最多有1M个交换页面(4GB),需要32页位图.
+#define SWAP_BITMAP_PAGES ((1 << 20) / SWAP_BITS)
 
 // 位操作宏.通过给定不同的"op",可定义对指定比特位进行测试,设置或清除三种操作.
 // 参数addr是指定线性地址;nr是指定地址处开始的比特位偏移位.该宏把给定地址addr处第nr个比特位的值放入进位标志,
@@ -46,9 +52,47 @@ bitop(bit, "")		// 定义内嵌函数bit(char * addr, unsigned int nr).
 bitop(setbit, "s")	// 定义内嵌函数setbit(char * addr, unsigned int nr).
 bitop(clrbit, "r")	// 定义内嵌函数clrbit(char * addr, unsigned int nr).
 
-static char * swap_bitmap = NULL;
+/*
+ * Swap areas. Each one has its own (possibly multi-page) bitmap and a
+ * priority. Usable areas are kept on a list sorted by priority, and
+ * pages are taken round-robin from the areas of the highest priority,
+ * so equal-priority disks get striped.
+ */
+/*
+ * 交换区.每个交换区有自己的(可能占多页的)位图和优先级.可用的交换区按优先级从高到低链接在一个链表上,申请交换页面时总是
+ * 从最高优先级的交换区中轮流分配,因此优先级相同的几个磁盘会被条带化使用.
+ */
+#define SWP_USED	1				// 交换区表项已被占用.
+#define SWP_WRITEOK	3				// 交换区可以写入(分配新交换页面).swapoff时会清除该标志中的位1.
+
+struct swap_info_struct {
+	unsigned short swap_dev;		// 交换设备号.
+	unsigned short flags;			// 交换区标志(SWP_USED,SWP_WRITEOK).
+	int prio;						// 优先级,值越大越优先使用.
+	int next;						// 交换区链表中下一项的交换区号,-1表示链表结束.
+	int max;						// 交换区页面总数(含页面0).
+	int lowest_bit;					// 搜索空闲位的起始位置.
+	int highest_bit;				// 搜索空闲位的结束位置.
+	int inuse_pages;				// 已被使用的交换页面数.
+	char * swap_bitmap[SWAP_BITMAP_PAGES];	// 交换页面位图页面指针,位为1表示对应交换页面空闲.
+};
+
+static struct swap_info_struct swap_info[MAX_SWAPFILES];
+static int nr_swapfiles = 0;		// 曾经使用过的最大交换区号+1.
+static int least_priority = 0;		// 未指定优先级的交换区使用的递减默认优先级.
+
+// 交换区链表.head是优先级最高的交换区,next是下次申请交换页面时首先尝试的交换区.
+static struct {
+	int head;
+	int next;
+} swap_list = {-1, -1};
+
 int SWAP_DEV = 0;	// 内核初始化时设置的交换设备号.
 
+// 取交换区p中页面号为nr的位所在的位图页面及页内位偏移.
+#define swap_map(p, nr) ((p)->swap_bitmap[(nr) / SWAP_BITS])
+#define swap_bit(nr) ((nr) & (SWAP_BITS - 1))
+
 /*
  * We never page the pages in task[0] - kernel memory.
  * We page all other pages.
@@ -56,116 +100,218 @@ int SWAP_DEV = 0;	// 内核初始化时设置的交换设备号.
 /*
  * 我们从不交换任务0(task[0])的页面,即不交换内核页面,我们只对其他页面进行交换操作.
  */
-// 第1个虚拟内存页面,即从任务0末端(64MB)处开始的虚拟内存页面.
-#define FIRST_VM_PAGE (TASK_SIZE >> 12)			// = 64MB/4KB = 16384
-#define LAST_VM_PAGE (1024 * 1024)				// = 4GB/4KB = 1048576 4G对应的页数
-#define VM_PAGES (LAST_VM_PAGE - FIRST_VM_PAGE)	// = 1032192(从0开始计)(用总的页面数减去第0个任务的页面数)
+// 任务页目录中第1个用户空间目录项.其下的目录项映射内核空间,由所有任务共用.
+#define FIRST_VM_DIR (TASK_BASE >> 22)			// = 1GB/4MB = 256
+
+// 在交换区p中申请1页交换页面.
+// 从lowest_bit到highest_bit扫描交换区位图,返回值为1的第一个比特位号,即目前空闲的交换页面号.若交换区已满则返回0.
+static int scan_swap_map(struct swap_info_struct * p)
+{
+	int offset;
+
+	for (offset = p->lowest_bit; offset <= p->highest_bit; offset++) {
+		if (!clrbit(swap_map(p, offset), swap_bit(offset)))
+			continue;
+		p->lowest_bit = offset + 1;
+		p->inuse_pages++;
+		return offset;
+	}
+	p->lowest_bit = p->max;
+	p->highest_bit = 0;
+	return 0;
+}
 
 // 申请1页交换页面.
-// 扫描整个交换映射位图(除对应位图本身的位0以外),返回值为1的第一个比特位号,即目前空闲的交换页面号.若操作成功则返回
-// 交换页面号,否则返回0.
-static int get_swap_page(void)
+// 从交换区链表的next项开始,在优先级最高的交换区中申请交换页面.申请成功后,若链表中下一个交换区的优先级与当前交换区相同,
+// 则下次就从下一个交换区开始申请,否则回到链表头.这样同一优先级的各交换区就被轮流使用.只有当同一优先级的所有交换区都已满时,
+// 才会使用优先级更低的交换区.若操作成功则返回交换项,否则返回0.
+unsigned long get_swap_page(void)
 {
-	int nr;
+	struct swap_info_struct * p;
+	int type, offset, wrapped = 0;
 
-	if (!swap_bitmap) {
+	type = swap_list.next;
+	if (type < 0)
 		return 0;
+	while (1) {
+		p = swap_info + type;
+		if ((p->flags & SWP_WRITEOK) == SWP_WRITEOK &&
+		    (offset = scan_swap_map(p))) {
+			if (p->next < 0 || swap_info[p->next].prio != p->prio)
+				swap_list.next = swap_list.head;
+			else
+				swap_list.next = p->next;
+			return SWP_ENTRY(type, offset);
+		}
+		// 当前交换区已满.若下一项优先级相同则继续尝试它,否则从链表头开始把较低优先级的交换区也尝试一遍.
+		type = p->next;
+		if (!wrapped) {
+			if (type < 0 || p->prio != swap_info[type].prio) {
+				type = swap_list.head;
+				wrapped = 1;
+			}
+		} else if (type < 0)
+			return 0;
 	}
-	for (nr = 1; nr < SWAP_BITS ; nr++)
-		if (clrbit(swap_bitmap, nr))
-			return nr;					// 返回目前空闲的交换页面号.
-	return 0;
 }
 
-// 释放交换设备中指定的交换页面.
-// 在交换位图中设置指定页面号对应的位(置1).若原来该位就等于1,则表示交换设备中原来该页面就没有被占用,或者位图出错.于
-// 是显示出错信息并返回.
-// 参数指定交换页面号.
-// ultraji: 类型转换会出问题吗？
-void swap_free(int swap_nr)
+// 根据交换项取对应的交换区.若交换项无效则显示出错信息并返回NULL.
+static struct swap_info_struct * swap_info_of(unsigned long entry, char * who)
 {
-	if (!swap_nr) {
-		return;
+	struct swap_info_struct * p;
+	unsigned long type, offset;
+
+	type = SWP_TYPE(entry);
+	offset = SWP_OFFSET(entry);
+	p = swap_info + type;
+	if (type >= nr_swapfiles || !(p->flags & SWP_USED) ||
+	    !offset || offset >= p->max) {
+		printk("Bad swap entry %08x (%s)\n\r", entry, who);
+		return NULL;
 	}
-	if (swap_bitmap && swap_nr < SWAP_BITS) {
-		if (!setbit(swap_bitmap, swap_nr)) {
-			return;
-		}
+	return p;
+}
+
+// 从交换区读入或写出一页.参数rw是READ或WRITE;entry是交换项;buffer是内存页面.
+void rw_swap_page(int rw, unsigned long entry, char * buffer)
+{
+	struct swap_info_struct * p;
+
+	if (!(p = swap_info_of(entry, "rw_swap_page")))
+		return;
+	// 若页面保存在压缩交换缓存中,则直接从中读取.
+	if (rw == READ && zswap_load(entry, buffer))
+		return;
+	ll_rw_page(rw, p->swap_dev, SWP_OFFSET(entry), buffer);
+}
+
+// 释放交换项entry对应的交换页面.
+// 在所属交换区位图中设置对应的位(置1).若原来该位就等于1,则表示交换设备中原来该页面就没有被占用,或者位图出错.于是显示出错信息并返回.
+void swap_free(unsigned long entry)
+{
+	struct swap_info_struct * p;
+	unsigned long offset;
+
+	if (!entry)
+		return;
+	if (!(p = swap_info_of(entry, "swap_free")))
+		return;
+	offset = SWP_OFFSET(entry);
+	zswap_invalidate(entry);
+	if (setbit(swap_map(p, offset), swap_bit(offset))) {
+		printk("Swap-space bad (swap_free())\n\r");
+		return;
 	}
-	printk("Swap-space bad (swap_free())\n\r");
-	return;
+	p->inuse_pages--;
+	if (offset < p->lowest_bit)
+		p->lowest_bit = offset;
+	if (offset > p->highest_bit)
+		p->highest_bit = offset;
 }
 
 // 把指定页面交换进内存中
-// 把指定页表项的对应页面从交换设备中读入到新申请的内存页面中.修改交换位图中对应位(置位),同时修改页表项内容,
+// 把指定页表项的对应页面从交换设备中读入到新申请的内存页面中.释放交换项对应的交换页面,同时修改页表项内容,
 // 让它指向该内存页面,并设置相应标志.
 void swap_in(unsigned long *table_ptr)
 {
-	int swap_nr;
+	unsigned long entry;
 	unsigned long page;
 
-	// 首先检查交换位图和参数有效性.如果交换位图不存在,或者指定页表项对应的页面已存在于内存中,或者交换页面号为0,则显示警告信息并退出.对于已放到交换
-	// 设备中去的内存页面,相应页表项中存放的应是交换页面号*2,即(swap_nr << 1).
-	if (!swap_bitmap) {
-		printk("Trying to swap in without swap bit-map");
-		return;
-	}
+	// 首先检查参数有效性.如果指定页表项对应的页面已存在于内存中,或者交换项为0,则显示警告信息并退出.对于已放到交换
+	// 设备中去的内存页面,相应页表项中存放的是交换项SWP_ENTRY(type, offset).
 	if (1 & *table_ptr) {
 		printk("trying to swap in present page\n\r");
 		return;
 	}
-	swap_nr = *table_ptr >> 1;
-	if (!swap_nr) {
+	entry = *table_ptr;
+	if (!entry) {
 		printk("No swap page in swap_in\n\r");
 		return;
 	}
-	// 然后申请一页物理内存并从交换设备中读入页面号为swap_nr的页面.在把页面交换进来后,就把交换位图中对应比特位置位.如果其原本就是置位的,说明此次是再次
-	// 从交换设备中读入相同的页面,于是显示一下警告信息.最后让页表指向该物理页面,并设置页面已修改,用户可读写和存在标志(Dirty,U/S,R/W,P).
-	if (!(page = get_free_page())) {
+	// 然后申请一页物理内存并从交换区中读入交换项对应的页面.在把页面交换进来后,就释放该交换页面.最后让页表指向该物理页面,
+	// 并设置页面已修改,用户可读写和存在标志(Dirty,U/S,R/W,P).
+	if (!(page = get_free_page_nozero())) {
 		oom();
 	}
-	read_swap_page(swap_nr, (char *) page);
-	if (setbit(swap_bitmap, swap_nr))
-		printk("swapping in multiply from same page\n\r");
+	read_swap_page(entry, (char *) page);
+	// 读页面时进程可能睡眠,若页表项已被其他路径换入(例如swapoff),则放弃本次读入的页面.
+	if (*table_ptr != entry) {
+		free_page(page);
+		return;
+	}
+	swap_free(entry);
 	*table_ptr = page | (PAGE_DIRTY | 7);
+	inc_rss(current);
+}
+
+// 页表项table_ptr(对应线性地址address)被修改后刷新页变换高速缓冲.
+// fork()共享的页表可能同时出现在多个线性地址处(例如各任务的地址空间还位于同一页目录中不同位置时),只使address处的缓冲项无效并不够,
+// 因此页表仍被共享时刷新整个高速缓冲.
+static inline void invalidate_pte(unsigned long * table_ptr, unsigned long address)
+{
+	unsigned long table = 0xfffff000 & (unsigned long) table_ptr;
+
+	if (table >= LOW_MEM && mem_map[MAP_NR(table)] > 1)
+		invalidate();
+	else
+		invalidate_page(address);
 }
 
 // 尝试把页面交换出去.
 // 若页面没有被修改过则不必保存在交换设备中,因为对应页面还可以再直接从相应映像文件中读入.于是可以直接释放掉
-// 相应物理页面了事.否则就申请一个交换页面号,然后把页面交换出去.此时交换页面号要保存在对应页表项中,并且仍需
-// 要保持页表项存在位P=0.参数是页表项指针.页面换或释放成功返回1,否则返回0.
-int try_to_swap_out(unsigned long * table_ptr)
+// 相应物理页面了事.否则就申请一个交换页面,然后把页面交换出去.此时交换项要保存在对应页表项中,并且仍需
+// 要保持页表项存在位P=0.参数是页面所属任务,页表项指针和页面的线性地址.页面换或释放成功返回1并递减任务的驻留页面数,否则返回0.
+static int try_to_swap_out(struct task_struct * p, unsigned long * table_ptr, unsigned long address)
 {
 	unsigned long page;
 	unsigned long swap_nr;
+	struct vm_area_struct * vma;
 
 	// 首先判断参数的有效性.若需要交换出去的内存页面并不存在(或称无效),则即可退出.若页表项指定的物理页面地
-	// 址大于分页管理的内存高端PAGING_MEMORY(15MB),也退出.
+	// 址不在分页管理的内存范围内,也退出.
 	page = *table_ptr;
-	if (!(PAGE_PRESENT & page))
+	if (!(PAGE_PRESENT & page) || (PAGE_LOCKED & page))			// 被mlock()锁定的页面不交换.
 		return 0;
-	if (page - LOW_MEM > PAGING_MEMORY)
+	if (page < LOW_MEM || page >= HIGH_MEMORY)
 		return 0;
-	// 若内存页面已被修改过,但是该页面是被共享的,那么为了提高运行效率,此类页面不宜被交换出去,于是直接退出,函数返回0.否则就申请一交换页面号,并把它保存在页表
+	// 共享内存段的页面还被段本身引用,只解除映射即可,以后缺页时再从段中映射.已修改标志不用保留,页面内容就在段中.只剩段本身引用的页面
+	// 由shm_swap()交换出去.
+	if (p->mm->mmap && (vma = find_vma(p, address - p->start_code)) && vma->vm_shm) {
+		*table_ptr = 0;
+		invalidate_pte(table_ptr, address);
+		dec_rss(p);
+		page &= 0xfffff000;
+		free_page(page);
+		return !mem_map[MAP_NR(page)];
+	}
+	// 若内存页面已被修改过,但是该页面是被共享的,那么为了提高运行效率,此类页面不宜被交换出去,于是直接退出,函数返回0.否则就申请一交换页面,并把交换项保存在页表
 	// 项中,然后把页面交换出去并释放对应物理内存页面.
 	if (PAGE_DIRTY & page) {
 		page &= 0xfffff000;									// 取物理页面地址.
 		if (mem_map[MAP_NR(page)] != 1)
 			return 0;
-		if (!(swap_nr = get_swap_page()))					// 申请交换页面号.
+		if (!(swap_nr = get_swap_page()))					// 申请交换页面.
 			return 0;
-		// 对于要交换设备中的页面,相应页表项中将存放的是(swap_nr << 1).乘2(左移1位)是为了空出原来页表项的存在位(P).只有存在位P=0并且页表项内容不为0的页面才会在
+		// 对于要交换设备中的页面,相应页表项中将存放的是交换项SWP_ENTRY(type, offset),其位0(存在位P)为0.只有存在位P=0并且页表项内容不为0的页面才会在
 		// 交换设备中.Intel手册中明确指出,当一个表项的存在位P=0时(无效页表项),所有其他位(位31-1)可供随意使用.下面写交换页函数write_swap_page(nr,buffer)被
-		// 定义为ll_rw_page(WRITE,SWAP_DEV,(nr),(buffer)).
-		*table_ptr = swap_nr << 1;
-		invalidate();										// 刷新CPU页变换高速缓冲.
-		write_swap_page(swap_nr, (char *) page);
+		// 定义为rw_swap_page(WRITE,(nr),(buffer)).
+		// 页面先尝试压缩保存到压缩交换缓存中,只有保存不成功时才真正写到交换设备上.若页面本身被收归了缓存页面池,则不能再释放它.
+		*table_ptr = swap_nr;
+		invalidate_pte(table_ptr, address);					// 刷新该页面的页变换高速缓冲项.
+		dec_rss(p);
+		switch (zswap_store(swap_nr, page)) {
+			case ZSWAP_KEPT:
+				return 1;
+			case ZSWAP_NONE:
+				write_swap_page(swap_nr, (char *) page);
+		}
 		free_page(page);
 		return 1;
 	}
 	// 否则表明页面没有修改过.那么就不用交换出去,而直接释放即可.
 	*table_ptr = 0;
-	invalidate();
+	invalidate_pte(table_ptr, address);
+	dec_rss(p);
 	free_page(page);
 	return 1;
 }
@@ -179,55 +325,101 @@ int try_to_swap_out(unsigned long * table_ptr)
  * OK,这个函数中有一个非常复杂的逻辑,用于产生逻辑性好并且速度快的机器码.如果我们不对此操心的话,那么事情可能更容易些.
  */
 // 把内存页面放到交换设备中.
-// 从线性地址64MB对应的目录项(FIRST_VM_PAGE>>10)开始,搜索整个4GB线性空间,对有效页目录二级页表指定的物理内存页面执行交换
-// 到交换设备中去的尝试.一旦成功地交换出一个页面,就返回-1.否则返回0.该函数会在get_free_page()中被调用.
+// 每个任务有自己的页目录,因此依次扫描除任务0以外各任务页目录中的用户空间目录项(从FIRST_VM_DIR开始),对有效页目录二级页表指定的物理内存
+// 页面执行交换到交换设备中去的尝试.扫描位置(任务号,目录项,页表项)保存在静态变量中,下次从这里继续.与属主共用地址空间的vfork()子进程
+// 和线程不单独扫描,调用过mlockall(MCL_FUTURE)的任务也不扫描.一旦成功地交换出一个页面,就返回1.若所有任务都扫描了一遍仍没有成功,则返回0.该函数会在get_free_page()中被调用.
 int swap_out(void)
 {
-	static int dir_entry = FIRST_VM_PAGE >> 10;	// 即任务1的第1个目录项索引.
-	static int page_entry = -1;
-	int counter = VM_PAGES;						// 表示除去任务0以外的其他任务的所有页数目
-	int pg_table;
-
-	// 首先搜索页目录表,查找二级页表存在的页目录项pg_table.找到则退出循环,否则高速页目录项数对应剩余二级页表项数counter,然后继续
-	// 检测下一项目录项.若全部搜索完还没有找到适合的(存在的)页目录项,就重新搜索.
-	while (counter > 0) {
-		pg_table = pg_dir[dir_entry];			// 页目录项内容.
-		if (pg_table & 1)
-			break;
-		counter -= 1024;						// 1个页表对应1024个页帧
-		dir_entry++;							// 下一目录项.
-		// 如果整个4GB的1024个页目录项检查完了则又回到第1个任务重新开始检查
-		if (dir_entry >= 1024)
-			dir_entry = FIRST_VM_PAGE >> 10;
-	}
-	// 在取得当前目录项的页表指针后,针对该页表中的所有1024个页面,逐一调用交换函数try_to_swap_out()尝试交换出去.一旦某个页面成功交换到交换设备
-	// 中就返回1.若对所有目录项的所有页表都已尝试失败,则显示"交换内存用完"的警告,并返回0.
-	pg_table &= 0xfffff000;						// 页表指针(地址)(页对齐)
-	while (counter-- > 0) {
-		page_entry++;
-		// 如果已经尝试处理完当前页表所有项还没有能够成功地交换出一个页面,即此时页表项索引大于等于1024,则如同前面第135-143行执行相同的处理来选出一个
-		// 二级页表存在的页目录项,并取得相应二级页表指针.
-		if (page_entry >= 1024) {
+	static int swap_task = 0;					// 正在扫描的任务号.
+	static int dir_entry = 1024;				// 正在扫描的目录项.
+	static int page_entry = 0;					// 下一个要尝试的页表项.
+	struct task_struct * p;
+	unsigned long pg_table;
+	int tasks = NR_TASKS;
+
+	for (;;) {
+		// 任务已不存在或其页目录已扫描完,则换到下一个任务.任务号循环一周之后仍没有成功就放弃.
+		p = task[swap_task];
+		if (!p || !swap_task || !mm_owner(p) || (p->flags & PF_MLOCKALL) || dir_entry >= 1024) {
+			if (tasks-- <= 0)
+				break;
+			if (++swap_task >= NR_TASKS)
+				swap_task = 1;
+			dir_entry = FIRST_VM_DIR;
 			page_entry = 0;
-		repeat:
+			continue;
+		}
+		// 跳过二级页表不存在的目录项.
+		pg_table = ((unsigned long *) p->tss.cr3)[dir_entry];
+		if (!(pg_table & 1) || page_entry >= 1024) {
 			dir_entry++;
-			if (dir_entry >= 1024)
-				dir_entry = FIRST_VM_PAGE >> 10;
-			pg_table = pg_dir[dir_entry];		// 页目录项内容.
-			if (!(pg_table & 1))
-				if ((counter -= 1024) > 0)
-					goto repeat;
-				else
-					break;
-			pg_table &= 0xfffff000;				// 页表指针.
+			page_entry = 0;
+			continue;
 		}
-		if (try_to_swap_out(page_entry + (unsigned long *) pg_table))
-			return 1;
-        }
+		// 针对该页表中的页面,逐一调用交换函数try_to_swap_out()尝试交换出去.一旦某个页面成功交换到交换设备中就返回1.
+		pg_table &= 0xfffff000;
+		while (page_entry < 1024) {
+			if (try_to_swap_out(p, page_entry + (unsigned long *) pg_table,
+			    (dir_entry << 22) | (page_entry << 12))) {
+				page_entry++;
+				return 1;
+			}
+			page_entry++;
+		}
+	}
 	printk("Out of swap-memory\n\r");
 	return 0;
 }
 
+// 换出任务p自己的一个页面.
+// 任务的驻留页面数超出RLIMIT_RSS时在do_no_page()中被调用,使超出限制的任务首先用自己的页面来满足新的缺页,而不是通过全局的swap_out()
+// 让其他任务的页面被换出.从p->swap_address处继续扫描其私有页表(仍被共享的页表不处理,否则会影响其他任务),最近被访问过的页面先清除访问
+// 标志,给它第二次机会.最多扫描整个用户空间两遍,成功返回1,否则返回0.
+int swap_out_task(struct task_struct * p)
+{
+	unsigned long address, * dir, * pte;
+	int dirs = 2 * (1024 - FIRST_VM_DIR);
+
+	address = p->swap_address;
+	if (address < TASK_BASE)
+		address = TASK_BASE;
+	while (dirs > 0) {
+		dir = PAGE_DIR_OFFSET(p->tss.cr3, address);
+		if ((*dir & 3) != 3) {
+			address = (address + 0x400000) & 0xffc00000;
+			if (address < TASK_BASE)
+				address = TASK_BASE;
+			dirs--;
+			continue;
+		}
+		pte = (unsigned long *) (0xfffff000 & *dir) + ((address >> 12) & 0x3ff);
+		if ((*pte & (PAGE_PRESENT | PAGE_ACCESSED)) == (PAGE_PRESENT | PAGE_ACCESSED)) {
+			*pte &= ~PAGE_ACCESSED;
+			if (p == current)
+				invalidate_page(address);
+		} else if (try_to_swap_out(p, pte, address)) {
+			p->swap_address = address + PAGE_SIZE;
+			return 1;
+		}
+		address += PAGE_SIZE;
+		if (!(address & 0x3fffff)) {
+			if (address < TASK_BASE)
+				address = TASK_BASE;
+			dirs--;
+		}
+	}
+	p->swap_address = address;
+	return 0;
+}
+
+// 把一页内存清零(4KB).
+#define clear_page(addr) __asm__("cld ; rep ; stosl"::"a" (0),"D" (addr),"c" (1024):)
+
+// 预先清零的空闲页面池.池中页面在mem_map[]中已标志为占用,因此不会被扫描到.池由任务0在空闲时填充(见fill_zeroed_pages()).
+#define ZEROED_POOL_SIZE 32
+static unsigned long zeroed_pages[ZEROED_POOL_SIZE];
+int nr_zeroed_pages = 0;
+
 /*
  * Get physical address of first (actually last :-) free page, and mark it
  * used. If no free pages left, return 0.
@@ -235,20 +427,22 @@ int swap_out(void)
 /*
  * 获取首个(实际上是最后1个:-)空闲页面,并标志为已使用.如果没有空闲页面,就返回0.
  */
-// 在主内存区中申请1页空闲物理页面.
-// 如果已经没有可用物理页面,则调用执行交换处理.然后再次申请页面.
-// 输入:%1(ax=0) - 0;%2(LOW_MEM)内存字节位图管理的起始位置;%3(cx=PAGING_PAGES);%4(edi=mem_map+PAGING_PAGES-1).
+// 在内存映射字节图中查找1页空闲物理页面并标志为已使用,但不清零页面.
+// 输入:%1(ax=0) - 0;%2(LOW_MEM)内存字节位图管理的起始位置;%3(cx=paging_pages);%4(edi=mem_map+paging_pages-1).
 // 输出:返回%0(ax=物理页面起始地址).函数返回新页面的物理地址.
 // 上面%4寄存器实际指向mem_map[]内存字节位图的最后一个字节.本函数从位图末端开始向前扫描所有页面标志(页面总数为PAGING_AGES),若有页面空闲
 // (内存位图字节为0)则返回页面地址.注意!本函数只是指出在主内存区的一页空闲物理页面,但并没有映射到某个进程的地址空间中去.后面的put_page()函数
 // 即用于把指定页面映射到某个进程的地址空间中.当然对于内核使用本函数并不需要再使用put_page()进行映射,因为内核代码和数据空间(16MB)已经对等
 // 地映射到物理地址空间.
-unsigned long get_free_page(void)
+// get_free_page_atomic()可能在中断中被调用,因此扫描和标志页面时要关中断,否则同一页面可能被分配两次.
+static unsigned long find_free_page(void)
 {
 	register unsigned long __res;
+	unsigned long flags;
 
-	// 首先在内存映射字节位图中查找址为0的字节项,然后把对应物理内存页面清零.如果得到的页面地址大于实际物理内存容量则重新寻找.如果没有找到空闲页面则
-	// 去调用执行交换处理,并重新查找.最后返回空闲物理页面地址.
+	// 在内存映射字节位图中查找址为0的字节项.如果得到的页面地址大于实际物理内存容量则重新寻找.
+	save_flags(flags);
+	cli();
 repeat:
 	__asm__(
 		"std ; repne ; scasb						/* 置方向位,al(0)与对应每个页面的(di)内容比较, */\n\t"
@@ -256,90 +450,381 @@ repeat:
 		"movb $1, 1(%%edi)							/* 1 =>[1+edi],将对应页面内存映像比特位置1. */\n\t"
 		"sall $12, %%ecx							/* 页面数*4K = 相对页面起始地址. */\n\t"
 		"addl %2, %%ecx								/* 再加上低端内存地址,得页面实际物理起始地址. */\n\t"
-		"movl %%ecx, %%edx							/* 将页面实际起始地址->edx寄存器. */\n\t"
-		"movl $1024, %%ecx							/* 寄存器ecx置计数值1024. */\n\t"
-		"leal 4092(%%edx), %%edi					/* 将4092+edx的位置->edi(该页面的末端). */\n\t"
-		"rep ; stosl								/* 将edi所指内存清零(反方向,即将该页面清零). */\n\t"
-		"movl %%edx, %%eax							/* 将页面起始地址->eax(返回值). */\n\t"
+		"movl %%ecx, %%eax							/* 将页面起始地址->eax(返回值). */\n\t"
 		"1:\n\t"
 		"cld"
 		:"=a" (__res)
-		:"0" (0), "i" (LOW_MEM), "c" (PAGING_PAGES),
-		"D" (mem_map + PAGING_PAGES - 1));
+		:"0" (0), "i" (LOW_MEM), "c" (paging_pages),
+		"D" (mem_map + paging_pages - 1));
 	if (__res >= HIGH_MEMORY)						// 页面地址大于实际内存容量则重新寻找
 		goto repeat;
-	if (!__res && swap_out())						// 若没有得到空闲页面则执行交换处理,并重新查找.
+	restore_flags(flags);
+	return __res;
+}
+
+// 从预先清零的页面池中取一页.池空时返回0.与find_free_page()一样要关中断.
+static unsigned long get_zeroed_page(void)
+{
+	unsigned long page = 0, flags;
+
+	save_flags(flags);
+	cli();
+	if (nr_zeroed_pages)
+		page = zeroed_pages[--nr_zeroed_pages];
+	restore_flags(flags);
+	return page;
+}
+
+// 在主内存区中申请1页空闲物理页面,但不清零页面.
+// 用于随后会用读入或复制的数据覆盖整个页面的场合(bread_page(),交换页面读入和写时复制),以免做无用的清零操作.预先清零的页面留给
+// get_free_page()使用,只有在没有其他空闲页面时才从池中取.如果已经没有可用物理页面,则先丢弃一个页面缓存中的干净页面,不行再执行交换
+// 处理,然后再次申请页面.对象缓存中全空的slab最先被释放.
+unsigned long get_free_page_nozero(void)
+{
+	unsigned long page;
+
+repeat:
+	if (page = find_free_page())
+		return page;
+	if (page = get_zeroed_page())
+		return page;
+	if (kmem_cache_shrink() || shrink_page_cache() || swap_out() || shm_swap())
 		goto repeat;
-	return __res;									// 返回空闲物理页面地址.
+	return 0;
 }
 
-// 内存交换初始化.
-void init_swapping(void)
+// 在主内存区中申请1页空闲物理页面,不清零页面,也不会睡眠.
+// 与get_free_page_nozero()不同,没有空闲页面时不丢弃页面缓存也不执行交换处理(交换时要睡眠等待写盘),而是直接返回0.可以在中断中
+// 或关中断时调用,例如对象缓存以GFP_ATOMIC方式分配时.
+unsigned long get_free_page_atomic(void)
+{
+	unsigned long page;
+
+	if (page = find_free_page())
+		return page;
+	return get_zeroed_page();
+}
+
+// 在主内存区中申请1页清零的空闲物理页面.
+// 首先从预先清零的页面池中取,池空时才取一页空闲页面并在这里清零.
+unsigned long get_free_page(void)
+{
+	unsigned long page;
+
+	if (page = get_zeroed_page())
+		return page;
+	if (page = get_free_page_nozero())
+		clear_page(page);
+	return page;									// 返回空闲物理页面地址.
+}
+
+// 预先清零空闲页面.
+// 由任务0在空闲时(执行pause()系统调用时)调用,把空闲页面清零后放入页面池,直到池满或没有空闲页面.每清零一页之前都检查一下是否有
+// 其他任务可以运行(例如中断处理唤醒了等待的任务),若有则立即返回,因此空闲任务最多只让其他任务多等待清零一页的时间.
+void fill_zeroed_pages(void)
+{
+	unsigned long page, flags;
+
+	while (nr_zeroed_pages < ZEROED_POOL_SIZE) {
+		if (nr_running)
+			return;
+		if (!(page = find_free_page()))
+			return;
+		clear_page(page);
+		save_flags(flags);
+		cli();
+		zeroed_pages[nr_zeroed_pages++] = page;
+		restore_flags(flags);
+	}
+}
+
+// 把交换区type按优先级插入交换区链表.优先级相同的交换区排在一起,后加入的排在同优先级的最后.
+static void insert_swap_list(int type)
+{
+	int prev, i;
+
+	prev = -1;
+	for (i = swap_list.head; i >= 0; i = swap_info[i].next) {
+		if (swap_info[i].prio < swap_info[type].prio)
+			break;
+		prev = i;
+	}
+	swap_info[type].next = i;
+	if (prev < 0)
+		swap_list.head = swap_list.next = type;
+	else
+		swap_info[prev].next = type;
+}
+
+// 把交换区type从交换区链表中摘下.此后get_swap_page()不会再从该交换区分配页面.
+static void remove_swap_list(int type)
+{
+	int prev, i;
+
+	prev = -1;
+	for (i = swap_list.head; i >= 0; i = swap_info[i].next) {
+		if (i == type)
+			break;
+		prev = i;
+	}
+	if (i < 0)
+		return;
+	if (prev < 0)
+		swap_list.head = swap_info[type].next;
+	else
+		swap_info[prev].next = swap_info[type].next;
+	if (swap_list.next == type)
+		swap_list.next = swap_list.head;
+}
+
+// 释放交换区p的位图页面.
+static void free_swap_bitmap(struct swap_info_struct * p)
+{
+	int i;
+
+	for (i = 0; i < SWAP_BITMAP_PAGES; i++)
+		if (p->swap_bitmap[i]) {
+			free_page((long) p->swap_bitmap[i]);
+			p->swap_bitmap[i] = NULL;
+		}
+}
+
+// 在设备dev上启用一个交换区,prio是其优先级.
+// 交换区第0页是管理页面,其第4086字节开始处含有10个字符的交换区特征字符串.对于"SWAP-SPACE"格式,该页面本身就是交换页面位图,
+// 因此最多只能描述SWAP_BITS(32768)个页面.对于"SWAPSPACE2"格式,页面0以后的整个设备都可用于交换,内核为其建立占多页的内存位图,
+// 从而可以使用超过128MB的交换空间.操作成功返回0,否则返回出错码.
+static int swap_setup(int dev, int prio)
 {
 	// blk_size[]指向指定主设备号的块设备块数数组.该块数数组每一项对应一个设备上所拥有的数据块总数(1块大小=1KB).
 	extern int *blk_size[];							// blk_drv/ll_rw_blk.c
-	int swap_size, i, j;
+	struct swap_info_struct * p;
+	int swap_size, type, i, j;
+	char * header;
 
-	// 如果没有定义交换设备则返回.如果交换设备没有设置块数数组,则显示并返回.
-	if (!SWAP_DEV)
-		return;
-	if (!blk_size[MAJOR(SWAP_DEV)]) {
+	// 首先为交换区找一个空闲的交换区表项,并检查该设备是否已经被用作交换区.
+	for (type = 0; type < nr_swapfiles; type++)
+		if ((swap_info[type].flags & SWP_USED) && swap_info[type].swap_dev == dev)
+			return -EBUSY;
+	for (type = 0, p = swap_info; type < nr_swapfiles; type++, p++)
+		if (!(p->flags & SWP_USED))
+			break;
+	if (type >= MAX_SWAPFILES)
+		return -EPERM;
+	// 如果交换设备没有设置块数数组,则显示并返回.取指定交换设备号的交换区数据块总数swap_size.若为0则返回,若总块数小于100块
+	// 则显示信息"交换设备区太小",然后退出.每页4个数据块,所以swap_size >>= 2计算出交换页面总数.
+	if (!blk_size[MAJOR(dev)]) {
 		printk("Unable to get size of swap device\n\r");
-		return;
+		return -EINVAL;
 	}
-	// 取指定交换设备号的交换区数据块总数swap_size.若为0则返回,若总块数小于100块则显示信息"交换设备区太小",然后退出.
-	swap_size = blk_size[MAJOR(SWAP_DEV)][MINOR(SWAP_DEV)];
+	swap_size = blk_size[MAJOR(dev)][MINOR(dev)];
 	if (!swap_size)
-		return;
+		return -EINVAL;
 	if (swap_size < 100) {
 		printk("Swap device too small (%d blocks)\n\r", swap_size);
-		return;
+		return -EINVAL;
 	}
-	// 每页4个数据块,所以swap_size >>= 2计算出交换页面总数.
-	// 交换数据块总数转换成对应可交换页面总数.该值不能大于SWAP_BITS所能表示的页面数.即交换页面总数不得大于32768.
 	swap_size >>= 2;
-	if (swap_size > SWAP_BITS)
-		swap_size = SWAP_BITS;
-	// 然后申请一页物理内存来存放交换页面映射数组swap_bitmap,其中每1比特代表1页交换页面
-	swap_bitmap = (char *) get_free_page();
-	if (!swap_bitmap) {
+	if (swap_size > SWAP_BITMAP_PAGES * SWAP_BITS)
+		swap_size = SWAP_BITMAP_PAGES * SWAP_BITS;
+	// 占用该表项.在读设备时进程可能睡眠,先置SWP_USED可以防止该表项被其他进程同时使用.
+	p->flags = SWP_USED;
+	p->swap_dev = dev;
+	p->inuse_pages = 0;
+	if (type >= nr_swapfiles)
+		nr_swapfiles = type + 1;
+	// 然后申请一页物理内存来读入交换区管理页面,并检查特征字符串.
+	if (!(header = (char *) get_free_page())) {
 		printk("Unable to start swapping: out of memory :-)\n\r");
-		return;
-	}
-	// read_swap_page(nr,buffer)被定义为ll_rw_page(READ,SWAP_DEV,(nr),(buffer)).这里把交换设备上的页面０读到swap_bitmap页面中.该页面
-	//　是交换区管理页面.其中第4086字节开始处含有１０个字符的交换设备特征字符串"SWAP-SPACE".若没有找到该特征字符串,则说明不是一个有效的交换设备.
-	// 于是显示信息,释放刚申请的物理页面并退出函数.否则将特征字符串字节清零.
-	read_swap_page(0, swap_bitmap);
-	if (strncmp("SWAP-SPACE", swap_bitmap + 4086, 10)) {
-		printk("Unable to find swap-space signature\n\r");
-		free_page((long) swap_bitmap);
-		swap_bitmap = NULL;
-		return;
+		p->flags = 0;
+		return -ENOMEM;
 	}
-	// 将交换设备的标志字符串"SWAP-SPACE"字符串清空
-	memset(swap_bitmap + 4086, 0, 10);
-	// 然后检查读入的交换位映射图.应该32768个位全为0,若位图中有置位的位0,则表示位图有问题,于是显示出错信息,释放位图占用的页面并退出函数.为了加快检查速度,
-	// 这里首先仅挑选查看位图0和最后一个交换页面对应的位,即swap_size交换页面对应的位,以及随后到SWAP_BITS(32768)位.
-	for (i = 0 ; i < SWAP_BITS ; i++) {
-		if (i == 1)
-			i = swap_size;
-		if (bit(swap_bitmap, i)) {
-			printk("Bad swap-space bit-map\n\r");
-			free_page((long) swap_bitmap);
-			swap_bitmap = NULL;
-			return;
+	ll_rw_page(READ, dev, 0, header);
+	if (!strncmp("SWAP-SPACE", header + 4086, 10)) {
+		// 旧格式:管理页面就是位图.将特征字符串字节清零后,该页面直接作为交换区的第1个位图页面.
+		memset(header + 4086, 0, 10);
+		if (swap_size > SWAP_BITS)
+			swap_size = SWAP_BITS;
+		p->swap_bitmap[0] = header;
+		// 然后检查读入的交换位映射图.位0和swap_size以后的位应该全为0,否则表示位图有问题.
+		for (i = 0 ; i < SWAP_BITS ; i++) {
+			if (i == 1)
+				i = swap_size;
+			if (bit(header, i)) {
+				printk("Bad swap-space bit-map\n\r");
+				goto bad_swap;
+			}
 		}
+	} else if (!strncmp("SWAPSPACE2", header + 4086, 10)) {
+		// 新格式:页面0以后的页面都可用.按交换页面总数申请多页位图,并把位1到swap_size-1全部置为空闲.
+		free_page((long) header);
+		for (i = 0; i * SWAP_BITS < swap_size; i++)
+			if (!(p->swap_bitmap[i] = (char *) get_free_page())) {
+				printk("Unable to start swapping: out of memory :-)\n\r");
+				goto bad_swap;
+			}
+		for (i = 1; i < swap_size; i++)
+			setbit(swap_map(p, i), swap_bit(i));
+	} else {
+		printk("Unable to find swap-space signature\n\r");
+		free_page((long) header);
+		p->flags = 0;
+		return -EINVAL;
 	}
-	// 然后再仔细地检测位1到位swap_size所有位是否为0.若存在不是0的位,则表示位图有问题,于是释放位图占用的页面并退出函数.否则显示交换设备工作正常以及交换页面
-	// 和交换空间总字节数.
+	// 统计可用的交换页面数并确定位图搜索范围.若没有可用的交换页面,则释放位图并退出.
 	j = 0;
+	p->lowest_bit = 0;
+	p->highest_bit = 0;
 	for (i = 1 ; i < swap_size ; i++)
-		if (bit(swap_bitmap, i))
+		if (bit(swap_map(p, i), swap_bit(i))) {
+			if (!p->lowest_bit)
+				p->lowest_bit = i;
+			p->highest_bit = i;
 			j++;
+		}
 	if (!j) {
-		free_page((long) swap_bitmap);
-		swap_bitmap = NULL;
-		return;
+		printk("Empty swap-file\n\r");
+		goto bad_swap;
 	}
-	Log(LOG_INFO_TYPE, "<<<<< Swap device ok: %d pages (%d bytes) swap-space >>>>>\n\r", j, j * 4096);
+	p->max = swap_size;
+	p->prio = prio;
+	p->flags = SWP_WRITEOK;
+	cli();
+	insert_swap_list(type);
+	sti();
+	Log(LOG_INFO_TYPE, "<<<<< Adding swap: %d pages (%d bytes) on device %04x, priority %d >>>>>\n\r",
+		j, j * 4096, dev, prio);
+	return 0;
+bad_swap:
+	free_swap_bitmap(p);
+	p->flags = 0;
+	return -EINVAL;
+}
+
+// 把交换区type中的页面全部读回内存.
+// 扫描除任务0以外所有任务页目录中用户空间的页表,把交换项属于该交换区的页面换入.由于读页面时会睡眠,页表可能在此期间被修改,任务也可能
+// 已经退出,因此每次都重新从任务数组中取页目录,并重复扫描直到该交换区中已没有被使用的页面.若内存不够或一遍扫描下来没有任何进展,则返回出错码.
+static int try_to_unuse(int type)
+{
+	struct swap_info_struct * p = swap_info + type;
+	unsigned long * page_table, dir, entry, page;
+	int i, dir_entry, nr, found;
+
+	while (p->inuse_pages) {
+		found = 0;
+		for (i = 1; i < NR_TASKS; i++) {
+			for (dir_entry = FIRST_VM_DIR; dir_entry < 1024; dir_entry++) {
+				// 读页面时会睡眠,任务可能已经退出,因此每次都重新取页目录项.
+				if (!task[i] || !mm_owner(task[i]))
+					break;
+				dir = ((unsigned long *) task[i]->tss.cr3)[dir_entry];
+				if (!(1 & dir))
+					continue;
+				page_table = (unsigned long *) (0xfffff000 & dir);
+				for (nr = 0; nr < 1024; nr++) {
+					entry = page_table[nr];
+					if (!entry || (1 & entry) || SWP_TYPE(entry) != type)
+						continue;
+					if (!(page = get_free_page_nozero()))
+						return -ENOMEM;
+					read_swap_page(entry, (char *) page);
+					if (page_table[nr] != entry) {
+						free_page(page);
+						continue;
+					}
+					swap_free(entry);
+					page_table[nr] = page | (PAGE_DIRTY | 7);
+					if (task[i])
+						inc_rss(task[i]);
+					found++;
+				}
+			}
+		}
+		// 共享内存段中被交换出去的页面.
+		if ((nr = shm_unuse(type)) < 0)
+			return nr;
+		found += nr;
+		if (!found && p->inuse_pages) {
+			printk("swapoff: %d pages of device %04x not found\n\r",
+				p->inuse_pages, p->swap_dev);
+			return -EBUSY;
+		}
+	}
+	return 0;
+}
+
+// 取块设备特殊文件specialfile的设备号.成功则返回设备号,否则返回出错码.
+static int swap_device(const char * specialfile)
+{
+	struct m_inode * inode;
+	int dev;
+
+	if (!(inode = namei(specialfile)))
+		return -ENOENT;
+	dev = inode->i_zone[0];
+	if (!S_ISBLK(inode->i_mode)) {
+		iput(inode);
+		return -ENOTBLK;
+	}
+	iput(inode);
+	return dev;
+}
+
+// 系统调用swapon().启用块设备specialfile作为交换区.
+// 若swap_flags中置有SWAP_FLAG_PREFER,则其低位给出交换区优先级,否则使用递减的默认优先级(-1,-2,...).优先级相同的交换区将被轮流使用.
+int sys_swapon(const char * specialfile, int swap_flags)
+{
+	int dev, prio;
+
+	if (!suser())
+		return -EPERM;
+	if ((dev = swap_device(specialfile)) < 0)
+		return dev;
+	if (swap_flags & SWAP_FLAG_PREFER)
+		prio = swap_flags & SWAP_FLAG_PRIO_MASK;
+	else
+		prio = --least_priority;
+	return swap_setup(dev, prio);
+}
+
+// 系统调用swapoff().停用块设备specialfile上的交换区.
+// 先把交换区从交换区链表中摘下并清除可写标志,然后把其中所有页面读回内存,最后释放位图.若无法读回全部页面,则恢复该交换区.
+int sys_swapoff(const char * specialfile)
+{
+	struct swap_info_struct * p;
+	int dev, type, err;
+
+	if (!suser())
+		return -EPERM;
+	if ((dev = swap_device(specialfile)) < 0)
+		return dev;
+	for (type = 0, p = swap_info; type < nr_swapfiles; type++, p++)
+		if ((p->flags & SWP_WRITEOK) == SWP_WRITEOK && p->swap_dev == dev)
+			break;
+	if (type >= nr_swapfiles)
+		return -EINVAL;
+	cli();
+	remove_swap_list(type);
+	p->flags = SWP_USED;
+	sti();
+	if (err = try_to_unuse(type)) {
+		cli();
+		p->flags = SWP_WRITEOK;
+		insert_swap_list(type);
+		sti();
+		return err;
+	}
+	free_swap_bitmap(p);
+	p->flags = 0;
+	Log(LOG_INFO_TYPE, "<<<<< Removed swap on device %04x >>>>>\n\r", dev);
+	return 0;
+}
+
+// 内存交换初始化.
+// 启用内核引导时指定的交换设备SWAP_DEV.
+void init_swapping(void)
+{
+	// 如果没有定义交换设备则返回.
+	if (!SWAP_DEV)
+		return;
+	swap_setup(SWAP_DEV, --least_priority);
 }
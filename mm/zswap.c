@@ -0,0 +1,314 @@
+/*
+ *  linux/mm/zswap.c
+ *
+ *  (C) 1991  Linus Torvalds
+ */
+
+/*
+ * A compressed cache in front of the swap devices. Pages being swapped
+ * out are compressed with a small LZ77 coder (in the spirit of LZRW1)
+ * and kept in a pool of kernel pages. Only when the pool is full, or a
+ * page doesn't compress, does the page go to the swap device. The swap
+ * entry has been allocated as usual, so the disk slot is always there
+ * to fall back to.
+ */
+/*
+ * 交换设备前面的压缩缓存.被换出的页面使用一个小的LZ77编码器(与LZRW1类似)压缩后保存在一个内核页面池中.只有当页面池已满,
+ * 或者页面无法压缩时,页面才会被写到交换设备上.交换项仍按通常方式申请,因此总有磁盘上的交换页面可以退回使用.
+ */
+
+#include <string.h>
+#include <linux/mm.h>
+#include <linux/kernel.h>
+#include <asm/system.h>
+
+// 页面池最多可占用的主内存区页面百分比.
+#define ZSWAP_POOL_PERCENT 20
+// 页面池描述符数组项数.按64MB内存计算,内存更多时池也不再增大,以免描述符数组占用过多的内核数据空间.
+#define ZSWAP_POOL_SIZE ((((64 * 1024 * 1024) - LOW_MEM) >> 12) * ZSWAP_POOL_PERCENT / 100)
+
+// 池页面被划分为64字节的块,每页64块.压缩数据占用若干个连续的块.
+#define ZCHUNK_SHIFT 6
+#define ZCHUNK_SIZE (1 << ZCHUNK_SHIFT)
+#define ZCHUNKS (PAGE_SIZE >> ZCHUNK_SHIFT)
+// 压缩后(含头部)超过3/4页面的页面不值得保存,直接写到交换设备上.
+#define ZSWAP_MAX_STORE (PAGE_SIZE * 3 / 4)
+
+// 保存在池中的每个压缩页面的头部.紧跟其后的是压缩数据.
+struct zswap_header {
+	unsigned long entry;				// 交换项.
+	struct zswap_header * next;			// 散列链表中下一项.
+	unsigned short length;				// 压缩数据长度.
+	unsigned short pool;				// 所在池页面的描述符索引.
+};
+
+// 池页面描述符.map是块位图,位为1表示对应块已被使用.
+struct zswap_pool_page {
+	unsigned long page;					// 池页面物理地址.0表示该描述符空闲.
+	unsigned long map[ZCHUNKS / 32];
+	int free_chunks;					// 空闲块数.
+};
+
+#define ZSWAP_HASH_SIZE 256
+#define zswap_hashfn(entry) (((entry) >> 12 ^ (entry) >> 1) & (ZSWAP_HASH_SIZE - 1))
+
+static struct zswap_header * zswap_hash[ZSWAP_HASH_SIZE];
+static struct zswap_pool_page zswap_pool[ZSWAP_POOL_SIZE];
+static int zswap_max_pages = 0;			// 页面池页面数上限,按实际内存容量计算.
+
+// 统计信息.
+static int zswap_pool_pages = 0;		// 页面池当前占用页面数.
+static int zswap_stored_pages = 0;		// 池中保存的页面数.
+static unsigned long zswap_stored_bytes = 0;	// 池中保存的压缩数据总字节数.
+static int zswap_reject_full = 0;		// 因页面池已满而写到交换设备的页面数.
+static int zswap_reject_poor = 0;		// 因压缩效果差而写到交换设备的页面数.
+
+// 压缩缓冲区和LZ编码器散列表.它们只在不会睡眠的代码中使用,因此可以是静态的.
+static unsigned char zswap_buf[PAGE_SIZE];
+#define LZ_HASH_SIZE 4096
+static unsigned short lz_hash[LZ_HASH_SIZE];
+
+/*
+ * The compressed format is a sequence of groups: a 16-bit control word
+ * followed by 16 items. A clear control bit means a literal byte, a set
+ * bit a two byte copy item holding a 12-bit offset and a 4-bit length
+ * (3-18 bytes).
+ */
+/*
+ * 压缩格式是一系列的组:每组由一个16位控制字和随后的16个项组成.控制位为0表示该项是1字节的原始数据,为1表示该项是2字节的
+ * 复制项,其中含有12位偏移值和4位长度值(3-18字节).
+ */
+// 压缩1页数据.
+// 参数src是页面数据;dst是输出缓冲区;limit是输出的最大长度.返回压缩后的长度,若超过limit则返回0.
+static int lz_compress(const unsigned char * src, unsigned char * dst, int limit)
+{
+	const unsigned char * p = src, * end = src + PAGE_SIZE, * q;
+	unsigned char * out = dst, * ctrl;
+	unsigned int control = 0, bit = 0, h, offset, len;
+
+	memset(lz_hash, 0, sizeof(lz_hash));
+	ctrl = out;
+	out += 2;
+	while (p < end) {
+		// 每次循环最多输出2字节控制字和2字节复制项.
+		if (out + 4 > dst + limit)
+			return 0;
+		if (bit == 16) {
+			ctrl[0] = control;
+			ctrl[1] = control >> 8;
+			ctrl = out;
+			out += 2;
+			control = bit = 0;
+		}
+		// 用当前3个字节的散列值在散列表中查找上次出现的位置.散列表中存放的是位置+1,0表示空项.
+		if (end - p >= 3) {
+			h = ((40543 * ((p[0] << 8) ^ (p[1] << 4) ^ p[2])) >> 4) & (LZ_HASH_SIZE - 1);
+			q = src + lz_hash[h] - 1;
+			offset = p - q;
+			lz_hash[h] = p - src + 1;
+			if (q >= src && offset < 4096 &&
+			    q[0] == p[0] && q[1] == p[1] && q[2] == p[2]) {
+				for (len = 3; len < 18 && p + len < end; len++)
+					if (q[len] != p[len])
+						break;
+				*out++ = ((offset >> 4) & 0xf0) | (len - 3);
+				*out++ = offset;
+				control |= 1 << bit++;
+				p += len;
+				continue;
+			}
+		}
+		*out++ = *p++;
+		bit++;
+	}
+	ctrl[0] = control;
+	ctrl[1] = control >> 8;
+	return out - dst;
+}
+
+// 解压缩.参数src是压缩数据,len是其长度;dst是输出页面.返回解压后的长度.
+static int lz_decompress(const unsigned char * src, int len, unsigned char * dst)
+{
+	const unsigned char * end = src + len;
+	unsigned char * out = dst, * q;
+	unsigned int control, bit, n;
+
+	while (src < end) {
+		control = src[0] | (src[1] << 8);
+		src += 2;
+		for (bit = 0; bit < 16 && src < end; bit++) {
+			if (!(control & (1 << bit))) {
+				*out++ = *src++;
+				continue;
+			}
+			q = out - (((src[0] & 0xf0) << 4) | src[1]);
+			n = (src[0] & 0x0f) + 3;
+			src += 2;
+			if (q < dst || out + n > dst + PAGE_SIZE)
+				return -1;
+			while (n--)
+				*out++ = *q++;
+		}
+	}
+	return out - dst;
+}
+
+// 在池页面z中申请n个连续的块.成功返回起始块号,否则返回-1.
+static int zpool_alloc_chunks(struct zswap_pool_page * z, int n)
+{
+	int i, run = 0;
+
+	for (i = 0; i < ZCHUNKS; i++) {
+		if (z->map[i >> 5] & (1 << (i & 31))) {
+			run = 0;
+			continue;
+		}
+		if (++run < n)
+			continue;
+		for (i -= n - 1, run = i + n; i < run; i++)
+			z->map[i >> 5] |= 1 << (i & 31);
+		z->free_chunks -= n;
+		return run - n;
+	}
+	return -1;
+}
+
+// 在页面池中为长度为size的数据申请空间.
+// 先在已有的池页面中查找.若没有足够的连续空间,并且页面池还未达到上限,就把正被换出的页面page收归页面池使用,并通过*kept告诉调用者.
+// 返回指向所申请空间的指针,失败则返回NULL.
+static struct zswap_header * zpool_alloc(int size, unsigned long page, int * kept)
+{
+	struct zswap_pool_page * z;
+	int i, n, chunk;
+
+	n = (size + ZCHUNK_SIZE - 1) >> ZCHUNK_SHIFT;
+	for (i = 0, z = zswap_pool; i < ZSWAP_POOL_SIZE; i++, z++) {
+		if (!z->page || z->free_chunks < n)
+			continue;
+		if ((chunk = zpool_alloc_chunks(z, n)) >= 0)
+			goto found;
+	}
+	if (zswap_pool_pages >= zswap_max_pages)
+		return NULL;
+	for (i = 0, z = zswap_pool; i < ZSWAP_POOL_SIZE; i++, z++)
+		if (!z->page)
+			break;
+	if (i >= ZSWAP_POOL_SIZE)
+		return NULL;
+	z->page = page;
+	z->map[0] = z->map[1] = 0;
+	z->free_chunks = ZCHUNKS;
+	zswap_pool_pages++;
+	*kept = 1;
+	chunk = zpool_alloc_chunks(z, n);
+found:
+	((struct zswap_header *) (z->page + (chunk << ZCHUNK_SHIFT)))->pool = i;
+	return (struct zswap_header *) (z->page + (chunk << ZCHUNK_SHIFT));
+}
+
+// 释放池中的压缩页面zh.若其所在池页面已全部空闲,则把该页面归还给主内存区.
+static void zpool_free(struct zswap_header * zh)
+{
+	struct zswap_pool_page * z = zswap_pool + zh->pool;
+	int i, n;
+
+	n = (sizeof(struct zswap_header) + zh->length + ZCHUNK_SIZE - 1) >> ZCHUNK_SHIFT;
+	i = ((unsigned long) zh & 0xfff) >> ZCHUNK_SHIFT;
+	z->free_chunks += n;
+	while (n--) {
+		z->map[i >> 5] &= ~(1 << (i & 31));
+		i++;
+	}
+	if (z->free_chunks == ZCHUNKS) {
+		free_page(z->page);
+		z->page = 0;
+		zswap_pool_pages--;
+	}
+}
+
+// 在散列表中查找交换项entry对应的压缩页面.
+static struct zswap_header * zswap_find(unsigned long entry)
+{
+	struct zswap_header * zh;
+
+	for (zh = zswap_hash[zswap_hashfn(entry)]; zh; zh = zh->next)
+		if (zh->entry == entry)
+			return zh;
+	return NULL;
+}
+
+// 把将被换出的页面page压缩保存到页面池中.entry是已为该页面申请的交换项.
+// 返回ZSWAP_NONE表示没有保存,调用者应把页面写到交换设备上;ZSWAP_STORED表示已保存;ZSWAP_KEPT表示已保存并且页面page本身已被
+// 收归页面池,调用者不能再释放它.
+int zswap_store(unsigned long entry, unsigned long page)
+{
+	struct zswap_header * zh;
+	int len, kept = 0;
+
+	if (!zswap_max_pages)
+		zswap_max_pages = ((HIGH_MEMORY - LOW_MEM) >> 12) * ZSWAP_POOL_PERCENT / 100;
+	if (zswap_max_pages > ZSWAP_POOL_SIZE)
+		zswap_max_pages = ZSWAP_POOL_SIZE;
+	len = lz_compress((unsigned char *) page, zswap_buf,
+		ZSWAP_MAX_STORE - sizeof(struct zswap_header));
+	if (!len) {
+		zswap_reject_poor++;
+		return ZSWAP_NONE;
+	}
+	if (!(zh = zpool_alloc(sizeof(struct zswap_header) + len, page, &kept))) {
+		zswap_reject_full++;
+		return ZSWAP_NONE;
+	}
+	// 若页面已被收归页面池,则它的原内容已在压缩缓冲区中,可以直接被覆盖.
+	memcpy((char *) (zh + 1), zswap_buf, len);
+	zh->entry = entry;
+	zh->length = len;
+	zh->next = zswap_hash[zswap_hashfn(entry)];
+	zswap_hash[zswap_hashfn(entry)] = zh;
+	zswap_stored_pages++;
+	zswap_stored_bytes += len;
+	return kept ? ZSWAP_KEPT : ZSWAP_STORED;
+}
+
+// 若交换项entry对应的页面在页面池中,则把它解压到buffer中并返回1,否则返回0.
+// 池中的副本仍被保留(例如fork时复制页表需要读入交换页面但并不释放交换项),直到交换项被释放时才删除.
+int zswap_load(unsigned long entry, char * buffer)
+{
+	struct zswap_header * zh;
+
+	if (!(zh = zswap_find(entry)))
+		return 0;
+	if (lz_decompress((unsigned char *) (zh + 1), zh->length,
+	    (unsigned char *) buffer) != PAGE_SIZE)
+		panic("zswap: corrupted compressed page");
+	return 1;
+}
+
+// 交换项entry被释放时,删除其在页面池中的压缩页面(若有).
+void zswap_invalidate(unsigned long entry)
+{
+	struct zswap_header * zh, ** p;
+
+	for (p = zswap_hash + zswap_hashfn(entry); (zh = *p); p = &zh->next)
+		if (zh->entry == entry) {
+			*p = zh->next;
+			zswap_stored_pages--;
+			zswap_stored_bytes -= zh->length;
+			zpool_free(zh);
+			return;
+		}
+}
+
+// 显示压缩交换缓存的统计信息.在show_mem()中被调用.
+void zswap_show(void)
+{
+	unsigned long ratio = 0;
+
+	// 压缩比 = 原始数据字节数 / 压缩后字节数,这里以百分之一为单位计算.
+	if (zswap_stored_bytes >> 4)
+		ratio = zswap_stored_pages * 100 * (PAGE_SIZE >> 4) / (zswap_stored_bytes >> 4);
+	printk("zswap: %d pages stored, %d bytes compressed, ratio %d.%02d\n\r",
+		zswap_stored_pages, zswap_stored_bytes, ratio / 100, ratio % 100);
+	printk("zswap: pool %d of %d pages, %d rejected (full), %d rejected (poor)\n\r",
+		zswap_pool_pages, zswap_max_pages, zswap_reject_full, zswap_reject_poor);
+}
@@ -0,0 +1,64 @@
+/*
+ * Null system call benchmark: time getpid() through int $0x80 and,
+ * where the CPU has it, through sysenter. Link with the kernel's
+ * lib/lib.a for __sysenter_check().
+ */
+/*
+ * 空系统调用测试:分别测量经int $0x80和(CPU支持时)经sysenter执行getpid()所用的时间.需要与内核的lib/lib.a链接,以使用其中的
+ * __sysenter_check().
+ */
+#define __LIBRARY__
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/times.h>
+
+#define LOOPS 1000000
+
+static int getpid_int80(void)
+{
+	long __res;
+
+	__asm__ volatile ("int $0x80"
+		: "=a" (__res)
+		: "0" (__NR_getpid));
+	return (int) __res;
+}
+
+static int getpid_sysenter(void)
+{
+	long __res, __c, __d;
+
+	__asm__ volatile (__sysenter
+		: "=a" (__res), "=c" (__c), "=d" (__d)
+		: "0" (__NR_getpid));
+	return (int) __res;
+}
+
+// 执行LOOPS次系统调用,返回所用的时钟滴答数.
+static long run(int (*fn)(void))
+{
+	struct tms t;
+	long start;
+	int i;
+
+	start = times(&t);
+	for (i = 0 ; i < LOOPS ; i++)
+		fn();
+	return times(&t) - start;
+}
+
+// LOOPS为一百万,每个滴答10ms,因此每次调用的纳秒数等于滴答数乘以10.
+int main(int argc, char *argv[])
+{
+	long ticks;
+
+	ticks = run(getpid_int80);
+	printf("int $0x80: %ld ticks, %ld ns/call\n", ticks, ticks * 10);
+	if (!__sysenter_check()) {
+		printf("sysenter: not supported\n");
+		return (0);
+	}
+	ticks = run(getpid_sysenter);
+	printf("sysenter:  %ld ticks, %ld ns/call\n", ticks, ticks * 10);
+	return (0);
+}